@@ -0,0 +1,457 @@
+/**
+ * Microbenchmarks for the hot functions.
+ * Each case runs a fixed number of operations per repetition, so results
+ * stay comparable across commits. Timings are written as JSON (ns/op
+ * with spread over the repetitions); progress goes to stderr.
+ *
+ * Usage: bench [--reps N] [--filter TEXT] [--data DIR] [--out FILE]
+ */
+#include "Angel.h"
+#include "Globals.h"
+#include "objects.h"
+#include "physics.h"
+#include "rng.h"
+#include "simdops.h"
+#include "texture.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef BENCH_DATA_DIR
+#define BENCH_DATA_DIR "."
+#endif
+
+struct BenchCase {
+    std::string name;
+    long iterations;              // Operations per repetition
+    long itemsPerOp;              // Work items (balls, matrices...) per operation
+    std::function<void()> setup;  // Untimed, before every repetition
+    std::function<void()> run;    // One operation
+};
+
+struct BenchResult {
+    std::string name;
+    long iterations;
+    long itemsPerOp;
+    std::vector<double> nsPerOp;  // One sample per repetition
+};
+
+// Physics step used by the update benchmarks
+static const float BENCH_DT = 1.0f / 120.0f;
+
+// Results the optimizer must not discard
+static volatile float benchSink;
+
+static bool fileExists(const std::string& path) {
+    FILE* fp = fopen(path.c_str(), "r");
+    if (fp) fclose(fp);
+    return fp != nullptr;
+}
+
+/**
+ * Size the window so every ball count sees the same density
+ * (one ball per 40x40 pixels, 4:3 aspect)
+ */
+static void fillBalls(size_t count) {
+    float area = count * 40.0f * 40.0f;
+    windowWidth = std::max(800, (int)std::sqrt(area * 4.0f / 3.0f));
+    windowHeight = windowWidth * 3 / 4;
+
+    multipleObjects = true;
+    initBall();
+    Rng rng(1234);
+    balls.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        BallObject ball;
+        ball.x = windowWidth * rng.uniform(0.1f, 0.9f);
+        ball.y = windowHeight * rng.uniform(0.1f, 0.8f);
+        ball.vx = rng.uniform(-5.0f, 5.0f);
+        ball.vy = rng.uniform(-5.0f, 5.0f);
+        ball.colorIndex = (int)rng.below(8);
+        ball.type = static_cast<ObjectType>(rng.below(2));
+        ball.size = rng.uniform(3.0f, 8.0f);  // 3 to 8 pixel radius
+        ball.launchTime = 0.0f;
+        balls.push(ball);
+    }
+}
+
+static void fillParticles(size_t count) {
+    particleBudget = (int)count;
+    particles.setBudget(count);
+    particles.clear();
+    size_t first;
+    size_t granted = particles.allocateBurst(count, first);
+    Rng rng(1234);
+    for (size_t i = first; i < first + granted; i++) {
+        particles.x[i] = rng.uniform(0.0f, 800.0f);
+        particles.y[i] = rng.uniform(0.0f, 600.0f);
+        particles.vx[i] = rng.uniform(-10.0f, 10.0f);
+        particles.vy[i] = rng.uniform(-10.0f, 0.0f);
+        particles.r[i] = particles.g[i] = particles.b[i] = 1.0f;
+        particles.a[i] = 0.7f;
+        particles.life[i] = 1e6f;  // Outlive the repetition
+        particles.size[i] = 4.0f;
+    }
+}
+
+// Inputs and outputs for the mat4 cases
+static const int MATS = 256;
+static mat4 inA[MATS], inB[MATS], outM[MATS];
+static vec4 inV[MATS], outV[MATS];
+
+// Output buffer for the RNG cases
+static const int RNG_BATCH = 4096;
+alignas(32) static float rngOut[RNG_BATCH];
+static Rng benchRng;
+
+/**
+ * LANES independent xoshiro128** streams stored as structure of arrays,
+ * so one call produces a whole SIMD vector of floats. The lane loops are
+ * plain integer code the compiler can vectorize, which is what the
+ * rng/lanes case measures against the scalar Rng.
+ */
+class RngLanes {
+public:
+    static const int LANES = 8;
+
+    // Lane k starts from four words of the scalar Rng stream (stream * LANES + k)
+    void reseed(uint64_t seed, uint64_t stream = 0) {
+        for (int k = 0; k < LANES; k++) {
+            Rng lane(seed, stream * LANES + k);
+            s0[k] = lane.next();
+            s1[k] = lane.next() | 1u;  // Never the all-zero state
+            s2[k] = lane.next();
+            s3[k] = lane.next();
+        }
+    }
+
+    // Write LANES uniform floats in [0, 1) to out
+    void uniform(float* out) {
+        for (int k = 0; k < LANES; k++) {
+            uint32_t m = s1[k] * 5;
+            uint32_t result = ((m << 7) | (m >> 25)) * 9;
+            uint32_t t = s1[k] << 9;
+            s2[k] ^= s0[k];
+            s3[k] ^= s1[k];
+            s1[k] ^= s2[k];
+            s0[k] ^= s3[k];
+            s2[k] ^= t;
+            s3[k] = (s3[k] << 11) | (s3[k] >> 21);
+            out[k] = (result >> 8) * (1.0f / 16777216.0f);
+        }
+    }
+
+private:
+    alignas(32) uint32_t s0[LANES];
+    alignas(32) uint32_t s1[LANES];
+    alignas(32) uint32_t s2[LANES];
+    alignas(32) uint32_t s3[LANES];
+};
+static RngLanes benchLanes;
+
+// Bouncing path fed to the trajectory simplifier, one sample per 120 Hz step
+static const int TRAJECTORY_SAMPLES = 4096;
+static float trailX[TRAJECTORY_SAMPLES], trailY[TRAJECTORY_SAMPLES];
+static bool trailCorner[TRAJECTORY_SAMPLES];
+static TrajectoryHistory benchTrajectory;
+
+static void fillTrail() {
+    float x = 40.0f, y = 40.0f, vx = 3.0f, vy = 0.0f;
+    for (int i = 0; i < TRAJECTORY_SAMPLES; i++) {
+        vy += 0.25f;
+        x += vx;
+        y += vy * 0.5f;
+        trailCorner[i] = false;
+        if (y > 540.0f) { y = 1080.0f - y; vy = -vy * 0.9f; trailCorner[i] = true; }
+        if (x > 760.0f || x < 40.0f) { vx = -vx; trailCorner[i] = true; }
+        trailX[i] = x;
+        trailY[i] = y;
+    }
+}
+
+/**
+ * Case applying op to every matrix in the batch per operation; op is a
+ * lambda so the call inlines into the loop
+ */
+template <typename Op>
+static BenchCase matCase(const char* name, Op op) {
+    BenchCase c;
+    c.name = name;
+    c.iterations = 2000;
+    c.itemsPerOp = MATS;
+    c.setup = [] {};
+    c.run = [op] {
+        for (int i = 0; i < MATS; i++) op(i);
+        benchSink = benchSink + outM[MATS - 1][1][2] + outV[MATS - 1].y;
+    };
+    return c;
+}
+
+static std::vector<BenchCase> buildCases(const std::string& dataDir) {
+    std::vector<BenchCase> cases;
+
+    {
+        BenchCase c;
+        c.name = "updateBall/single";
+        c.iterations = 100000;
+        c.itemsPerOp = 1;
+        c.setup = [] {
+            windowWidth = 800;
+            windowHeight = 600;
+            multipleObjects = false;
+            showParticles = false;
+            initBall();
+        };
+        c.run = [] { updateBall(BENCH_DT); };
+        cases.push_back(c);
+    }
+
+    const size_t ballCounts[3] = { 1000, 10000, 100000 };
+    const long ballSteps[3] = { 500, 100, 10 };
+    for (int k = 0; k < 3; k++) {
+        size_t count = ballCounts[k];
+        BenchCase c;
+        c.name = "updateBall/multi/" + std::to_string(count);
+        c.iterations = ballSteps[k];
+        c.itemsPerOp = (long)count;
+        c.setup = [count] {
+            showParticles = false;
+            fillBalls(count);
+        };
+        c.run = [] { updateBall(BENCH_DT); };
+        cases.push_back(c);
+    }
+
+    {
+        BenchCase c;
+        c.name = "updateParticles/20000";
+        c.iterations = 500;
+        c.itemsPerOp = 20000;
+        c.setup = [] { fillParticles(20000); };
+        c.run = [] { updateParticles(BENCH_DT); };
+        cases.push_back(c);
+    }
+
+    for (int level = 0; level <= 6; level++) {
+        BenchCase c;
+        c.name = "initSphere/" + std::to_string(level);
+        c.iterations = std::max(1L, 20000L >> (2 * level));
+        c.itemsPerOp = 8L << (2 * level);  // Triangles generated
+        c.setup = [] {};
+        c.run = [level] { initSphere(level); };
+        cases.push_back(c);
+    }
+
+    std::string bunnyPath = dataDir + "/bunny.off";
+    if (fileExists(bunnyPath)) {
+        BenchCase c;
+        c.name = "loadBunnyModel+calculateBunnyNormals";
+        c.iterations = 5;
+        c.itemsPerOp = 1;
+        c.setup = [] {};
+        c.run = [bunnyPath] {
+            loadBunnyModel(bunnyPath);
+            calculateBunnyNormals();
+        };
+        cases.push_back(c);
+    } else {
+        fprintf(stderr, "skipping bunny load: %s not found\n", bunnyPath.c_str());
+    }
+
+    std::string ppmPath = dataDir + "/basketball.ppm";
+    if (fileExists(ppmPath)) {
+        BenchCase c;
+        c.name = "parsePPM";
+        c.iterations = 3;
+        c.itemsPerOp = 1;
+        c.setup = [] {};
+        c.run = [ppmPath] {
+            int width, height;
+            std::vector<GLubyte> pixels;
+            parsePPM(ppmPath.c_str(), width, height, pixels);
+            benchSink = benchSink + (pixels.empty() ? 0.0f : pixels[0]);
+        };
+        cases.push_back(c);
+    } else {
+        fprintf(stderr, "skipping PPM parse: %s not found\n", ppmPath.c_str());
+    }
+
+    // Random streams: scalar batch fill and one SIMD vector of lanes at a time
+    {
+        BenchCase c;
+        c.name = "rng/fillUniform";
+        c.iterations = 2000;
+        c.itemsPerOp = RNG_BATCH;
+        c.setup = [] { benchRng.reseed(1); };
+        c.run = [] {
+            benchRng.fillUniform(rngOut, RNG_BATCH, -1.0f, 1.0f);
+            benchSink = benchSink + rngOut[RNG_BATCH - 1];
+        };
+        cases.push_back(c);
+    }
+    {
+        BenchCase c;
+        c.name = "rng/lanes";
+        c.iterations = 2000;
+        c.itemsPerOp = RNG_BATCH;
+        c.setup = [] { benchLanes.reseed(1); };
+        c.run = [] {
+            for (int i = 0; i < RNG_BATCH; i += RngLanes::LANES) benchLanes.uniform(rngOut + i);
+            benchSink = benchSink + rngOut[RNG_BATCH - 1];
+        };
+        cases.push_back(c);
+    }
+
+    // Online trajectory simplification at all levels of detail
+    {
+        fillTrail();
+        BenchCase c;
+        c.name = "trajectory/add";
+        c.iterations = 50;
+        c.itemsPerOp = TRAJECTORY_SAMPLES;
+        c.setup = [] {
+            benchTrajectory.configure(TRAJECTORY_SAMPLES, 0.5f);
+            benchTrajectory.clear();
+        };
+        c.run = [] {
+            for (int i = 0; i < TRAJECTORY_SAMPLES; i++)
+                benchTrajectory.add(trailX[i], trailY[i], i / 120.0f, trailCorner[i]);
+            benchSink = benchSink + benchTrajectory.level(0).size();
+        };
+        cases.push_back(c);
+    }
+
+    // mat4 operators over a batch of distinct matrices, so nothing folds to a constant
+    for (int i = 0; i < MATS; i++) {
+        inA[i] = RotateY(i * 1.3f) * Translate(i * 0.1f, 1.0f, -2.0f) * Scale(1.0f + i * 0.01f, 1.0f, 1.0f);
+        inB[i] = RotateX(i * 0.7f) * RotateZ(i * 0.2f);
+        inV[i] = vec4(i * 0.5f, 1.0f - i * 0.25f, 2.0f, 1.0f);
+    }
+    cases.push_back(matCase("mat4/multiply", [](int i) { outM[i] = inA[i] * inB[i]; }));
+    cases.push_back(matCase("mat4/multiply_vec4", [](int i) { outV[i] = inA[i] * inV[i]; }));
+    cases.push_back(matCase("mat4/add", [](int i) { outM[i] = inA[i] + inB[i]; }));
+    cases.push_back(matCase("mat4/scale", [](int i) { outM[i] = 0.5f * inA[i]; }));
+    cases.push_back(matCase("mat4/multiply_assign", [](int i) { outM[i] = inA[i]; outM[i] *= inB[i]; }));
+    cases.push_back(matCase("mat4/transpose", [](int i) { outM[i] = transpose(inA[i]); }));
+    cases.push_back(matCase("mat4/RotateY", [](int i) { outM[i] = RotateY(i * 1.3f); }));
+
+    return cases;
+}
+
+static BenchResult runCase(const BenchCase& c, int reps) {
+    BenchResult result;
+    result.name = c.name;
+    result.iterations = c.iterations;
+    result.itemsPerOp = c.itemsPerOp;
+
+    // The first repetition warms caches and lazily created state and is not recorded
+    for (int rep = 0; rep <= reps; rep++) {
+        c.setup();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (long i = 0; i < c.iterations; i++) c.run();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (rep > 0) result.nsPerOp.push_back(ns / c.iterations);
+    }
+    return result;
+}
+
+static void writeJson(FILE* out, const std::vector<BenchResult>& results, int reps) {
+#if defined(__AVX__)
+    const char* simd = "avx";
+#elif defined(HAVE_SIMD_OPS)
+    const char* simd = "sse2";
+#else
+    const char* simd = "scalar";
+#endif
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"context\": {\n");
+    fprintf(out, "    \"repetitions\": %d,\n", reps);
+    fprintf(out, "    \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+    fprintf(out, "    \"simd\": \"%s\"\n", simd);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"benchmarks\": [\n");
+    for (size_t r = 0; r < results.size(); r++) {
+        const BenchResult& res = results[r];
+        std::vector<double> sorted = res.nsPerOp;
+        std::sort(sorted.begin(), sorted.end());
+        double mean = 0.0;
+        for (size_t i = 0; i < sorted.size(); i++) mean += sorted[i];
+        mean /= sorted.size();
+        double variance = 0.0;
+        for (size_t i = 0; i < sorted.size(); i++) variance += (sorted[i] - mean) * (sorted[i] - mean);
+        if (sorted.size() > 1) variance /= sorted.size() - 1;
+        double median = sorted.size() % 2 ? sorted[sorted.size() / 2]
+                                          : 0.5 * (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]);
+
+        fprintf(out, "    {\n");
+        fprintf(out, "      \"name\": \"%s\",\n", res.name.c_str());
+        fprintf(out, "      \"iterations\": %ld,\n", res.iterations);
+        fprintf(out, "      \"repetitions\": %d,\n", (int)sorted.size());
+        fprintf(out, "      \"items_per_op\": %ld,\n", res.itemsPerOp);
+        fprintf(out, "      \"ns_per_op\": %.3f,\n", mean);
+        fprintf(out, "      \"ns_per_op_median\": %.3f,\n", median);
+        fprintf(out, "      \"ns_per_op_min\": %.3f,\n", sorted.front());
+        fprintf(out, "      \"ns_per_op_max\": %.3f,\n", sorted.back());
+        fprintf(out, "      \"ns_per_op_stddev\": %.3f,\n", std::sqrt(variance));
+        fprintf(out, "      \"ns_per_item\": %.3f\n", mean / res.itemsPerOp);
+        fprintf(out, "    }%s\n", r + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char** argv) {
+    int reps = 10;
+    std::string filter;
+    std::string dataDir = BENCH_DATA_DIR;
+    std::string outPath;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--reps") reps = std::max(1, atoi(argv[i + 1]));
+        else if (arg == "--filter") filter = argv[i + 1];
+        else if (arg == "--data") dataDir = argv[i + 1];
+        else if (arg == "--out") outPath = argv[i + 1];
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            fprintf(stderr, "Usage: %s [--reps N] [--filter TEXT] [--data DIR] [--out FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // The simulation functions log to std::cout; keep that out of the JSON
+    std::ostringstream discard;
+    std::streambuf* coutBuf = std::cout.rdbuf(discard.rdbuf());
+
+    std::vector<BenchCase> cases = buildCases(dataDir);
+    std::vector<BenchResult> results;
+    for (size_t i = 0; i < cases.size(); i++) {
+        if (!filter.empty() && cases[i].name.find(filter) == std::string::npos) continue;
+        fprintf(stderr, "%-40s", cases[i].name.c_str());
+        results.push_back(runCase(cases[i], reps));
+        discard.str("");
+
+        const std::vector<double>& samples = results.back().nsPerOp;
+        fprintf(stderr, " %14.1f ns/op\n", *std::min_element(samples.begin(), samples.end()));
+    }
+    std::cout.rdbuf(coutBuf);
+
+    FILE* out = stdout;
+    if (!outPath.empty()) {
+        out = fopen(outPath.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "Cannot open %s\n", outPath.c_str());
+            return 1;
+        }
+    }
+    writeJson(out, results, reps);
+    if (out != stdout) fclose(out);
+    return 0;
+}
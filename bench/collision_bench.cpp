@@ -0,0 +1,101 @@
+/**
+ * Ball-ball collision benchmark.
+ * Times the spatial-hash collision pass at growing ball counts with the
+ * ball density held constant, and compares it with all-pairs testing for
+ * the smaller counts, to show how the cost scales with ball count.
+ */
+#include "ballstore.h"
+#include "broadphase.h"
+#include "rng.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// Balls per square pixel; keeps roughly the same contact count per ball at every size
+static const float DENSITY = 1.0f / (40.0f * 40.0f);
+static const int STEPS = 10;
+
+static void fillBalls(BallStore& balls, size_t count, BallStepParams& params) {
+    float side = std::sqrt(count / DENSITY);
+    params.gravity = 0.35f;
+    params.airResistance = 0.998f;
+    params.restitution = 0.92f;
+    params.speed = 1.0f;
+    params.left = 0.0f;
+    params.right = side;
+    params.bottom = side;
+    params.now = 0.0f;
+    params.maxLifetime = 1e9f;
+
+    balls.clear();
+    balls.reserve(count);
+    Rng rng(1234);
+    for (size_t i = 0; i < count; i++) {
+        BallObject ball;
+        ball.x = side * rng.uniform();
+        ball.y = side * rng.uniform();
+        ball.vx = rng.uniform(-5.0f, 5.0f);
+        ball.vy = rng.uniform(-5.0f, 5.0f);
+        ball.colorIndex = 0;
+        ball.type = SPHERE;
+        ball.size = rng.uniform(6.0f, 10.0f);  // 6 to 10 pixel radius
+        ball.launchTime = 0.0f;
+        balls.push(ball);
+    }
+}
+
+// Reference all-pairs overlap count
+static size_t bruteForceContacts(const BallStore& balls) {
+    size_t contacts = 0;
+    size_t n = balls.getCount();
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = i + 1; j < n; j++) {
+            float dx = balls.x[j] - balls.x[i];
+            float dy = balls.y[j] - balls.y[i];
+            float r = balls.size[i] + balls.size[j];
+            if (dx * dx + dy * dy < r * r) contacts++;
+        }
+    }
+    return contacts;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t maxCount = argc > 1 ? (size_t)atol(argv[1]) : 256000;
+
+    printf("%10s %14s %14s %12s %16s %12s\n",
+           "balls", "grid ms/step", "grid ns/ball", "contacts", "all-pairs ms", "all-pairs");
+
+    BallStore balls;
+    SpatialGrid grid;
+    for (size_t count = 1000; count <= maxCount; count *= 2) {
+        BallStepParams params;
+        fillBalls(balls, count, params);
+
+        // All-pairs reference on the initial layout (skipped once it gets slow)
+        double bruteMs = -1.0;
+        size_t bruteContacts = 0;
+        if (count <= 16000) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            bruteContacts = bruteForceContacts(balls);
+            bruteMs = secondsSince(start) * 1000.0;
+        }
+
+        size_t firstContacts = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int s = 0; s < STEPS; s++) {
+            size_t contacts = collideBalls(balls, params, grid);
+            if (s == 0) firstContacts = contacts;
+        }
+        double stepMs = secondsSince(start) * 1000.0 / STEPS;
+
+        printf("%10zu %14.3f %14.1f %12zu ", count, stepMs, stepMs * 1e6 / count, firstContacts);
+        if (bruteMs >= 0.0) printf("%16.3f %12zu\n", bruteMs, bruteContacts);
+        else printf("%16s %12s\n", "-", "-");
+    }
+    return 0;
+}
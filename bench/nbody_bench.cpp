@@ -0,0 +1,100 @@
+/**
+ * Barnes-Hut attraction benchmark.
+ * Scatters bodies over a clustered disc and times building the tree and
+ * evaluating every body's acceleration at several opening angles. The
+ * error column is the RMS relative error against direct summation over
+ * a sample of bodies; the direct row extrapolates that summation to all
+ * of them, which is what the O(n log n) tree replaces.
+ */
+#include "barneshut.h"
+#include "rng.h"
+#include "threadpool.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static const size_t SAMPLE = 512;
+static const float SOFTENING = 6.0f;
+static const int REPS = 3;
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? (size_t)atol(argv[1]) : 100000;
+    unsigned threads = argc > 2 ? (unsigned)atoi(argv[2]) : 0;
+    if (count < 2) {
+        fprintf(stderr, "Need at least 2 bodies\n");
+        return 1;
+    }
+
+    // A few dense clumps inside a wide disc, like a swarm that has started to gather
+    std::vector<float> x(count), y(count), mass(count);
+    Rng rng(11);
+    for (size_t i = 0; i < count; i++) {
+        float angle = rng.uniform(0.0f, 6.2831853f);
+        float radius = (i % 4 == 0) ? 2000.0f * std::sqrt(rng.uniform(0.0f, 1.0f)) : 150.0f * rng.uniform(0.0f, 1.0f);
+        float centre = 600.0f * (float)(i % 4) - 900.0f;
+        x[i] = (i % 4 == 0 ? 0.0f : centre) + radius * std::cos(angle);
+        y[i] = radius * std::sin(angle);
+        float size = 6.0f * rng.uniform(0.6f, 1.4f);
+        mass[i] = size * size;
+    }
+
+    // Direct sums for an evenly spaced sample of bodies
+    size_t sample = count < SAMPLE ? count : SAMPLE;
+    std::vector<double> exactX(sample), exactY(sample);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t s = 0; s < sample; s++) {
+        size_t i = s * count / sample;
+        double sumX = 0.0, sumY = 0.0;
+        for (size_t j = 0; j < count; j++) {
+            if (j == i) continue;
+            double dx = x[j] - x[i], dy = y[j] - y[i];
+            double distSq = dx * dx + dy * dy + SOFTENING * SOFTENING;
+            double inv = mass[j] / (distSq * std::sqrt(distSq));
+            sumX += dx * inv;
+            sumY += dy * inv;
+        }
+        exactX[s] = sumX;
+        exactY[s] = sumY;
+    }
+    double directMs = secondsSince(start) * 1000.0 * count / sample;
+
+    ThreadPool pool(threads);
+    ThreadPool* workers = pool.size() > 1 ? &pool : nullptr;
+    BarnesHutTree tree;
+    std::vector<float> ax(count), ay(count);
+
+    printf("%zu bodies, %u threads, error over %zu sampled bodies\n", count, pool.size(), sample);
+    printf("%10s %12s %12s %12s %16s %12s\n", "theta", "build ms", "force ms", "nodes", "interactions/b",
+           "rms error");
+    const float angles[] = { 0.3f, 0.5f, 0.7f, 1.0f };
+    for (size_t a = 0; a < sizeof(angles) / sizeof(angles[0]); a++) {
+        double buildMs = 0.0, forceMs = 0.0;
+        size_t interactions = 0;
+        for (int r = 0; r < REPS; r++) {
+            start = std::chrono::steady_clock::now();
+            tree.build(x.data(), y.data(), mass.data(), count, SOFTENING, workers);
+            buildMs += secondsSince(start) * 1000.0 / REPS;
+            start = std::chrono::steady_clock::now();
+            interactions = tree.accelerations(count, angles[a], ax.data(), ay.data(), workers);
+            forceMs += secondsSince(start) * 1000.0 / REPS;
+        }
+
+        double errorSq = 0.0;
+        for (size_t s = 0; s < sample; s++) {
+            size_t i = s * count / sample;
+            double ex = ax[i] - exactX[s], ey = ay[i] - exactY[s];
+            double norm = exactX[s] * exactX[s] + exactY[s] * exactY[s];
+            if (norm > 0.0) errorSq += (ex * ex + ey * ey) / norm;
+        }
+        printf("%10.2f %12.3f %12.3f %12zu %16.1f %12.2e\n", angles[a], buildMs, forceMs, tree.nodeCount(),
+               (double)interactions / count, std::sqrt(errorSq / sample));
+    }
+    printf("%10s %12s %12.1f %12s %16zu %12s\n", "direct", "-", directMs, "-", count - 1, "-");
+    return 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * Dense pile benchmark.
+ * Stacks a block of balls on the floor of a narrow arena, lets it
+ * settle into a pile and then times each contact model on the pile:
+ * the impulse pass of collideBalls and the position-based solver at
+ * growing iteration counts. Besides the step time it reports how deep
+ * balls still overlap and how fast they still move, which is what the
+ * extra iterations buy.
+ */
+#include "ballstore.h"
+#include "simulation.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+static const float RADIUS = 6.0f;
+static const float HZ = 120.0f;
+static const int SETTLE_STEPS = 240;
+static const int TIMED_STEPS = 30;
+
+/**
+ * Block of balls stacked in hexagonal rows on the floor with a sliver of
+ * room between them, in an arena just wide enough to hold it, so the
+ * pile only has to settle under its own weight
+ */
+static void fillPile(BallStore& balls, size_t count, SimSettings& settings) {
+    size_t columns = (size_t)std::ceil(std::sqrt((double)count));
+    size_t rows = (count + columns - 1) / columns;
+    float spacing = 2.02f * RADIUS;
+    float rowHeight = spacing * 0.8660254f;
+    settings.width = (columns * spacing + RADIUS) / 0.9f;  // Walls at 5% and 95%
+    settings.height = (rows * rowHeight + 4.0f * RADIUS) / 0.9f;
+    settings.maxLifetime = 1e30f;
+    settings.allowSleep = false;  // Time the solver on every ball
+
+    float left = settings.width * 0.05f + RADIUS;
+    float floor = settings.height * 0.9f - RADIUS;
+    balls.clear();
+    balls.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t row = i / columns, column = i % columns;
+        BallObject ball;
+        ball.x = left + column * spacing + (row % 2 ? 0.5f * spacing : 0.0f);
+        ball.y = floor - row * rowHeight;
+        ball.vx = 0.0f;
+        ball.vy = 0.0f;
+        ball.colorIndex = 0;
+        ball.type = SPHERE;
+        ball.size = RADIUS;
+        ball.launchTime = 0.0f;
+        balls.push(ball);
+    }
+}
+
+// Deepest and mean overlap of touching pairs, as fractions of the radius
+static void measureOverlap(const BallStore& balls, SpatialGrid& grid, double& mean, double& worst) {
+    size_t n = balls.getCount();
+    grid.build(balls.x.data(), balls.y.data(), n, 2.0f * RADIUS);
+    double sum = 0.0;
+    size_t pairs = 0;
+    worst = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        grid.forEachNeighbor(balls.x[i], balls.y[i], [&](uint32_t j) {
+            if (j <= i) return;
+            float dx = balls.x[j] - balls.x[i], dy = balls.y[j] - balls.y[i];
+            float minDist = balls.size[i] + balls.size[j];
+            float distSq = dx * dx + dy * dy;
+            if (distSq >= minDist * minDist) return;
+            double depth = (minDist - std::sqrt(distSq)) / RADIUS;
+            sum += depth;
+            worst = std::max(worst, depth);
+            pairs++;
+        });
+    }
+    mean = pairs ? sum / pairs : 0.0;
+}
+
+static double meanSpeed(const BallStore& balls) {
+    double sum = 0.0;
+    for (size_t i = 0; i < balls.getCount(); i++)
+        sum += std::sqrt(balls.vx[i] * balls.vx[i] + balls.vy[i] * balls.vy[i]);
+    return balls.getCount() ? sum / balls.getCount() : 0.0;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? (size_t)atol(argv[1]) : 100000;
+    unsigned threads = argc > 2 ? (unsigned)atoi(argv[2]) : 0;
+
+    ThreadPool pool(threads);
+    BallStore balls;
+    SpatialGrid grid, measureGrid;
+    PbdSolver solver;
+    std::vector<MeshObstacle> obstacles;
+
+    printf("%zu balls in a settled pile, %u threads, %d steps at %g Hz to settle\n", count, pool.size(),
+           SETTLE_STEPS, HZ);
+    printf("%12s %12s %12s %12s %14s %14s %10s\n", "contacts", "ms/step", "ns/ball", "touching",
+           "mean overlap", "max overlap", "speed");
+
+    const int iterationCounts[] = { 0, 1, 2, 4, 8, 16 };
+    for (size_t m = 0; m < sizeof(iterationCounts) / sizeof(iterationCounts[0]); m++) {
+        SimSettings settings;
+        settings.contactIterations = iterationCounts[m];
+        fillPile(balls, count, settings);
+
+        float dt = 1.0f / HZ;
+        float now = 0.0f;
+        BallStepParams params;
+        for (int s = 0; s < SETTLE_STEPS; s++) {
+            now += dt;
+            setupBallStep(params, settings, dt, now);
+            stepBalls(balls, params, &grid, obstacles, pool.size() > 1 ? &pool : nullptr, BounceFn(), &solver);
+        }
+
+        size_t touching = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int s = 0; s < TIMED_STEPS; s++) {
+            now += dt;
+            setupBallStep(params, settings, dt, now);
+            touching = stepBalls(balls, params, &grid, obstacles, pool.size() > 1 ? &pool : nullptr, BounceFn(),
+                                 &solver).contacts;
+        }
+        double stepMs = secondsSince(start) * 1000.0 / TIMED_STEPS;
+
+        double meanOverlap, maxOverlap;
+        measureOverlap(balls, measureGrid, meanOverlap, maxOverlap);
+        char model[32];
+        if (iterationCounts[m] > 0) snprintf(model, sizeof(model), "pbd x%d", iterationCounts[m]);
+        else snprintf(model, sizeof(model), "impulse");
+        printf("%12s %12.3f %12.1f %12zu %14.4f %14.4f %10.4f\n", model, stepMs,
+               balls.getCount() ? stepMs * 1e6 / balls.getCount() : 0.0, touching, meanOverlap, maxOverlap,
+               meanSpeed(balls));
+        if (balls.getCount() != count)
+            printf("%12s %zu balls left the arena or expired\n", "", count - balls.getCount());
+    }
+    return 0;
+}
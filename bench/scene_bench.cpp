@@ -0,0 +1,86 @@
+/**
+ * Scene geometry benchmark.
+ * Times the ball-versus-level collision pass (SceneGeometry::collideBalls)
+ * for the same balls against levels of growing size, from an empty level
+ * up to a hundred thousand segments. With the grid the cost per ball
+ * should grow with the contacts it finds, not with the size of the
+ * level.
+ */
+#include "ballstore.h"
+#include "rng.h"
+#include "scenegeometry.h"
+#include "threadpool.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static const float WIDTH = 4000.0f;
+static const float HEIGHT = 3000.0f;
+static const int REPS = 20;
+
+// Short walls at random angles plus a peg for every ten of them
+static void buildLevel(SceneGeometry& scene, size_t segments) {
+    scene.clear();
+    Rng rng(5);
+    for (size_t i = 0; i < segments; i++) {
+        float x = rng.uniform(0.0f, WIDTH), y = rng.uniform(0.0f, HEIGHT);
+        float angle = rng.uniform(0.0f, 3.14159265f), length = rng.uniform(20.0f, 80.0f);
+        scene.addSegment(x, y, x + length * std::cos(angle), y + length * std::sin(angle));
+        if (i % 10 == 0) scene.addCircle(rng.uniform(0.0f, WIDTH), rng.uniform(0.0f, HEIGHT), rng.uniform(5.0f, 20.0f));
+    }
+    scene.build();
+}
+
+static void fillBalls(BallStore& balls, size_t count) {
+    balls.clear();
+    balls.reserve(count);
+    Rng rng(3);
+    for (size_t i = 0; i < count; i++) {
+        BallObject ball;
+        ball.x = rng.uniform(0.0f, WIDTH);
+        ball.y = rng.uniform(0.0f, HEIGHT);
+        ball.vx = rng.uniform(-8.0f, 8.0f);
+        ball.vy = rng.uniform(-8.0f, 8.0f);
+        ball.colorIndex = 0;
+        ball.type = SPHERE;
+        ball.size = rng.uniform(3.6f, 8.4f);
+        ball.launchTime = 0.0f;
+        size_t k = balls.push(ball);
+
+        // As if the ball had just moved one step along its velocity
+        balls.prevX[k] = ball.x - ball.vx;
+        balls.prevY[k] = ball.y - ball.vy;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? (size_t)atol(argv[1]) : 20000;
+    unsigned threads = argc > 2 ? (unsigned)atoi(argv[2]) : 0;
+
+    ThreadPool pool(threads);
+    BallStore balls;
+
+    printf("%zu balls, %u threads, %d passes per level\n", count, pool.size(), REPS);
+    printf("%10s %10s %10s %12s %12s %12s\n", "segments", "circles", "cells", "build ms", "ns/ball", "contacts");
+    const size_t levels[] = { 0, 100, 1000, 10000, 100000 };
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+        SceneGeometry scene;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        buildLevel(scene, levels[l]);
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+        double seconds = 0.0;
+        size_t contacts = 0;
+        for (int r = 0; r < REPS; r++) {
+            fillBalls(balls, count);
+            t0 = std::chrono::steady_clock::now();
+            contacts = scene.collideBalls(balls, 0.9f, pool.size() > 1 ? &pool : nullptr);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        }
+        printf("%10zu %10zu %10zu %12.3f %12.1f %12zu\n", scene.getSegments().size(), scene.getCircles().size(),
+               scene.cellCount(), buildMs, seconds * 1e9 / ((double)REPS * count), contacts);
+    }
+    return 0;
+}
@@ -3,24 +3,37 @@
 in  vec3 FragPos;
 in  vec3 Normal;
 in  vec2 TexCoord;          
+in  vec3 LightDir;
 
 out vec4 fColor;
 
 /* uniforms */
 uniform vec4  objColor;
-uniform vec3  lightDir;
-uniform vec3  viewPos;
 uniform sampler2D textureMap;
 
-uniform bool  useAmbient, useDiffuse, useSpecular;
-uniform float shininess;
-uniform float specularStrength;
+/* shared blocks (see uniformblocks.h) */
+layout(std140) uniform Camera {
+    layout(row_major) mat4 projection;  // This is actually view-projection combined
+    vec3  viewPos;
+    float viewportHeight;  // In pixels
+};
+
+layout(std140) uniform Light {
+    vec3 lightDir;
+    bool lightFollowsObject;  // Turn lightDir by the model matrix
+    bool useAmbient, useDiffuse, useSpecular;
+};
+
+layout(std140) uniform Material {
+    float shininess;
+    float specularStrength;
+};
 
 void main()
 {
     /* --- lighting ---------------------------------------------------- */
     vec3 n  = normalize(gl_FrontFacing ? Normal : -Normal);
-    vec3 L  = normalize(-lightDir);
+    vec3 L  = normalize(-LightDir);
     vec3 V  = normalize(viewPos - FragPos);
     vec3 R  = reflect(-L, n);
 
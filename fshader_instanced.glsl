@@ -0,0 +1,53 @@
+#version 410 core
+
+in  vec3 FragPos;
+in  vec3 Normal;
+in  vec2 TexCoord;
+in  vec4 Color;
+in  vec3 LightDir;
+
+out vec4 fColor;
+
+/* uniforms */
+uniform sampler2D textureMap;
+uniform bool  useTexture;
+
+/* shared blocks (see uniformblocks.h) */
+layout(std140) uniform Camera {
+    layout(row_major) mat4 projection;  // This is actually view-projection combined
+    vec3  viewPos;
+    float viewportHeight;  // In pixels
+};
+
+layout(std140) uniform Light {
+    vec3 lightDir;
+    bool lightFollowsObject;  // Turn lightDir by the model matrix
+    bool useAmbient, useDiffuse, useSpecular;
+};
+
+layout(std140) uniform Material {
+    float shininess;
+    float specularStrength;
+};
+
+void main()
+{
+    /* --- lighting, as in fshader.glsl with the ball's colour --------- */
+    vec3 n  = normalize(gl_FrontFacing ? Normal : -Normal);
+    vec3 L  = normalize(-LightDir);
+    vec3 V  = normalize(viewPos - FragPos);
+    vec3 R  = reflect(-L, n);
+
+    float diff = max(dot(n, L), 0.0);
+
+    vec3 ambient  = useAmbient  ? 0.5 * Color.rgb   : vec3(0.0);
+    vec3 diffuse  = useDiffuse  ? diff * Color.rgb  : vec3(0.0);
+    vec3 specular = vec3(0.0);
+    if (useSpecular && diff > 0.0)
+        specular = specularStrength * pow(max(dot(R, V), 0.0), shininess) * vec3(1.0);
+
+    /* --- texture ----------------------------------------------------- */
+    vec3 tex = useTexture ? texture(textureMap, TexCoord).rgb : vec3(1.0);
+
+    fColor = vec4( (ambient + diffuse + specular) * tex, Color.a );
+}
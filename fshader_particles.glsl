@@ -0,0 +1,16 @@
+#version 410 core
+
+in  vec4 Color;
+
+out vec4 fColor;
+
+void main()
+{
+    // Round sprite: full alpha at the centre, easing to nothing at the rim
+    float r2 = dot(gl_PointCoord * 2.0 - 1.0, gl_PointCoord * 2.0 - 1.0);
+    if (r2 > 1.0)
+        discard;
+    float falloff = 1.0 - smoothstep(0.0, 1.0, r2);
+
+    fColor = vec4(Color.rgb, Color.a * falloff);
+}
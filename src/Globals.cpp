@@ -33,14 +33,9 @@ RenderMode currentRenderMode = SHADING_MODE; // default
 bool useGouraud = false;
 
 /**
- * Physics constants that control simulation behavior
+ * Display constants (physics constants are defined in simulation.cpp)
  */
-const float GRAVITY = 0.35f;          // Gravitational acceleration
-const float RESTITUTION = 0.92f;      // Energy retention on bounce (1.0 = perfect bounce)
-const float BALL_SIZE = 60.0f;        // Base size of objects
 const float BUNNY_SCALE = 15.0f;      // Scale factor for bunny model
-const int MAX_TRAJECTORY_POINTS = 150; // Maximum number of points in trajectory
-const float AIR_RESISTANCE = 0.998f;  // Air resistance factor (1.0 = no resistance)
 
 /**
  * Global state variables for object properties
@@ -71,6 +66,7 @@ bool multipleObjects = false;   // Multiple objects mode
  * Physics state for main simulation object
  */
 float xPos = 0.0f, yPos = 0.0f;  // Position
+float prevXPos = 0.0f, prevYPos = 0.0f; // Position before the last step
 float xVel = 6.0f, yVel = -2.0f; // Velocity
 float initialVelocityX = 6.0f;   // Initial velocity for resets
 float initialVelocityY = -2.0f;  // Initial velocity for resets
@@ -81,6 +77,12 @@ float gravityStrength = GRAVITY; // Current gravity value
  * New feature variables
  */
 float simulationSpeed = 1.0f;    // Simulation speed multiplier
+float physicsHz = 120.0f;        // Fixed physics step rate
+int maxSubstepsPerFrame = 8;     // Physics steps allowed per rendered frame
+float renderAlpha = 1.0f;        // Interpolation between previous and current state
+bool parallelPhysics = true;     // Split large ball/particle sets over a thread pool
+int physicsThreads = 0;          // Worker count (0 = hardware concurrency)
+unsigned rngSeed = 1;            // Seed for spawning and particle streams
 vec4 backgroundColor = vec4(0.1f, 0.1f, 0.1f, 1.0f); // Background color
 int backgroundColorIndex = 0;    // Background color index
 float objectScale = 1.0f;        // Object scaling factor
@@ -89,32 +91,49 @@ vec4 gridColor = vec4(0.3f, 0.3f, 0.3f, 0.5f); // Grid color
 /**
  * Multiple objects mode variables
  */
-std::vector<BallObject> balls;   // List of ball objects
+BallStore balls;                 // SoA storage for ball objects
+BallRenderer ballRenderer;       // Instanced drawing of balls, one draw per mesh type
+bool ballCollisions = true;      // Resolve ball-ball contacts
+bool ballSleeping = true;        // Skip settled balls until something disturbs them
+int contactIterations = 8;       // Position-based contact iterations; 0 = impulse contacts
+bool ballAttraction = false;     // Balls pull on each other (Barnes-Hut)
+float attractionStrength = 2.0f; // Pull of a unit-size ball at unit distance, per reference frame
+bool eventPhysics = false;       // Analytic arcs and bounce events instead of fixed steps
 float launchInterval = 1.5f;     // Time between auto-launches
 float lastLaunchTime = 0.0f;     // Time of last launch
 
+/**
+ * Obstacle collision variables
+ */
+MeshBVH bunnyBVH;                      // BVH over the bunny triangles
+std::vector<MeshObstacle> obstacles;   // Static obstacles in the scene
+SceneGeometry sceneGeometry;           // Level segments and circles (scene.txt)
+unsigned sceneVersion = 0;             // Changes whenever sceneGeometry does
+
 /**
  * Particle effects variables
  */
-std::vector<Particle> particles; // List of particles
+ParticlePool particles;          // Fixed-capacity particle pool
+int particleBudget = 20000;      // Hard cap on live particles
+ParticleRenderer particleRenderer;  // All live particles in one draw call
 bool showParticles = false;      // Particle effects toggle
 
 /**
  * Trajectory visualization variables
  */
-std::deque<TrajectoryPoint> trajectoryPoints; // List of trajectory points
+TrajectoryHistory trajectory;    // Path of the ball in world space, at several levels of detail
+int trajectoryCapacity = 4096;   // Points per level; may be raised to millions
+float trajectoryTolerance = 0.5f; // Path error allowed at the finest level, in pixels
 
 /**
  * OpenGL shader variables
  */
-GLuint phongProgram = 0;
-GLuint gouraudProgram = 0;
-GLuint currentProgram = 0;
-GLuint modelLoc = 0;             // Model matrix uniform location
-GLuint projectionLoc = 0;        // Projection matrix uniform location
-GLuint objColorLoc = 0;          // Object color uniform location
-GLuint lightDirLoc = 0;          // Light direction uniform location
-GLuint viewPosLoc = 0;           // View position uniform location
+ShaderProgram phongProgram;                    // Per-pixel lighting
+ShaderProgram gouraudProgram;                  // Per-vertex lighting
+ShaderProgram* currentProgram = &phongProgram; // Program for lines and the S toggle
+ShaderProgram instancedProgram;                // Per-pixel lighting for instanced balls
+ShaderProgram particleProgram;                 // Soft round point sprites for particles
+UniformBlocks uniformBlocks;                   // Shared camera, light and material blocks
 
 /**
  * Cube geometry data
@@ -151,6 +170,8 @@ float cubeRotation = 0.0f;       // Cube rotation angle
  * Trajectory rendering variables
  */
 GLuint vaoTrajectory = 0, vboTrajectory = 0; // Trajectory VAO and VBO handles
+GLuint vaoGrid = 0, vboGrid = 0;             // Grid line VAO and VBO handles
+GLuint vaoScene = 0, vboScene = 0;           // Scene geometry VAO and VBO handles
 
 /**
  * Prints help information to the console
@@ -177,6 +198,14 @@ void printHelp() {
     std::cout << "    2: Switch to Sphere\n";
     std::cout << "    3: Switch to Bunny\n";
     std::cout << "    c: Change color\n";
+    std::cout << "    K: Toggle obstacles (Cube/Sphere/Bunny)\n";
+    std::cout << "    F8: Toggle the level in scene.txt\n";
+    std::cout << "    J: Toggle event-driven physics (multi-object mode)\n";
+    std::cout << "    N: Cycle contact solver iterations (0 = impulse contacts)\n";
+    std::cout << "    A: Toggle mutual attraction between balls (multi-object mode)\n";
+    std::cout << "    U: Start/stop recording multi-object steps (see sim_replay)\n";
+    std::cout << "    F6: Save a checkpoint (checkpoint.bbsnap)\n";
+    std::cout << "    F7: Restore the last checkpoint\n";
     std::cout << "\n  Mouse Controls:\n";
     std::cout << "    Left: Toggle wireframe/solid\n";
     std::cout << "    Right: Cycle objects\n";
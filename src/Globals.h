@@ -2,12 +2,25 @@
 #define GLOBALS_H
 
 #include "Angel.h"
+#include "ballrenderer.h"
+#include "particlerenderer.h"
+#include "ballstore.h"
+#include "meshcollision.h"
+#include "particlepool.h"
+#include "scenegeometry.h"
+#include "shader.h"
+#include "simulation.h"
+#include "trajectory.h"
+#include "uniformblocks.h"
 #include <vector>
-#include <deque>
 #include <string>
 
-// Shader program handles
-extern GLuint phongProgram, gouraudProgram, currentProgram;
+// Shader programs with their uniform tables (see shader.h)
+extern ShaderProgram phongProgram, gouraudProgram;
+extern ShaderProgram* currentProgram;
+extern ShaderProgram instancedProgram;  // Multi-object balls (see ballrenderer.h)
+extern ShaderProgram particleProgram;   // Particle sprites (see particlerenderer.h)
+extern UniformBlocks uniformBlocks;     // Camera, light and material shared by every program
 
 // Lighting and material properties
 extern bool lightFollowsObject;
@@ -34,16 +47,10 @@ extern bool useGouraud;
 extern int windowWidth;
 extern int windowHeight;
 
-// Constants
-extern const float GRAVITY;
-extern const float RESTITUTION;
-extern const float BALL_SIZE;
+// Constants (physics constants live in simulation.h)
 extern const float BUNNY_SCALE;
-extern const int MAX_TRAJECTORY_POINTS;
-extern const float AIR_RESISTANCE;
 
-// Enumerations
-enum ObjectType { CUBE, SPHERE, BUNNY };
+// Enumerations (ObjectType lives in ballstore.h)
 enum DrawingMode { WIREFRAME, SOLID };
 enum TrajectoryMode { NONE, LINE, STROBE };
 enum GridMode { GRID_NONE, GRID_BASIC, GRID_DETAILED };
@@ -61,6 +68,7 @@ extern bool multipleObjects;
 
 // Physics for a single object
 extern float xPos, yPos;
+extern float prevXPos, prevYPos;  // Position before the last physics step
 extern float xVel, yVel;
 extern float initialVelocityX, initialVelocityY;
 extern float currentTime;
@@ -69,6 +77,18 @@ extern float gravityStrength;
 // Simulation speed control
 extern float simulationSpeed;
 
+// Fixed-step physics scheduling
+extern float physicsHz;
+extern int maxSubstepsPerFrame;
+extern float renderAlpha;  // Interpolation factor between physics states
+
+// Multithreaded physics
+extern bool parallelPhysics;
+extern int physicsThreads;  // 0 = one per hardware thread
+
+// Seed for ball spawning and particle emission (see rng.h)
+extern unsigned rngSeed;
+
 // Background color options
 extern vec4 backgroundColor;
 extern int backgroundColorIndex;
@@ -81,40 +101,36 @@ extern GridMode gridMode;
 extern vec4 gridColor;
 extern GLuint texID;
 
-// Multi-object mode
-struct BallObject {
-    float x, y;
-    float vx, vy;
-    int colorIndex;
-    ObjectType type;
-    float size;
-    float launchTime;
-};
-extern std::vector<BallObject> balls;
+// Multi-object mode (structure-of-arrays, see ballstore.h)
+extern BallStore balls;
+extern BallRenderer ballRenderer;
+extern bool ballCollisions;
+extern bool ballSleeping;  // Settled balls go dormant until disturbed
+extern int contactIterations;  // Ball-ball contact solver iterations per step (see pbdsolver.h)
+extern bool ballAttraction;  // Mutual attraction between balls (see barneshut.h)
+extern float attractionStrength;
+extern bool eventPhysics;  // Event-driven ballistic engine (see ballistic.h)
 extern float launchInterval;
 extern float lastLaunchTime;
 
-// Particle effect
-struct Particle {
-    vec2 position;
-    vec2 velocity;
-    vec4 color;
-    float life;
-    float size;
-};
-extern std::vector<Particle> particles;
-extern bool showParticles;
+// Static obstacles the balls collide with (see meshcollision.h)
+extern MeshBVH bunnyBVH;
+extern std::vector<MeshObstacle> obstacles;
+
+// Static level loaded from a scene file (see scenegeometry.h)
+extern SceneGeometry sceneGeometry;
+extern unsigned sceneVersion;  // Bumped whenever the level changes, so it is uploaded again
 
-// Trajectory visualization
-struct TrajectoryPoint {
-    vec2 position;
-    float timeStamp;
-};
-extern std::deque<TrajectoryPoint> trajectoryPoints;
+// Particle effect (structure-of-arrays pool, see particlepool.h)
+extern ParticlePool particles;
+extern int particleBudget;  // Hard cap on live particles
+extern ParticleRenderer particleRenderer;
+extern bool showParticles;
 
-// OpenGL variables
-extern GLuint modelLoc, projectionLoc, objColorLoc;
-extern GLuint lightDirLoc, viewPosLoc;
+// Trajectory visualization (simplified world-space history, see trajectory.h)
+extern TrajectoryHistory trajectory;
+extern int trajectoryCapacity;     // Points kept per level of detail before the oldest are overwritten
+extern float trajectoryTolerance;  // Largest distance in pixels between the kept and the true path
 
 // Cube data
 extern std::vector<vec4> cubeVertices;
@@ -141,6 +157,8 @@ extern float cubeRotation;
 
 // Trajectory buffers
 extern GLuint vaoTrajectory, vboTrajectory;
+extern GLuint vaoGrid, vboGrid;
+extern GLuint vaoScene, vboScene;
 
 // Function to print help information
 void printHelp();
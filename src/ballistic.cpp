@@ -0,0 +1,583 @@
+#include "ballistic.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static const double NEVER = std::numeric_limits<double>::infinity();
+
+// Below this decay rate the drag-free formulas are used
+static const double MIN_DRAG = 1e-9;
+
+// Same thresholds as integrateBallRange
+static const double MIN_BOUNCE = 0.5;
+static const double MIN_ENERGY = 0.1;
+
+// Series in k = v / vt for a throw from the floor back down to it, see returnTime
+static const int RETURN_TERMS = 10;
+static const double RETURN_MAX_K = 0.05;
+static const double RETURN_TIME[RETURN_TERMS] = {
+    2.0, -2.0 / 3.0, 4.0 / 9.0, -44.0 / 135.0, 104.0 / 405.0, -40.0 / 189.0, 7648.0 / 42525.0,
+    -2848.0 / 18225.0, 31712.0 / 229635.0, -23429344.0 / 189448875.0};
+static const double RETURN_DECAY[RETURN_TERMS + 1] = {
+    1.0, -2.0, 8.0 / 3.0, -28.0 / 9.0, 464.0 / 135.0, -1496.0 / 405.0, 11072.0 / 2835.0,
+    -173728.0 / 42525.0, 108224.0 / 25515.0, -1005728.0 / 229635.0, 853154944.0 / 189448875.0};
+
+// Carry a cached contact decay over to a flight rebased by decay
+static inline double shiftDecay(double other, double decay) {
+    return decay > 0.0 ? other / decay : 0.0;
+}
+
+BallisticSim::BallisticSim()
+    : buckets(RING_BUCKETS), drainSlot(NO_LIST), bucketRate(1.0), cursor(0), ringBase(0), storeGeneration(0),
+      posRate(0.0), posInverse(0.0), accel(0.0), fallRate(0.0), drag(0.0), timeConstant(0.0), terminal(0.0) {
+    updateRates();
+}
+
+/**
+ * Convert the per-reference-frame constants to rates per simulated
+ * second. Simulated time runs speed times faster than wall time while
+ * velocities and gravity are per wall-clock frame, so displacement per
+ * simulated second does not depend on speed but gravity and drag do.
+ */
+void BallisticSim::updateRates() {
+    double speed = std::max((double)settings.speed, 1e-6);
+    double air = std::min(std::max((double)settings.airResistance, 1e-6), 1.0);
+    setupBallStep(limits, settings, 0.0f, 0.0f);
+    posRate = REFERENCE_HZ;
+    posInverse = 1.0 / posRate;
+    accel = std::max((double)settings.gravity, 0.0) * REFERENCE_HZ / speed;  // Negative gravity is treated as zero
+    fallRate = accel > 0.0 ? 1.0 / accel : 0.0;
+    drag = -std::log(air) * REFERENCE_HZ / speed;
+    terminal = drag > MIN_DRAG ? accel / drag : 0.0;
+    timeConstant = drag > MIN_DRAG ? 1.0 / drag : 0.0;
+    bucketRate = REFERENCE_HZ / speed;  // One bucket per reference frame
+}
+
+void BallisticSim::configure(const SimSettings& s, double now) {
+    if (s.width == settings.width && s.height == settings.height && s.gravity == settings.gravity &&
+        s.airResistance == settings.airResistance && s.restitution == settings.restitution &&
+        s.speed == settings.speed && s.maxLifetime == settings.maxLifetime)
+        return;
+
+    // Freeze every ball at now under the old constants before switching
+    for (size_t i = 0; i < flights.size(); i++) rebase(flights[i], now);
+    settings = s;
+    updateRates();
+    for (size_t i = 0; i < flights.size(); i++) {
+        Flight& f = flights[i];
+        setLimits(f);
+        // A moved floor leaves resting balls in the air (or below it)
+        if (f.resting && f.y0 != f.floor) f.resting = false;
+    }
+    rescheduleAll(now);
+}
+
+void BallisticSim::reset(const BallStore& balls, double now) {
+    flights.clear();
+    eventRefs.clear();
+    flights.reserve(balls.getCount());
+    eventRefs.reserve(balls.getCount());
+    clearEvents(now);
+    storeGeneration = balls.getGeneration();
+    for (size_t i = 0; i < balls.getCount(); i++) addBall(balls, i, now);
+}
+
+void BallisticSim::sync(const BallStore& balls, double now) {
+    if (balls.getGeneration() != storeGeneration || balls.getCount() < flights.size()) {
+        reset(balls, now);
+        return;
+    }
+    for (size_t i = flights.size(); i < balls.getCount(); i++) addBall(balls, i, now);
+}
+
+BallisticResult BallisticSim::advance(BallStore& balls, double now, const BounceFn& onBounce) {
+    sync(balls, now);
+    for (size_t i = 0; i < balls.getCount(); i++) {
+        balls.prevX[i] = balls.x[i];
+        balls.prevY[i] = balls.y[i];
+    }
+    BallisticResult result = advanceEvents(balls, now, onBounce);
+    evaluate(balls, now);
+    return result;
+}
+
+BallisticResult BallisticSim::advanceEvents(BallStore& balls, double now, const BounceFn& onBounce) {
+    BallisticResult result;
+    int64_t last = std::max(bucketOf(now), cursor);
+    for (;; cursor++) {
+        // Half the ring is behind the cursor again; move in the overflow that now fits
+        if (cursor - ringBase >= RING_BUCKETS / 2) refillRing();
+        if (cursor == last) break;
+
+        // The whole bucket is due and nothing handled here is filed back into it (it lands
+        // at last or later), so it is taken out at once and walked front to back
+        drainSlot = (int32_t)(cursor & (RING_BUCKETS - 1));
+        draining.swap(buckets[drainSlot]);
+        for (size_t j = 0; j < draining.size(); j++) {
+            size_t i = draining[j].ball;  // Kept current by removeBall
+            eventRefs[i].list = NO_LIST;
+            handleDue(balls, i, draining[j].time, now, onBounce, result);
+        }
+        draining.clear();
+        drainSlot = NO_LIST;
+    }
+
+    // The bucket holding now is only partly due. Handled events leave it (or go to its
+    // end), so j only moves past future ones
+    std::vector<Event>& bucket = buckets[cursor & (RING_BUCKETS - 1)];
+    for (size_t j = 0; j < bucket.size();) {
+        Event e = bucket[j];
+        if (e.time > now) {
+            j++;
+            continue;
+        }
+        unlink(e.ball);
+        handleDue(balls, e.ball, e.time, now, onBounce, result);
+    }
+    return result;
+}
+
+/**
+ * Handle ball i's event at time, already taken out of the calendar, and
+ * any of its events that follow up to now, then file the next one
+ */
+void BallisticSim::handleDue(BallStore& balls, size_t i, double time, double now, const BounceFn& onBounce,
+                             BallisticResult& result) {
+    Flight& f = flights[i];
+    do {
+        result.events++;
+        if (handleEvent(balls, i, time, onBounce, result)) return;
+        time = nextEvent(f);
+    } while (time <= now);
+    if (f.kind != EV_NONE) link(i, time);  // Otherwise nothing will ever happen to the ball
+}
+
+/**
+ * Apply ball i's pending event at time. Returns true if the ball came to
+ * rest or expired and was removed.
+ */
+bool BallisticSim::handleEvent(BallStore& balls, size_t i, double time, const BounceFn& onBounce,
+                               BallisticResult& result) {
+    Flight& f = flights[i];
+    switch (f.kind) {
+        case EV_LEFT:
+        case EV_RIGHT:
+            rebase(f, time, f.wallDecay);
+            f.floorDecay = shiftDecay(f.floorDecay, f.wallDecay);
+            f.x0 = f.kind == EV_LEFT ? f.left : f.right;
+            if ((f.kind == EV_LEFT) == (f.vx0 < 0.0)) f.vx0 = -f.vx0 * settings.restitution;
+            if (f.right <= f.left) f.vx0 = 0.0;  // No room to move sideways
+            planWall(f);  // The fall is unchanged
+            return false;
+        case EV_FLOOR:
+            rebase(f, time, f.floorDecay);
+            f.wallDecay = shiftDecay(f.wallDecay, f.floorDecay);
+            f.y0 = f.floor;
+            if (f.vy0 > 0.0) f.vy0 = -f.vy0 * settings.restitution;
+            if (std::fabs(f.vy0) < MIN_BOUNCE) {
+                f.vy0 = 0.0;
+                f.resting = true;
+            }
+            planFloor(f);  // The sideways motion is unchanged
+            result.bounces++;
+            if (onBounce) {
+                balls.x[i] = (float)f.x0;
+                balls.y[i] = (float)f.y0;
+                onBounce(i, 0);
+            }
+            return false;
+        default:  // Rest or expiry: the ball leaves without being moved
+            removeBall(balls, i);
+            result.removed++;
+            return true;
+    }
+}
+
+void BallisticSim::evaluate(BallStore& balls, double now) const {
+    for (size_t i = 0; i < flights.size(); i++) {
+        double x, y, vx, vy;
+        stateAt(flights[i], now, x, y, vx, vy);
+        balls.x[i] = (float)x;
+        balls.y[i] = (float)y;
+        balls.vx[i] = (float)vx;
+        balls.vy[i] = (float)vy;
+    }
+}
+
+void BallisticSim::addBall(const BallStore& balls, size_t i, double now) {
+    Flight f;
+    f.t0 = now;
+    f.x0 = balls.x[i];
+    f.y0 = balls.y[i];
+    f.vx0 = balls.vx[i];
+    f.vy0 = balls.vy[i];
+    f.size = balls.size[i];
+    f.type = (int8_t)balls.type[i];
+    f.launchTime = balls.launchTime[i];
+    f.resting = false;
+    setLimits(f);
+    planWall(f);
+    planFloor(f);
+    EventRef ref;
+    ref.list = NO_LIST;
+    ref.pos = 0;
+    flights.push_back(f);
+    eventRefs.push_back(ref);
+    schedule(flights.size() - 1);
+}
+
+void BallisticSim::removeBall(BallStore& balls, size_t i) {
+    unlink(i);
+
+    // The last flight fills the slot, as swapRemove does in the store
+    size_t last = flights.size() - 1;
+    if (i != last) {
+        flights[i] = flights[last];
+        eventRefs[i] = eventRefs[last];
+        if (eventRefs[i].list != NO_LIST) eventList(eventRefs[i].list)[eventRefs[i].pos].ball = (uint32_t)i;
+    }
+    flights.pop_back();
+    eventRefs.pop_back();
+    balls.swapRemove(i);
+}
+
+/**
+ * Walls and floor moved in by the ball's outline, as in integrateBallRange
+ */
+void BallisticSim::setLimits(Flight& f) const {
+    f.left = limits.left + f.size * limits.extentX[f.type];
+    f.right = limits.right - f.size * limits.extentX[f.type];
+    f.floor = limits.bottom - f.size * limits.extentY[f.type];
+}
+
+/**
+ * Closed-form state at time t. With drag c and terminal speed vt:
+ *   v(t) = vt + (v0 - vt) e^(-ct)
+ *   x(t) = x0 + p (vt t + (v0 - vt)(1 - e^(-ct)) / c)
+ * and the plain constant-acceleration arc when c is zero.
+ */
+void BallisticSim::stateAt(const Flight& f, double t, double& x, double& y, double& vx, double& vy) const {
+    double dt = std::max(t - f.t0, 0.0);
+    // 1 - decay loses digits only for spans far below a pixel of motion, so exp is enough
+    stateAfter(f, dt, drag > MIN_DRAG ? std::exp(-drag * dt) : 1.0, x, y, vx, vy);
+}
+
+// State dt after t0 where decay is e^(-c dt), already known to the caller
+void BallisticSim::stateAfter(const Flight& f, double dt, double decay, double& x, double& y, double& vx,
+                              double& vy) const {
+    if (drag > MIN_DRAG) {
+        double integral = (1.0 - decay) * timeConstant;
+        vx = f.vx0 * decay;
+        x = f.x0 + posRate * f.vx0 * integral;
+        vy = terminal + (f.vy0 - terminal) * decay;
+        y = f.y0 + posRate * (terminal * dt + (f.vy0 - terminal) * integral);
+    } else {
+        vx = f.vx0;
+        x = f.x0 + posRate * f.vx0 * dt;
+        vy = f.vy0 + accel * dt;
+        y = f.y0 + posRate * (f.vy0 * dt + 0.5 * accel * dt * dt);
+    }
+    if (f.resting) {
+        y = f.y0;
+        vy = 0.0;
+    }
+}
+
+// Height and falling speed dt after t0, the vertical half of stateAfter
+void BallisticSim::heightAt(const Flight& f, double dt, double decay, double& y, double& vy) const {
+    if (drag > MIN_DRAG) {
+        vy = terminal + (f.vy0 - terminal) * decay;
+        y = f.y0 + posRate * (terminal * dt + (f.vy0 - terminal) * (1.0 - decay) * timeConstant);
+    } else {
+        vy = f.vy0 + accel * dt;
+        y = f.y0 + posRate * (f.vy0 * dt + 0.5 * accel * dt * dt);
+    }
+}
+
+void BallisticSim::rebase(Flight& f, double t) const {
+    double dt = std::max(t - f.t0, 0.0);
+    rebase(f, t, drag > MIN_DRAG ? std::exp(-drag * dt) : 1.0);
+}
+
+// Restart the arc at t, where decay is e^(-c (t - t0))
+void BallisticSim::rebase(Flight& f, double t, double decay) const {
+    double x, y, vx, vy;
+    stateAfter(f, std::max(t - f.t0, 0.0), decay, x, y, vx, vy);
+    f.t0 = t;
+    f.x0 = x;
+    f.y0 = y;
+    f.vx0 = vx;
+    f.vy0 = vy;
+}
+
+/**
+ * Time the ball reaches the wall it is heading for. Horizontal motion
+ * has no gravity, so x(t) inverts exactly:
+ *   t = -ln(1 - c d / (p v0)) / c  for a wall at distance d
+ * and the decay there is 1 - c d / (p v0).
+ */
+double BallisticSim::wallTime(const Flight& f, int& kind, double& decay) const {
+    kind = EV_NONE;
+    decay = 1.0;
+    if (f.x0 < f.left) { kind = EV_LEFT; return f.t0; }
+    if (f.x0 > f.right) { kind = EV_RIGHT; return f.t0; }
+    if (f.vx0 == 0.0) return NEVER;
+
+    kind = f.vx0 > 0.0 ? EV_RIGHT : EV_LEFT;
+    double d = (f.vx0 > 0.0 ? f.right : f.left) - f.x0;
+    if (drag <= MIN_DRAG) return f.t0 + d / (posRate * f.vx0);
+
+    double reach = drag * d / (posRate * f.vx0);
+    if (reach >= 1.0) return NEVER;  // Drag stops the ball short of the wall
+    decay = 1.0 - reach;
+    return f.t0 - std::log1p(-reach) / drag;
+}
+
+// Cache the time, side and decay of the next wall contact
+void BallisticSim::planWall(Flight& f) const {
+    int kind;
+    f.wallAt = wallTime(f, kind, f.wallDecay);
+    f.wallKind = (int8_t)kind;
+}
+
+// Cache the time and decay of the next floor contact
+void BallisticSim::planFloor(Flight& f) const {
+    f.floorAt = floorTime(f, f.floorDecay);
+}
+
+/**
+ * Time the ball next lands on the floor. After the apex (or from the
+ * start when already falling) y only increases. Expanding the arc in
+ * the drag c,
+ *   y(t) = y0 + p (v0 t + a t^2 / 2 - c (v0 t^2 / 2 + a t^3 / 6)
+ *                  + c^2 (v0 t^3 / 6 + a t^4 / 24)) + O(c^3)
+ * Newton steps on the first and second order terms from the drag-free
+ * landing time give a close guess without any exponential. The higher
+ * derivatives of y are known in closed form, so a Halley step from there
+ * usually lands within 1e-7 of the floor and its error estimate says
+ * so, leaving one exp per bounce; its decay, moved by the step, is the
+ * decay at the contact. Only if the steps stall is the crossing
+ * bracketed by doubling and refined inside the bracket.
+ */
+double BallisticSim::floorTime(const Flight& f, double& decay) const {
+    decay = 1.0;
+    if (f.resting) return NEVER;
+    if (f.y0 >= f.floor && (f.vy0 >= 0.0 || f.y0 > f.floor)) return f.t0;
+    if (accel <= 0.0) {
+        // Without gravity the fall is the wall case in y
+        if (f.vy0 <= 0.0) return NEVER;
+        double d = f.floor - f.y0;
+        if (drag <= MIN_DRAG) return f.t0 + d / (posRate * f.vy0);
+        double reach = drag * d / (posRate * f.vy0);
+        if (reach >= 1.0) return NEVER;
+        decay = 1.0 - reach;
+        return f.t0 - std::log1p(-reach) / drag;
+    }
+    if (f.y0 == f.floor && f.vy0 < 0.0 && drag > MIN_DRAG) {
+        double t;
+        if (returnTime(f, t, decay)) return f.t0 + t;
+    }
+
+    // Drag-free: y0 + p (v0 t + a t^2 / 2) = floor, exact when there is no drag
+    double d = f.floor - f.y0;
+    double drop = d * posInverse;  // In units of the velocity integral, y / p
+    double land = std::sqrt(f.vy0 * f.vy0 + 2.0 * accel * drop);  // Drag-free landing speed
+    double guess = (land - f.vy0) * fallRate;
+    if (drag <= MIN_DRAG) return f.t0 + guess;
+
+    const double sixth = 1.0 / 6.0, twentyFourth = 1.0 / 24.0;
+    double t = guess + drag * guess * guess * (0.5 * f.vy0 + sixth * accel * guess) / land;
+    if (t > 0.0) {
+        double v0 = f.vy0, a = accel, c = drag;
+        double g = t * (v0 + t * (0.5 * a - c * (0.5 * v0 + sixth * a * t) +
+                                  c * c * t * (sixth * v0 + twentyFourth * a * t))) -
+                   drop;
+        double slope = v0 + a * t - c * t * (v0 + 0.5 * a * t) + c * c * t * t * (0.5 * v0 + sixth * a * t);
+        double next = t - g / slope;
+        if (next > 0.0) t = next;
+    } else {
+        t = guess;
+    }
+
+    double y, vy;
+    for (int k = 0; k < 8; k++) {
+        decay = std::exp(-drag * t);
+        heightAt(f, t, decay, y, vy);
+        if (vy <= 0.0) break;  // Before the apex
+        double h = y - f.floor;
+        double slope = posRate * vy;
+        double curve = posRate * (accel - drag * vy);
+        double step = 2.0 * h * slope / (2.0 * slope * slope - h * curve);
+
+        // Halley leaves a time error of about K step^3, with K = y''^2 / 4y'^2 - y''' / 6y' and y''' = -c y''
+        double k3 = std::fabs(0.25 * curve * curve + sixth * drag * curve * slope);  // K y'^2
+        if (k3 * std::fabs(step * step * step) < 1e-7 * slope) {
+            // e^(c step) to within (c step)^4 / 24 of a relative error
+            double u = drag * step;
+            decay *= std::fabs(u) < 1e-3 ? 1.0 + u * (1.0 + u * (0.5 + sixth * u)) : std::exp(u);
+            return f.t0 + t - step;
+        }
+        if (!(std::fabs(step) < t)) break;
+        t -= step;
+    }
+
+    double lo = 0.0;
+    if (f.vy0 < 0.0) lo = std::log1p(-f.vy0 / terminal) / drag;  // Apex
+    heightAt(f, lo, std::exp(-drag * lo), y, vy);
+    double fall = f.floor - y;
+    double step = std::sqrt(2.0 * std::max(fall, 1e-3) / (posRate * accel));
+    double hi = lo + step;
+    for (int k = 0;; k++) {
+        heightAt(f, hi, std::exp(-drag * hi), y, vy);
+        if (y >= f.floor) break;
+        if (k == 60) return NEVER;
+        lo = hi;
+        step *= 2.0;
+        hi = lo + step;
+    }
+
+    t = hi;
+    for (int k = 0; k < 60; k++) {
+        heightAt(f, t, std::exp(-drag * t), y, vy);
+        double h = y - f.floor;
+        if (std::fabs(h) < 1e-6) break;
+        if (h > 0.0) hi = t; else lo = t;
+        double next = vy > 0.0 ? t - h / (posRate * vy) : 0.5 * (lo + hi);
+        if (next <= lo || next >= hi) next = 0.5 * (lo + hi);
+        if (hi - lo < 1e-12) break;
+        t = next;
+    }
+    decay = std::exp(-drag * t);
+    return f.t0 + t;
+}
+
+/**
+ * Flight time of a ball thrown up at speed v from the floor back down to
+ * it, which is every flight after a bounce. With k = v / vt the scaled
+ * time tau = c t solves tau = (1 + k)(1 - e^(-tau)), and reverting the
+ * series of k in tau gives
+ *   t = (v / a)(2 - 2k/3 + 4k^2/9 - ...),  e^(-tau) = 1 - 2k + 8k^2/3 - ...
+ * Ten terms are good to about 1e-14 for k up to RETURN_MAX_K, some 9
+ * pixels per frame at the default drag; faster throws return false and
+ * take the general path.
+ */
+bool BallisticSim::returnTime(const Flight& f, double& t, double& decay) const {
+    double k = -f.vy0 * drag * fallRate;
+    if (k > RETURN_MAX_K) return false;
+    double scale = RETURN_TIME[RETURN_TERMS - 1];
+    double fraction = RETURN_DECAY[RETURN_TERMS];
+    for (int n = RETURN_TERMS - 1; n > 0; n--) {
+        scale = scale * k + RETURN_TIME[n - 1];
+        fraction = fraction * k + RETURN_DECAY[n];
+    }
+    t = -f.vy0 * fallRate * scale;
+    decay = fraction * k + RETURN_DECAY[0];
+    return true;
+}
+
+/**
+ * Time a ball sliding on the floor slows below the expiry energy;
+ * |vx| decays as e^(-ct)
+ */
+double BallisticSim::restTime(const Flight& f) const {
+    if (!f.resting) return NEVER;
+    double speed = std::fabs(f.vx0);
+    if (speed < MIN_ENERGY) return f.t0;
+    if (drag <= MIN_DRAG) return NEVER;
+    return f.t0 + std::log(speed / MIN_ENERGY) / drag;
+}
+
+/**
+ * Pick the earliest upcoming event of a ball from its cached contact
+ * times, store its kind and return its time
+ */
+double BallisticSim::nextEvent(Flight& f) const {
+    int kind = f.wallKind;
+    double time = f.wallAt;
+    if (f.floorAt < time) { time = f.floorAt; kind = EV_FLOOR; }
+    double restAt = restTime(f);
+    if (restAt < time) { time = restAt; kind = EV_REST; }
+    double expireAt = (double)f.launchTime + settings.maxLifetime;
+    if (expireAt < time) { time = expireAt; kind = EV_EXPIRE; }
+    f.kind = (int8_t)kind;
+    return kind != EV_NONE ? std::max(time, f.t0) : NEVER;
+}
+
+// File ball i's next event in the calendar
+void BallisticSim::schedule(size_t i) {
+    double time = nextEvent(flights[i]);
+    unlink(i);
+    if (flights[i].kind != EV_NONE) link(i, time);  // Otherwise nothing will ever happen to the ball
+}
+
+void BallisticSim::rescheduleAll(double now) {
+    clearEvents(now);
+    for (size_t i = 0; i < flights.size(); i++) {
+        Flight& f = flights[i];
+        eventRefs[i].list = NO_LIST;
+        planWall(f);
+        planFloor(f);
+        schedule(i);
+    }
+}
+
+// Empty the calendar and start it at time now
+void BallisticSim::clearEvents(double now) {
+    for (size_t k = 0; k < buckets.size(); k++) buckets[k].clear();
+    overflow.clear();
+    cursor = ringBase = std::max<int64_t>(bucketOf(now), 0);
+}
+
+int64_t BallisticSim::bucketOf(double t) const {
+    return (int64_t)std::floor(t * bucketRate);
+}
+
+/**
+ * File ball i's event at time: in the cursor's bucket if it is already
+ * due, in its own bucket within the ring, or in the overflow list
+ */
+void BallisticSim::link(size_t i, double time) {
+    EventRef& ref = eventRefs[i];
+    if (time * bucketRate >= (double)(ringBase + RING_BUCKETS)) {
+        ref.list = OVERFLOW_LIST;
+    } else {
+        int64_t k = std::max(bucketOf(time), cursor);
+        ref.list = (int32_t)(k & (RING_BUCKETS - 1));
+    }
+    std::vector<Event>& list = eventList(ref.list);
+    ref.pos = (uint32_t)list.size();
+    Event e;
+    e.time = time;
+    e.ball = (uint32_t)i;
+    list.push_back(e);
+}
+
+// Take ball i's event out of its list; the list's last entry fills the gap
+void BallisticSim::unlink(size_t i) {
+    EventRef& ref = eventRefs[i];
+    if (ref.list == NO_LIST) return;
+    std::vector<Event>& list = eventList(ref.list);
+    list[ref.pos] = list.back();
+    eventRefs[list[ref.pos].ball].pos = ref.pos;
+    list.pop_back();
+    ref.list = NO_LIST;
+}
+
+/**
+ * Slide the ring forward to start at the cursor and file the overflow
+ * events that fall inside it. Buckets behind the cursor are empty, so
+ * they are free to take the buckets past the old end.
+ */
+void BallisticSim::refillRing() {
+    ringBase = cursor;
+    double ringEnd = (double)(ringBase + RING_BUCKETS);
+    for (size_t j = 0; j < overflow.size();) {
+        Event e = overflow[j];
+        if (e.time * bucketRate >= ringEnd) {
+            j++;
+            continue;
+        }
+        unlink(e.ball);  // The last overflow entry moves to j
+        link(e.ball, e.time);
+    }
+}
@@ -0,0 +1,172 @@
+#ifndef BALLISTIC_H
+#define BALLISTIC_H
+
+#include "ballstore.h"
+#include "simulation.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Outcome of one BallisticSim::advance call
+struct BallisticResult {
+    size_t events;   // Wall, floor, rest and expiry events processed
+    size_t bounces;  // Floor bounces
+    size_t removed;  // Balls that expired or came to rest
+
+    BallisticResult() : events(0), bounces(0), removed(0) {}
+};
+
+/**
+ * Event-driven alternative to stepBalls for multi-object mode.
+ * Between contacts every ball follows a closed-form arc (gravity plus
+ * exponential air drag), so only wall, floor and expiry events cost
+ * anything; positions are evaluated on demand.
+ *
+ * Each ball has exactly one pending event, filed in a calendar queue:
+ * a ring of buckets one reference frame of simulated time wide, with
+ * events past the ring's end kept in an overflow list until the ring
+ * reaches them. Filing, moving and removing an event are O(1). Balls do
+ * not interact in this mode, so events only need to be in order per
+ * ball: a bucket is processed in whatever order it holds, a bucket that
+ * is wholly due is emptied in one go, and a ball's events that fall due
+ * one after another are handled back to back before it is filed again.
+ *
+ * The wall and floor times are cached per ball along with the drag decay
+ * of the arc at each: horizontal and vertical motion are independent, so
+ * a wall contact only recomputes the wall time and a bounce only the
+ * floor time, and moving a ball onto its contact takes no exponential.
+ * After a bounce the flight back to the floor is a power series in the
+ * launch speed (see returnTime).
+ *
+ * Ball i of the engine is always ball i of the BallStore passed to
+ * reset/advance; removals are mirrored into the store with swapRemove.
+ * Ball-ball contacts and obstacles are not simulated in this mode.
+ */
+class BallisticSim {
+public:
+    BallisticSim();
+
+    /**
+     * Set the arena and physics constants, taking effect at time now.
+     * Shape extents are those of setupBallStep. Pending events are
+     * rescheduled only if something changed.
+     */
+    void configure(const SimSettings& settings, double now);
+
+    // Replace every ball with the contents of balls at time now
+    void reset(const BallStore& balls, double now);
+
+    /**
+     * Adopt balls appended to the store since the last call. A store that
+     * shrank, or was cleared or loaded since the last reset, is reloaded.
+     */
+    void sync(const BallStore& balls, double now);
+
+    /**
+     * Process every event up to time now, then write each ball's position
+     * and velocity at now into balls (previous positions go to
+     * prevX/prevY). onBounce is called for each floor bounce with the
+     * ball's contact position already written to balls.x/y.
+     */
+    BallisticResult advance(BallStore& balls, double now, const BounceFn& onBounce);
+
+    // Process events up to time now without touching positions in balls
+    BallisticResult advanceEvents(BallStore& balls, double now, const BounceFn& onBounce);
+
+    // Write positions and velocities of every ball at time now
+    void evaluate(BallStore& balls, double now) const;
+
+    size_t size() const { return flights.size(); }
+
+private:
+    enum EventKind { EV_LEFT, EV_RIGHT, EV_FLOOR, EV_REST, EV_EXPIRE, EV_NONE };
+
+    // Closed-form trajectory segment starting at t0
+    struct Flight {
+        double t0;
+        double x0, y0;
+        double vx0, vy0;
+        double wallAt, floorAt;        // Absolute times of the next contacts
+        double wallDecay, floorDecay;  // e^(-c (contact - t0)) at those contacts
+        float left, right, floor;      // Contact limits for this ball's outline
+        float size;
+        float launchTime;
+        int8_t type;
+        int8_t wallKind;               // EV_LEFT, EV_RIGHT or EV_NONE
+        int8_t kind;                   // Of the pending event
+        bool resting;                  // Sliding along the floor with vy = 0
+    };
+
+    // Calendar entry; the time is kept here so a bucket is scanned without touching flights
+    struct Event {
+        double time;
+        uint32_t ball;
+    };
+
+    // Where a ball's event is filed
+    struct EventRef {
+        int32_t list;  // Bucket in the ring, OVERFLOW_LIST or NO_LIST
+        uint32_t pos;  // Index in that list
+    };
+
+    void addBall(const BallStore& balls, size_t i, double now);
+    void removeBall(BallStore& balls, size_t i);
+    void updateRates();
+    void setLimits(Flight& f) const;
+    void stateAt(const Flight& f, double t, double& x, double& y, double& vx, double& vy) const;
+    void stateAfter(const Flight& f, double dt, double decay, double& x, double& y, double& vx, double& vy) const;
+    void heightAt(const Flight& f, double dt, double decay, double& y, double& vy) const;
+    void rebase(Flight& f, double t) const;
+    void rebase(Flight& f, double t, double decay) const;
+    void handleDue(BallStore& balls, size_t i, double time, double now, const BounceFn& onBounce,
+                   BallisticResult& result);
+    bool handleEvent(BallStore& balls, size_t i, double time, const BounceFn& onBounce, BallisticResult& result);
+    double nextEvent(Flight& f) const;
+    void schedule(size_t i);
+    void rescheduleAll(double now);
+
+    std::vector<Event>& eventList(int32_t list) {
+        return list == OVERFLOW_LIST ? overflow : list == drainSlot ? draining : buckets[list];
+    }
+    int64_t bucketOf(double t) const;
+    void link(size_t i, double time);
+    void unlink(size_t i);
+    void refillRing();
+    void clearEvents(double now);
+
+    double wallTime(const Flight& f, int& kind, double& decay) const;
+    void planWall(Flight& f) const;
+    double floorTime(const Flight& f, double& decay) const;
+    bool returnTime(const Flight& f, double& t, double& decay) const;
+    void planFloor(Flight& f) const;
+    double restTime(const Flight& f) const;
+
+    std::vector<Flight> flights;
+    std::vector<EventRef> eventRefs;  // By flight index
+
+    static const int32_t RING_BUCKETS = 1024;  // Power of two
+    static const int32_t OVERFLOW_LIST = RING_BUCKETS;
+    static const int32_t NO_LIST = -1;         // Nothing will ever happen to the ball
+
+    std::vector<std::vector<Event> > buckets;  // Bucket k sits at k % RING_BUCKETS
+    std::vector<Event> overflow;               // Events past the ring
+    std::vector<Event> draining;               // A due bucket taken out while it is handled
+    int32_t drainSlot;                         // Ring slot of draining, or NO_LIST
+    double bucketRate;                         // Buckets per simulated second
+    int64_t cursor;    // First bucket not yet fully processed
+    int64_t ringBase;  // The ring holds buckets [cursor, ringBase + RING_BUCKETS)
+
+    uint64_t storeGeneration;  // BallStore::getGeneration at the last reset
+
+    SimSettings settings;
+    BallStepParams limits;
+    double posRate;       // Displacement per unit velocity per simulated second
+    double posInverse;    // 1 / posRate
+    double accel;         // Gravity per simulated second
+    double fallRate;      // 1 / accel, or 0 without gravity
+    double drag;          // Exponential velocity decay rate per simulated second
+    double timeConstant;  // 1 / drag, or 0 without drag
+    double terminal;      // Falling speed where drag cancels gravity
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "ballrenderer.h"
+#include "glstate.h"
+#include "objects.h"
+#include <algorithm>
+#include <cstddef>
+
+// Bind a per-vertex attribute of the interleaved mesh data, if the program has it
+static void meshAttribute(GLint location, GLint components, size_t offset) {
+    if (location < 0) return;
+    glEnableVertexAttribArray((GLuint)location);
+    glVertexAttribPointer((GLuint)location, components, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(offset));
+}
+
+void BallRenderer::init(const ShaderProgram& program, const GLuint vertexBuffers[3], const int vertexCounts[3]) {
+    for (int m = 0; m < 3; m++) {
+        Mesh& mesh = meshes[m];
+        if (vertexCounts[m] <= 0) continue;
+        mesh.vertices = vertexCounts[m];
+
+        glGenVertexArrays(1, &mesh.vao);
+        glState.bindVertexArray(mesh.vao);
+        glState.bindBuffer(GL_ARRAY_BUFFER, vertexBuffers[m]);
+        meshAttribute(program.attributeLocation(ATTRIBUTE_POSITION), 4, 0);
+        meshAttribute(program.attributeLocation(ATTRIBUTE_NORMAL), 3, sizeof(vec4));
+        meshAttribute(program.attributeLocation(ATTRIBUTE_TEX_COORD), 2, sizeof(vec4) + sizeof(vec3));
+
+        // Instance attributes advance once per ball instead of once per vertex
+        glGenBuffers(1, &mesh.instanceBuffer);
+        glState.bindBuffer(GL_ARRAY_BUFFER, mesh.instanceBuffer);
+        GLint placement = program.attributeLocation(ATTRIBUTE_INSTANCE_PLACEMENT);
+        GLint color = program.attributeLocation(ATTRIBUTE_INSTANCE_COLOR);
+        if (placement >= 0) {
+            glEnableVertexAttribArray((GLuint)placement);
+            glVertexAttribPointer((GLuint)placement, 3, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                                  BUFFER_OFFSET(offsetof(Instance, x)));
+            glVertexAttribDivisor((GLuint)placement, 1);
+        }
+        if (color >= 0) {
+            glEnableVertexAttribArray((GLuint)color);
+            glVertexAttribPointer((GLuint)color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance),
+                                  BUFFER_OFFSET(offsetof(Instance, color)));
+            glVertexAttribDivisor((GLuint)color, 1);
+        }
+    }
+    glState.bindVertexArray(0);
+}
+
+void BallRenderer::release() {
+    for (int m = 0; m < 3; m++) {
+        Mesh& mesh = meshes[m];
+        if (mesh.vao) glDeleteVertexArrays(1, &mesh.vao);
+        if (mesh.instanceBuffer) glDeleteBuffers(1, &mesh.instanceBuffer);
+        mesh = Mesh();
+    }
+}
+
+size_t BallRenderer::upload(const BallStore& balls, float alpha, const vec2& origin, const vec2& step,
+                            float sizeScale) {
+    // Palette as packed bytes, so the loop below only copies four of them per ball
+    uint8_t palette[8][4];
+    for (int c = 0; c < 8; c++) {
+        vec4 color = colors ? colors[c] : vec4(1.0f, 1.0f, 1.0f, 1.0f);
+        for (int k = 0; k < 4; k++)
+            palette[c][k] = (uint8_t)(std::min(std::max(color[k], 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    // Where each type goes: its own mesh, or the cube when it has none
+    std::vector<Instance>* target[3];
+    for (int m = 0; m < 3; m++) {
+        meshes[m].instances.clear();
+        target[m] = meshes[m].vertices > 0 ? &meshes[m].instances : &meshes[CUBE].instances;
+    }
+
+    size_t count = balls.getCount();
+    const float* x = balls.x.data();
+    const float* y = balls.y.data();
+    const float* prevX = balls.prevX.data();
+    const float* prevY = balls.prevY.data();
+    const float* size = balls.size.data();
+    const int32_t* type = balls.type.data();
+    const int32_t* colorIndex = balls.colorIndex.data();
+    for (size_t i = 0; i < count; i++) {
+        Instance inst;
+        inst.x = origin.x + (prevX[i] + (x[i] - prevX[i]) * alpha) * step.x;
+        inst.y = origin.y + (prevY[i] + (y[i] - prevY[i]) * alpha) * step.y;
+        inst.scale = size[i] * sizeScale;
+        const uint8_t* c = palette[colorIndex[i] & 7];
+        inst.color[0] = c[0];
+        inst.color[1] = c[1];
+        inst.color[2] = c[2];
+        inst.color[3] = c[3];
+        target[std::min(std::max(type[i], 0), 2)]->push_back(inst);
+    }
+
+    size_t uploaded = 0;
+    for (int m = 0; m < 3; m++) {
+        Mesh& mesh = meshes[m];
+        size_t n = mesh.instances.size();
+        if (mesh.vertices == 0 || n == 0) continue;
+
+        // Orphan last frame's storage; it grows in powers of two and never shrinks
+        glState.bindBuffer(GL_ARRAY_BUFFER, mesh.instanceBuffer);
+        while (mesh.capacity < n) mesh.capacity = std::max<size_t>(mesh.capacity * 2, 1024);
+        glBufferData(GL_ARRAY_BUFFER, mesh.capacity * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, n * sizeof(Instance), mesh.instances.data());
+        uploaded += n;
+    }
+    return uploaded;
+}
+
+void BallRenderer::draw(ObjectType type) const {
+    const Mesh& mesh = meshes[type];
+    if (mesh.vertices == 0 || mesh.instances.empty()) return;
+    glState.bindVertexArray(mesh.vao);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, mesh.vertices, (GLsizei)mesh.instances.size());
+}
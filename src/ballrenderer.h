@@ -0,0 +1,71 @@
+#ifndef BALLRENDERER_H
+#define BALLRENDERER_H
+
+#include "Angel.h"
+#include "ballstore.h"
+#include "shader.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Instanced drawing of the multi-object balls: one draw call per mesh
+ * type however many balls there are.
+ *
+ * Each frame upload() sorts the balls by type into one instance array
+ * per mesh (world position, scale and packed colour, 16 bytes a ball)
+ * and streams each array into its own buffer, orphaning the previous
+ * contents so the driver never waits for last frame's draws. draw() then
+ * issues a single glDrawArraysInstanced for a mesh. Everything the
+ * instances share, the mesh orientation and lighting, stays in uniforms.
+ */
+class BallRenderer {
+public:
+    BallRenderer() : colors(nullptr) {}
+
+    /**
+     * Build a vertex array per mesh over its vertex buffer (interleaved
+     * Vertex data, see objects.h) plus an instance buffer, with attribute
+     * locations from program. A mesh with no vertices is skipped.
+     */
+    void init(const ShaderProgram& program, const GLuint vertexBuffers[3], const int vertexCounts[3]);
+    void release();
+
+    // Palette of 8 colours indexed by BallStore::colorIndex
+    void setPalette(const vec4* palette) { colors = palette; }
+
+    /**
+     * Fill and upload the instance buffers. Positions are interpolated
+     * by alpha from prevX/prevY to x/y, then mapped to world space as
+     * origin + pixel * step; sizes are multiplied by sizeScale. Balls of
+     * a mesh type without vertices fall back to the cube.
+     *
+     * @return Number of instances uploaded
+     */
+    size_t upload(const BallStore& balls, float alpha, const vec2& origin, const vec2& step, float sizeScale);
+
+    // Draw the uploaded instances of one mesh with the program in use
+    void draw(ObjectType type) const;
+
+    size_t instanceCount(ObjectType type) const { return meshes[type].instances.size(); }
+
+private:
+    // Matches the iPlacement and iColor attributes of vshader_instanced.glsl
+    struct Instance {
+        float x, y, scale;
+        uint8_t color[4];
+    };
+
+    struct Mesh {
+        GLuint vao, instanceBuffer;
+        GLsizei vertices;
+        size_t capacity;  // Instances the buffer has room for
+        std::vector<Instance> instances;
+        Mesh() : vao(0), instanceBuffer(0), vertices(0), capacity(0) {}
+    };
+
+    Mesh meshes[3];
+    const vec4* colors;
+};
+
+#endif
@@ -0,0 +1,385 @@
+#include "ballstore.h"
+#include "checkpoint.h"
+#include "simdops.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Grow every field array so at least n balls fit.
+ * Capacity is rounded up to a whole number of SIMD lanes.
+ */
+void BallStore::reserve(size_t n) {
+    if (n <= cap) return;
+    size_t newCap = cap ? cap : LANES;
+    while (newCap < n) newCap *= 2;
+    newCap = (newCap + LANES - 1) / LANES * LANES;
+
+    x.reallocate(newCap, count);
+    y.reallocate(newCap, count);
+    prevX.reallocate(newCap, count);
+    prevY.reallocate(newCap, count);
+    vx.reallocate(newCap, count);
+    vy.reallocate(newCap, count);
+    size.reallocate(newCap, count);
+    colorIndex.reallocate(newCap, count);
+    type.reallocate(newCap, count);
+    launchTime.reallocate(newCap, count);
+    flags.reallocate(newCap, count);
+    restSteps.reallocate(newCap, count);
+    cap = newCap;
+}
+
+/**
+ * Add an awake ball and return its index
+ */
+size_t BallStore::push(const BallObject& ball) {
+    if (count == cap) reserve(count + 1);
+    size_t i = count++;
+    if (awake < i) {
+        // Make room at the end of the awake range
+        copyBall(i, awake);
+        i = awake;
+    }
+    awake++;
+    x[i] = ball.x;
+    y[i] = ball.y;
+    prevX[i] = ball.x;
+    prevY[i] = ball.y;
+    vx[i] = ball.vx;
+    vy[i] = ball.vy;
+    size[i] = ball.size;
+    colorIndex[i] = ball.colorIndex;
+    type[i] = ball.type;
+    launchTime[i] = ball.launchTime;
+    flags[i] = 0;
+    restSteps[i] = 0;
+    return i;
+}
+
+/**
+ * Gather ball i back into a single record
+ */
+BallObject BallStore::get(size_t i) const {
+    BallObject ball;
+    ball.x = x[i];
+    ball.y = y[i];
+    ball.vx = vx[i];
+    ball.vy = vy[i];
+    ball.colorIndex = colorIndex[i];
+    ball.type = static_cast<ObjectType>(type[i]);
+    ball.size = size[i];
+    ball.launchTime = launchTime[i];
+    return ball;
+}
+
+void BallStore::swapRemove(size_t i) {
+    if (i < awake) {
+        // Close the hole with the last awake ball, then the awake range's
+        // new hole with the last dormant ball
+        size_t lastAwake = --awake;
+        if (i != lastAwake) copyBall(i, lastAwake);
+        i = lastAwake;
+    }
+    size_t last = --count;
+    if (i != last) copyBall(i, last);
+}
+
+void BallStore::sleep(size_t i) {
+    size_t lastAwake = --awake;
+    swapBalls(i, lastAwake);
+    prevX[lastAwake] = x[lastAwake];
+    prevY[lastAwake] = y[lastAwake];
+    vx[lastAwake] = 0.0f;
+    vy[lastAwake] = 0.0f;
+}
+
+void BallStore::wake(size_t i) {
+    swapBalls(i, awake);
+    restSteps[awake] = 0;
+    awake++;
+}
+
+void BallStore::wakeAll() {
+    for (size_t i = awake; i < count; i++) restSteps[i] = 0;
+    awake = count;
+}
+
+void BallStore::save(SnapshotWriter& out) const {
+    out.value((uint64_t)count);
+    out.value((uint64_t)awake);
+    out.array(x.data(), count);
+    out.array(y.data(), count);
+    out.array(prevX.data(), count);
+    out.array(prevY.data(), count);
+    out.array(vx.data(), count);
+    out.array(vy.data(), count);
+    out.array(size.data(), count);
+    out.array(colorIndex.data(), count);
+    out.array(type.data(), count);
+    out.array(launchTime.data(), count);
+    out.array(flags.data(), count);
+    out.array(restSteps.data(), count);
+}
+
+bool BallStore::load(SnapshotReader& in) {
+    uint64_t n = 0, awakeN = 0;
+    in.value(n);
+    in.value(awakeN);
+    clear();
+    // The positions alone take 8 bytes per ball, which bounds n before allocating
+    if (!in.good() || awakeN > n || n > in.remaining() / 8) {
+        in.fail();
+        return false;
+    }
+    reserve((size_t)n);
+    in.array(x.data(), (size_t)n);
+    in.array(y.data(), (size_t)n);
+    in.array(prevX.data(), (size_t)n);
+    in.array(prevY.data(), (size_t)n);
+    in.array(vx.data(), (size_t)n);
+    in.array(vy.data(), (size_t)n);
+    in.array(size.data(), (size_t)n);
+    in.array(colorIndex.data(), (size_t)n);
+    in.array(type.data(), (size_t)n);
+    in.array(launchTime.data(), (size_t)n);
+    in.array(flags.data(), (size_t)n);
+    in.array(restSteps.data(), (size_t)n);
+    if (!in.good()) return false;
+    count = (size_t)n;
+    awake = (size_t)awakeN;
+    return true;
+}
+
+void BallStore::copyBall(size_t dst, size_t src) {
+    x[dst] = x[src];
+    y[dst] = y[src];
+    prevX[dst] = prevX[src];
+    prevY[dst] = prevY[src];
+    vx[dst] = vx[src];
+    vy[dst] = vy[src];
+    size[dst] = size[src];
+    colorIndex[dst] = colorIndex[src];
+    type[dst] = type[src];
+    launchTime[dst] = launchTime[src];
+    flags[dst] = flags[src];
+    restSteps[dst] = restSteps[src];
+}
+
+void BallStore::swapBalls(size_t i, size_t j) {
+    if (i == j) return;
+    std::swap(x[i], x[j]);
+    std::swap(y[i], y[j]);
+    std::swap(prevX[i], prevX[j]);
+    std::swap(prevY[i], prevY[j]);
+    std::swap(vx[i], vx[j]);
+    std::swap(vy[i], vy[j]);
+    std::swap(size[i], size[j]);
+    std::swap(colorIndex[i], colorIndex[j]);
+    std::swap(type[i], type[j]);
+    std::swap(launchTime[i], launchTime[j]);
+    std::swap(flags[i], flags[j]);
+    std::swap(restSteps[i], restSteps[j]);
+}
+
+#ifdef HAVE_SIMD_OPS
+
+// Lane numbers, for masking the partial vector at the end of a range
+alignas(32) static const float LANE_INDEX[8] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+
+size_t integrateBallRange(BallStore& balls, const BallStepParams& p, size_t begin, size_t end) {
+    typedef SimdOps::V V;
+    const int W = SimdOps::WIDTH;
+
+    const V gravity = SimdOps::set1(p.gravity);
+    const V air = SimdOps::set1(p.airResistance);
+    const V restitution = SimdOps::set1(p.restitution);
+    const V speed = SimdOps::set1(p.speed);
+    const V leftWall = SimdOps::set1(p.left);
+    const V rightWall = SimdOps::set1(p.right);
+    const V bottom = SimdOps::set1(p.bottom);
+    const V zero = SimdOps::set1(0.0f);
+    const V one = SimdOps::set1(1.0f);
+    const V cubeType = SimdOps::set1((float)CUBE);
+    const V bunnyType = SimdOps::set1((float)BUNNY);
+    const V sphereExtentX = SimdOps::set1(p.extentX[SPHERE]);
+    const V sphereExtentY = SimdOps::set1(p.extentY[SPHERE]);
+    const V cubeExtentX = SimdOps::set1(p.extentX[CUBE]);
+    const V cubeExtentY = SimdOps::set1(p.extentY[CUBE]);
+    const V bunnyExtentX = SimdOps::set1(p.extentX[BUNNY]);
+    const V bunnyExtentY = SimdOps::set1(p.extentY[BUNNY]);
+    const V now = SimdOps::set1(p.now);
+    const V maxLifetime = SimdOps::set1(p.maxLifetime);
+    const V minBounce = SimdOps::set1(0.5f);
+    const V minEnergy = SimdOps::set1(p.restEnergy);
+    const V signBit = SimdOps::set1(-0.0f);
+    const V laneIndex = SimdOps::load(LANE_INDEX);
+
+    float* px = balls.x.data();
+    float* py = balls.y.data();
+    float* ppx = balls.prevX.data();
+    float* ppy = balls.prevY.data();
+    float* pvx = balls.vx.data();
+    float* pvy = balls.vy.data();
+    const float* plaunch = balls.launchTime.data();
+    const float* psize = balls.size.data();
+    const int32_t* ptype = balls.type.data();
+    uint8_t* flags = balls.flags.data();
+
+    size_t bounces = 0;
+    for (size_t i = begin; i < end; i += W) {
+        V x0 = SimdOps::load(px + i);
+        V y0 = SimdOps::load(py + i);
+        V vx = SimdOps::load(pvx + i);
+        V vy = SimdOps::load(pvy + i);
+        SimdOps::store(ppx + i, x0);
+        SimdOps::store(ppy + i, y0);
+
+        // Gravity and air resistance
+        vy = SimdOps::add(vy, gravity);
+        vx = SimdOps::mul(vx, air);
+        vy = SimdOps::mul(vy, air);
+
+        V x = SimdOps::add(x0, SimdOps::mul(vx, speed));
+        V y = SimdOps::add(y0, SimdOps::mul(vy, speed));
+
+        // Shape-dependent half extents move the walls in by the ball's outline
+        V size = SimdOps::load(psize + i);
+        V type = SimdOps::loadInt(ptype + i);
+        V isCube = SimdOps::eq(type, cubeType);
+        V isBunny = SimdOps::eq(type, bunnyType);
+        V extentX = SimdOps::mul(size, SimdOps::select(isCube, cubeExtentX,
+                                       SimdOps::select(isBunny, bunnyExtentX, sphereExtentX)));
+        V extentY = SimdOps::mul(size, SimdOps::select(isCube, cubeExtentY,
+                                       SimdOps::select(isBunny, bunnyExtentY, sphereExtentY)));
+        V left = SimdOps::add(leftWall, extentX);
+        V right = SimdOps::sub(rightWall, extentX);
+        V floor = SimdOps::sub(bottom, extentY);
+
+        // Swept floor contact (see sweepWall): the part of the step past the
+        // floor is spent on the rebound; slow bounces settle on the floor
+        V floorHit = SimdOps::gt(y, floor);
+        V below = SimdOps::min(SimdOps::sub(y, floor), SimdOps::max(SimdOps::sub(y, y0), zero));
+        V bouncedVy = SimdOps::mul(SimdOps::bitXor(vy, signBit), restitution);
+        V settled = SimdOps::lt(SimdOps::bitAndNot(signBit, bouncedVy), minBounce);
+        bouncedVy = SimdOps::bitAndNot(settled, bouncedVy);
+        V reboundY = SimdOps::select(settled, floor, SimdOps::sub(floor, SimdOps::mul(below, restitution)));
+        vy = SimdOps::select(floorHit, bouncedVy, vy);
+        y = SimdOps::select(floorHit, reboundY, y);
+
+        // Swept side walls, clamped in case a rebound is longer than the arena is wide
+        V leftHit = SimdOps::lt(x, left);
+        V rightHit = SimdOps::bitAndNot(leftHit, SimdOps::gt(x, right));
+        V pastLeft = SimdOps::min(SimdOps::sub(left, x), SimdOps::max(SimdOps::sub(x0, x), zero));
+        V pastRight = SimdOps::min(SimdOps::sub(x, right), SimdOps::max(SimdOps::sub(x, x0), zero));
+        x = SimdOps::select(leftHit, SimdOps::add(left, SimdOps::mul(pastLeft, restitution)), x);
+        x = SimdOps::select(rightHit, SimdOps::sub(right, SimdOps::mul(pastRight, restitution)), x);
+        x = SimdOps::max(x, left);
+        x = SimdOps::min(x, right);
+        V wallHit = SimdOps::bitOr(leftHit, rightHit);
+        vx = SimdOps::select(wallHit, SimdOps::mul(SimdOps::bitXor(vx, signBit), restitution), vx);
+
+        // Expire old balls and balls resting on the floor
+        V lifetime = SimdOps::sub(now, SimdOps::load(plaunch + i));
+        V energy = SimdOps::add(SimdOps::bitAndNot(signBit, vx), SimdOps::bitAndNot(signBit, vy));
+        V expired = SimdOps::bitOr(SimdOps::gt(lifetime, maxLifetime),
+                                   SimdOps::bitAnd(SimdOps::ge(y, SimdOps::sub(floor, one)),
+                                                   SimdOps::lt(energy, minEnergy)));
+
+        // Lanes past end hold dormant balls (or padding) that must not move
+        int lanes = (end - i < (size_t)W) ? (int)(end - i) : W;
+        if (lanes < W) {
+            V outside = SimdOps::ge(laneIndex, SimdOps::set1((float)lanes));
+            x = SimdOps::select(outside, x0, x);
+            y = SimdOps::select(outside, y0, y);
+            vx = SimdOps::select(outside, SimdOps::load(pvx + i), vx);
+            vy = SimdOps::select(outside, SimdOps::load(pvy + i), vy);
+        }
+
+        SimdOps::store(px + i, x);
+        SimdOps::store(py + i, y);
+        SimdOps::store(pvx + i, vx);
+        SimdOps::store(pvy + i, vy);
+
+        int bounceBits = SimdOps::mask(floorHit);
+        int expireBits = SimdOps::mask(expired);
+        for (int k = 0; k < lanes; k++) {
+            uint8_t f = 0;
+            if (bounceBits & (1 << k)) { f |= BALL_BOUNCED; bounces++; }
+            if (expireBits & (1 << k)) f |= BALL_EXPIRED;
+            flags[i + k] = f;
+        }
+    }
+    return bounces;
+}
+
+#else
+
+size_t integrateBallRange(BallStore& balls, const BallStepParams& p, size_t begin, size_t end) {
+    size_t bounces = 0;
+    for (size_t i = begin; i < end; i++) {
+        balls.prevX[i] = balls.x[i];
+        balls.prevY[i] = balls.y[i];
+        float vx = balls.vx[i] * p.airResistance;
+        float vy = (balls.vy[i] + p.gravity) * p.airResistance;
+        float x = balls.x[i] + vx * p.speed;
+        float y = balls.y[i] + vy * p.speed;
+        uint8_t f = 0;
+
+        // Shape-dependent half extents move the walls in by the ball's outline
+        int type = balls.type[i];
+        float left = p.left + balls.size[i] * p.extentX[type];
+        float right = p.right - balls.size[i] * p.extentX[type];
+        float floor = p.bottom - balls.size[i] * p.extentY[type];
+
+        // Swept contacts: a ball crossing a wall mid-step rebounds for the rest of it
+        if (sweepWall(balls.y[i], y, floor, 1.0f, p.restitution)) {
+            vy = -vy * p.restitution;
+            if (std::fabs(vy) < 0.5f) {
+                vy = 0.0f;
+                y = floor;
+            }
+            f |= BALL_BOUNCED;
+            bounces++;
+        }
+        if (sweepWall(balls.x[i], x, left, -1.0f, p.restitution) ||
+            sweepWall(balls.x[i], x, right, 1.0f, p.restitution))
+            vx = -vx * p.restitution;
+
+        // A rebound longer than the arena is wide ends at the far wall
+        if (x < left) x = left;
+        if (x > right) x = right;
+
+        float lifetime = p.now - balls.launchTime[i];
+        float energy = std::fabs(vx) + std::fabs(vy);
+        if (lifetime > p.maxLifetime || (y >= floor - 1.0f && energy < p.restEnergy))
+            f |= BALL_EXPIRED;
+
+        balls.x[i] = x;
+        balls.y[i] = y;
+        balls.vx[i] = vx;
+        balls.vy[i] = vy;
+        balls.flags[i] = f;
+    }
+    return bounces;
+}
+
+#endif
+
+size_t integrateBalls(BallStore& balls, const BallStepParams& params) {
+    return integrateBallRange(balls, params, 0, balls.getAwakeCount());
+}
+
+size_t removeExpiredBalls(BallStore& balls) {
+    size_t removed = 0;
+    size_t i = 0;
+    while (i < balls.getCount()) {
+        if (balls.flags[i] & BALL_EXPIRED) {
+            // The moved-in ball brings its own flags, so re-check slot i
+            balls.swapRemove(i);
+            removed++;
+        } else {
+            ++i;
+        }
+    }
+    return removed;
+}
@@ -0,0 +1,222 @@
+#ifndef BALLSTORE_H
+#define BALLSTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Object types that can be simulated and drawn
+enum ObjectType { CUBE, SPHERE, BUNNY };
+
+// Description of a single ball in multi-object mode
+struct BallObject {
+    float x, y;
+    float vx, vy;
+    int colorIndex;
+    ObjectType type;
+    float size;
+    float launchTime;
+};
+
+/**
+ * Heap array whose storage is aligned for SIMD loads and stores.
+ * Only trivially copyable element types are supported.
+ */
+template <typename T>
+class AlignedArray {
+public:
+    static const size_t ALIGNMENT = 64;
+
+    AlignedArray() : raw(nullptr), ptr(nullptr) {}
+    ~AlignedArray() { std::free(raw); }
+
+    // Grow to hold newCapacity elements, keeping the first count elements
+    void reallocate(size_t newCapacity, size_t count) {
+        void* newRaw = std::malloc(newCapacity * sizeof(T) + ALIGNMENT);
+        if (!newRaw) throw std::bad_alloc();
+        uintptr_t addr = reinterpret_cast<uintptr_t>(newRaw);
+        T* newPtr = reinterpret_cast<T*>((addr + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1));
+        std::memset(newPtr, 0, newCapacity * sizeof(T));
+        if (ptr && count) std::memcpy(newPtr, ptr, count * sizeof(T));
+        std::free(raw);
+        raw = newRaw;
+        ptr = newPtr;
+    }
+
+    T* data() { return ptr; }
+    const T* data() const { return ptr; }
+    T& operator[](size_t i) { return ptr[i]; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+
+private:
+    AlignedArray(const AlignedArray&);
+    AlignedArray& operator=(const AlignedArray&);
+
+    void* raw;
+    T* ptr;
+};
+
+/**
+ * Structure-of-arrays container for multi-object mode balls.
+ * Every field lives in its own aligned array so the integrator can
+ * process several balls per instruction. Capacity is always padded to
+ * a whole number of SIMD lanes, so kernels may read past count.
+ *
+ * Balls are partitioned into awake balls [0, awakeCount) followed by
+ * dormant ones [awakeCount, count). Only awake balls are integrated;
+ * new balls always join the awake range.
+ */
+class BallStore {
+public:
+    static const size_t LANES = 8;
+
+    AlignedArray<float> x, y;
+    AlignedArray<float> prevX, prevY;  // Positions before the last step
+    AlignedArray<float> vx, vy;
+    AlignedArray<float> size;
+    AlignedArray<int32_t> colorIndex;
+    AlignedArray<int32_t> type;
+    AlignedArray<float> launchTime;
+
+    // Per-ball scratch flags written by the integrator
+    AlignedArray<uint8_t> flags;
+
+    // Consecutive steps each awake ball has spent nearly still (see updateSleep)
+    AlignedArray<uint8_t> restSteps;
+
+    BallStore() : count(0), awake(0), cap(0), generation(0) {}
+
+    size_t getCount() const { return count; }
+    size_t getAwakeCount() const { return awake; }
+    size_t capacity() const { return cap; }
+    bool empty() const { return count == 0; }
+    bool isDormant(size_t i) const { return i >= awake; }
+
+    // Changes whenever the contents are replaced as a whole (clear, load)
+    uint64_t getGeneration() const { return generation; }
+    void clear() { count = 0; awake = 0; generation++; }
+
+    void reserve(size_t n);
+    size_t push(const BallObject& ball);
+    BallObject get(size_t i) const;
+
+    /**
+     * Remove ball i, keeping the awake/dormant partition: the last ball
+     * of i's range fills the hole. With no dormant balls this is a plain
+     * swap-and-pop with the last ball.
+     */
+    void swapRemove(size_t i);
+
+    // Move awake ball i to the dormant range, leaving it motionless
+    void sleep(size_t i);
+
+    // Move dormant ball i back to the awake range
+    void wake(size_t i);
+
+    // Make every ball awake, e.g. after the physics parameters changed
+    void wakeAll();
+
+    // Append every ball and the awake/dormant split to a checkpoint (see checkpoint.h)
+    void save(SnapshotWriter& out) const;
+
+    /**
+     * Replace the contents with balls saved by save. Storage only grows
+     * when the saved balls do not fit.
+     *
+     * @return false if the section is malformed; the store is then empty
+     */
+    bool load(SnapshotReader& in);
+
+private:
+    BallStore(const BallStore&);
+    BallStore& operator=(const BallStore&);
+
+    void copyBall(size_t dst, size_t src);
+    void swapBalls(size_t i, size_t j);
+
+    size_t count;
+    size_t awake;
+    size_t cap;
+    uint64_t generation;
+};
+
+// Flags written per ball by integrateBalls, collideBalls and updateSleep
+enum BallFlags { BALL_BOUNCED = 1, BALL_EXPIRED = 2, BALL_CONTACT = 4, BALL_SLEEP = 8, BALL_WAKE = 16 };
+
+// Parameters for one integration step of the ball store
+struct BallStepParams {
+    float gravity;
+    float airResistance;
+    float restitution;
+    float speed;          // Velocity-to-displacement scale per step
+    float left, right;    // Side walls
+    float bottom;         // Floor
+    float now;            // Current simulation time
+    float maxLifetime;    // Balls older than this expire
+    float restEnergy;     // Balls on the floor with |vx| + |vy| below this expire; 0 keeps them
+    bool allowSleep;      // Let settled balls go dormant
+    int contactIterations;  // PbdSolver iterations for ball-ball contacts; 0 = collideBalls
+    float attraction;     // Mutual attraction per step (see BarnesHutTree::attract); 0 = off
+    float openingAngle;   // Barnes-Hut opening angle
+
+    // Half extent of each ObjectType along x and y, per unit of ball size.
+    // Walls stop a ball when its outline, not its centre, reaches them.
+    float extentX[3];
+    float extentY[3];
+
+    BallStepParams()
+        : gravity(0.0f), airResistance(1.0f), restitution(1.0f), speed(1.0f),
+          left(0.0f), right(0.0f), bottom(0.0f), now(0.0f), maxLifetime(1e30f), restEnergy(0.1f),
+          allowSleep(false), contactIterations(0), attraction(0.0f), openingAngle(0.5f) {
+        for (int i = 0; i < 3; i++) extentX[i] = extentY[i] = 0.0f;
+    }
+};
+
+/**
+ * Swept contact with a wall at limit along one axis, for motion that is
+ * linear within the step from start to pos. side is +1 for a wall at the
+ * high end (right wall, floor) and -1 for one at the low end. A ball that
+ * ended the step past the wall reached it part-way through and spends the
+ * rest of the step on the rebound, so pos becomes where the rebound ends
+ * instead of the wall itself. Only distance travelled this step is
+ * reflected, so a ball that started past the wall is just pushed back.
+ *
+ * @return true if the ball hit the wall; the caller reflects its velocity
+ */
+inline bool sweepWall(float start, float& pos, float limit, float side, float restitution) {
+    float over = (pos - limit) * side;
+    if (!(over > 0.0f)) return false;
+    float travelled = (pos - start) * side;
+    if (travelled < 0.0f) travelled = 0.0f;
+    float beyond = over < travelled ? over : travelled;
+    pos = limit - side * beyond * restitution;
+    return true;
+}
+
+/**
+ * Apply gravity, air resistance and wall bounces to every awake ball, saving
+ * the old positions in prevX/prevY for render interpolation, and record
+ * bounce/expiry results in balls.flags. Expired balls stay in the store
+ * until removeExpiredBalls is called, so the caller can still read them
+ * (e.g. to emit bounce particles).
+ *
+ * @return Number of balls that bounced on the floor this step
+ */
+size_t integrateBalls(BallStore& balls, const BallStepParams& params);
+
+/**
+ * Same as integrateBalls for balls [begin, end) only. begin must be a
+ * multiple of BallStore::LANES so ranges can run on separate threads.
+ */
+size_t integrateBallRange(BallStore& balls, const BallStepParams& params,
+                          size_t begin, size_t end);
+
+// Remove every ball flagged BALL_EXPIRED, returning the number removed
+size_t removeExpiredBalls(BallStore& balls);
+
+#endif
@@ -0,0 +1,389 @@
+#include "barneshut.h"
+#include "simdops.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+// Quadtree levels; each level takes two bits of the Morton code
+static const int MORTON_BITS = 16;
+
+// Cells with at most this many points are leaves
+static const uint32_t LEAF_SIZE = 16;
+
+// Levels built serially; the subtrees below them go to the workers
+static const int SUBTREE_LEVEL = 3;
+
+// Points handed to a worker at a time
+static const size_t BH_CHUNK = 1024;
+
+// Leaves handed to a worker at a time in a force pass
+static const size_t LEAF_CHUNK = 128;
+
+// A depth-first walk holds at most three unvisited siblings per level
+static const int STACK_SIZE = 4 * (MORTON_BITS + 1);
+
+static void runRanges(ThreadPool* pool, size_t count, size_t grain, const ThreadPool::RangeFn& fn) {
+    if (pool && count > grain)
+        pool->parallelFor(count, grain, fn);
+    else
+        fn(0, count, 0);
+}
+
+// Spread the low 16 bits of v to the even bit positions
+static inline uint32_t spreadBits(uint32_t v) {
+    v &= 0xffff;
+    v = (v | (v << 8)) & 0x00ff00ffu;
+    v = (v | (v << 4)) & 0x0f0f0f0fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+void BarnesHutTree::build(const float* x, const float* y, const float* pointMass, size_t count, float softening,
+                          ThreadPool* pool) {
+    nodes.clear();
+    subtrees.clear();
+    leaves.clear();
+    softeningSq = softening * softening;
+    if (count == 0) return;
+
+    float minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+    for (size_t i = 1; i < count; i++) {
+        minX = std::min(minX, x[i]);
+        maxX = std::max(maxX, x[i]);
+        minY = std::min(minY, y[i]);
+        maxY = std::max(maxY, y[i]);
+    }
+    rootSize = std::max(maxX - minX, maxY - minY);
+    if (!(rootSize > 0.0f)) rootSize = 1.0f;
+    float scale = 65535.0f / rootSize;
+
+    code.resize(count);
+    order.resize(count);
+    codeScratch.resize(count);
+    orderScratch.resize(count);
+    runRanges(pool, count, BH_CHUNK, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            uint32_t qx = (uint32_t)std::min((x[i] - minX) * scale, 65535.0f);
+            uint32_t qy = (uint32_t)std::min((y[i] - minY) * scale, 65535.0f);
+            codeScratch[i] = spreadBits(qx) | (spreadBits(qy) << 1);
+            orderScratch[i] = (uint32_t)i;
+        }
+    });
+
+    // LSD radix sort on bytes; four passes leave the result in the scratch arrays
+    uint32_t* srcCode = codeScratch.data();
+    uint32_t* srcOrder = orderScratch.data();
+    uint32_t* dstCode = code.data();
+    uint32_t* dstOrder = order.data();
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t bucketStart[257] = { 0 };
+        for (size_t i = 0; i < count; i++)
+            bucketStart[((srcCode[i] >> shift) & 0xff) + 1]++;
+        for (int b = 0; b < 256; b++)
+            bucketStart[b + 1] += bucketStart[b];
+        for (size_t i = 0; i < count; i++) {
+            uint32_t slot = bucketStart[(srcCode[i] >> shift) & 0xff]++;
+            dstCode[slot] = srcCode[i];
+            dstOrder[slot] = srcOrder[i];
+        }
+        std::swap(srcCode, dstCode);
+        std::swap(srcOrder, dstOrder);
+    }
+    code.swap(codeScratch);
+    order.swap(orderScratch);
+
+    sortedX.resize(count);
+    sortedY.resize(count);
+    sortedMass.resize(count);
+    runRanges(pool, count, BH_CHUNK, [&](size_t begin, size_t end, unsigned) {
+        for (size_t k = begin; k < end; k++) {
+            sortedX[k] = x[order[k]];
+            sortedY[k] = y[order[k]];
+            sortedMass[k] = pointMass[order[k]];
+        }
+    });
+
+    // Top levels, then the deferred subtrees side by side
+    nodes.resize(1);
+    buildNode(nodes, 0, 0, (uint32_t)count, 0, SUBTREE_LEVEL);
+    size_t topCount = nodes.size();
+    if (pool && subtrees.size() > 1) {
+        pool->parallelFor(subtrees.size(), 1, [&](size_t begin, size_t end, unsigned) {
+            for (size_t s = begin; s < end; s++) {
+                Subtree& t = subtrees[s];
+                t.nodes.resize(1);
+                buildNode(t.nodes, 0, t.begin, t.end, t.level, -1);
+            }
+        });
+    } else {
+        for (size_t s = 0; s < subtrees.size(); s++) {
+            Subtree& t = subtrees[s];
+            t.nodes.resize(1);
+            buildNode(t.nodes, 0, t.begin, t.end, t.level, -1);
+        }
+    }
+
+    // Subtree node k > 0 lands at offset + k; its root replaces the placeholder
+    for (size_t s = 0; s < subtrees.size(); s++) {
+        const std::vector<Node>& local = subtrees[s].nodes;
+        uint32_t offset = (uint32_t)nodes.size() - 1;
+        for (size_t k = 0; k < local.size(); k++) {
+            Node node = local[k];
+            if (node.childCount) node.child += offset;
+            if (k == 0) nodes[subtrees[s].node] = node;
+            else nodes.push_back(node);
+        }
+    }
+
+    // Children come after their parent, so a backwards pass sees them first
+    for (size_t i = topCount; i-- > 0;) {
+        if (nodes[i].childCount) summarize(nodes, (uint32_t)i);
+    }
+
+    // Leaves in point order, so neighbouring workers' leaves walk the same cells
+    leaves.clear();
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i].childCount == 0) leaves.push_back((uint32_t)i);
+    }
+    std::sort(leaves.begin(), leaves.end(),
+              [this](uint32_t a, uint32_t b) { return nodes[a].begin < nodes[b].begin; });
+}
+
+void BarnesHutTree::buildNode(std::vector<Node>& out, uint32_t index, uint32_t begin, uint32_t end, int level,
+                              int deferLevel) {
+    Node node;
+    node.comX = node.comY = node.mass = 0.0f;
+    node.size = std::ldexp(rootSize, -level);
+    node.begin = begin;
+    node.end = end;
+    node.child = 0;
+    node.childCount = 0;
+    out[index] = node;
+    if (end - begin <= LEAF_SIZE || level >= MORTON_BITS) {
+        summarize(out, index);
+        return;
+    }
+    if (level == deferLevel) {
+        Subtree t;
+        t.node = index;
+        t.begin = begin;
+        t.end = end;
+        t.level = level;
+        subtrees.push_back(t);
+        return;
+    }
+
+    // The cell's points share the code bits above shift; the next two pick the child
+    int shift = 2 * (MORTON_BITS - 1 - level);
+    uint32_t prefix = code[begin] & ~(uint32_t)((4ull << shift) - 1);
+    uint32_t cut[5];
+    cut[0] = begin;
+    cut[4] = end;
+    for (uint32_t d = 1; d < 4; d++)
+        cut[d] = (uint32_t)(std::lower_bound(code.begin() + cut[d - 1], code.begin() + end, prefix | (d << shift)) -
+                            code.begin());
+
+    uint32_t first = (uint32_t)out.size();
+    uint32_t children = 0;
+    for (int d = 0; d < 4; d++)
+        if (cut[d + 1] > cut[d]) children++;
+    out[index].child = first;
+    out[index].childCount = children;
+    out.resize(first + children);
+
+    uint32_t slot = first;
+    for (int d = 0; d < 4; d++) {
+        if (cut[d + 1] > cut[d]) buildNode(out, slot++, cut[d], cut[d + 1], level + 1, deferLevel);
+    }
+    summarize(out, index);
+}
+
+void BarnesHutTree::summarize(std::vector<Node>& out, uint32_t index) const {
+    Node& node = out[index];
+    double m = 0.0, mx = 0.0, my = 0.0;
+    if (node.childCount == 0) {
+        for (uint32_t k = node.begin; k < node.end; k++) {
+            m += sortedMass[k];
+            mx += (double)sortedMass[k] * sortedX[k];
+            my += (double)sortedMass[k] * sortedY[k];
+        }
+    } else {
+        for (uint32_t c = node.child; c < node.child + node.childCount; c++) {
+            m += out[c].mass;
+            mx += (double)out[c].mass * out[c].comX;
+            my += (double)out[c].mass * out[c].comY;
+        }
+    }
+    node.mass = (float)m;
+    if (m > 0.0) {
+        node.comX = (float)(mx / m);
+        node.comY = (float)(my / m);
+    } else {
+        node.comX = sortedX[node.begin];
+        node.comY = sortedY[node.begin];
+    }
+}
+
+#ifdef HAVE_SIMD_OPS
+
+/**
+ * Softened pull of count bodies on the point (x, y), summed in vector
+ * lanes. The lists are padded with massless bodies to a multiple of
+ * SimdOps::WIDTH.
+ */
+static void sumBodies(const float* bx, const float* by, const float* bm, size_t count, float x, float y, float epsSq,
+                      float& sumX, float& sumY) {
+    typedef SimdOps::V V;
+    const V px = SimdOps::set1(x);
+    const V py = SimdOps::set1(y);
+    const V eps = SimdOps::set1(epsSq);
+    const V zero = SimdOps::set1(0.0f);
+    const V half = SimdOps::set1(0.5f);
+    const V threeHalves = SimdOps::set1(1.5f);
+    V accX = zero, accY = zero;
+    for (size_t b = 0; b < count; b += SimdOps::WIDTH) {
+        V dx = SimdOps::sub(SimdOps::loadUnaligned(bx + b), px);
+        V dy = SimdOps::sub(SimdOps::loadUnaligned(by + b), py);
+        V rawSq = SimdOps::add(SimdOps::mul(dx, dx), SimdOps::mul(dy, dy));
+        V distSq = SimdOps::add(rawSq, eps);
+        // Estimated 1 / sqrt refined by one Newton step, instead of a divide and a square root
+        V r = SimdOps::rsqrt(distSq);
+        r = SimdOps::mul(r, SimdOps::sub(threeHalves, SimdOps::mul(SimdOps::mul(half, distSq), SimdOps::mul(r, r))));
+        V inv = SimdOps::mul(SimdOps::loadUnaligned(bm + b), SimdOps::mul(r, SimdOps::mul(r, r)));
+        inv = SimdOps::bitAnd(SimdOps::gt(rawSq, zero), inv);
+        accX = SimdOps::add(accX, SimdOps::mul(dx, inv));
+        accY = SimdOps::add(accY, SimdOps::mul(dy, inv));
+    }
+    alignas(32) float laneX[8], laneY[8];
+    SimdOps::store(laneX, accX);
+    SimdOps::store(laneY, accY);
+    sumX = sumY = 0.0f;
+    for (int l = 0; l < SimdOps::WIDTH; l++) {
+        sumX += laneX[l];
+        sumY += laneY[l];
+    }
+}
+
+static const size_t BODY_PADDING = SimdOps::WIDTH;
+
+#else
+
+static void sumBodies(const float* bx, const float* by, const float* bm, size_t count, float x, float y, float epsSq,
+                      float& sumX, float& sumY) {
+    sumX = sumY = 0.0f;
+    for (size_t b = 0; b < count; b++) {
+        float dx = bx[b] - x, dy = by[b] - y;
+        float rawSq = dx * dx + dy * dy;
+        float distSq = rawSq + epsSq;
+        float inv = rawSq > 0.0f ? bm[b] / (distSq * std::sqrt(distSq)) : 0.0f;
+        sumX += dx * inv;
+        sumY += dy * inv;
+    }
+}
+
+static const size_t BODY_PADDING = 1;
+
+#endif
+
+size_t BarnesHutTree::accelerations(size_t count, float openingAngle, float* ax, float* ay, ThreadPool* pool) const {
+    if (nodes.empty()) return 0;
+    float thetaSq = openingAngle * openingAngle;
+    float epsSq = softeningSq;
+
+    std::atomic<size_t> interactions(0);
+    runRanges(pool, leaves.size(), LEAF_CHUNK, [&](size_t begin, size_t end, unsigned) {
+        size_t found = 0;
+        uint32_t stack[STACK_SIZE];
+        std::vector<float> bodyX, bodyY, bodyMass;
+        for (size_t l = begin; l < end; l++) {
+            const Node& leaf = nodes[leaves[l]];
+            bool wanted = false;
+            float minX = sortedX[leaf.begin], maxX = minX, minY = sortedY[leaf.begin], maxY = minY;
+            for (uint32_t k = leaf.begin; k < leaf.end; k++) {
+                wanted = wanted || order[k] < count;
+                minX = std::min(minX, sortedX[k]);
+                maxX = std::max(maxX, sortedX[k]);
+                minY = std::min(minY, sortedY[k]);
+                maxY = std::max(maxY, sortedY[k]);
+            }
+            if (!wanted) continue;
+
+            // One walk for the whole leaf: a cell is used as one body only if
+            // it passes the opening test from the nearest point of the leaf's
+            // bounding box, which is at least as strict as for any one point
+            bodyX.clear();
+            bodyY.clear();
+            bodyMass.clear();
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const Node& cell = nodes[stack[--top]];
+                if (cell.childCount == 0) {
+                    bodyX.insert(bodyX.end(), sortedX.begin() + cell.begin, sortedX.begin() + cell.end);
+                    bodyY.insert(bodyY.end(), sortedY.begin() + cell.begin, sortedY.begin() + cell.end);
+                    bodyMass.insert(bodyMass.end(), sortedMass.begin() + cell.begin, sortedMass.begin() + cell.end);
+                    continue;
+                }
+                float dx = std::max(std::max(minX - cell.comX, cell.comX - maxX), 0.0f);
+                float dy = std::max(std::max(minY - cell.comY, cell.comY - maxY), 0.0f);
+                if (cell.size * cell.size < thetaSq * (dx * dx + dy * dy)) {
+                    bodyX.push_back(cell.comX);
+                    bodyY.push_back(cell.comY);
+                    bodyMass.push_back(cell.mass);
+                    continue;
+                }
+                for (uint32_t c = cell.child + cell.childCount; c-- > cell.child;)
+                    stack[top++] = c;
+            }
+
+            // Massless padding at the origin adds nothing
+            size_t listed = bodyX.size();
+            size_t padded = (listed + BODY_PADDING - 1) / BODY_PADDING * BODY_PADDING;
+            bodyX.resize(padded, 0.0f);
+            bodyY.resize(padded, 0.0f);
+            bodyMass.resize(padded, 0.0f);
+
+            // A body at the point itself (the point, or one on top of it) pulls nowhere
+            for (uint32_t k = leaf.begin; k < leaf.end; k++) {
+                uint32_t i = order[k];
+                if (i >= count) continue;
+                float sumX, sumY;
+                sumBodies(bodyX.data(), bodyY.data(), bodyMass.data(), padded, sortedX[k], sortedY[k], epsSq, sumX,
+                          sumY);
+                ax[i] = sumX;
+                ay[i] = sumY;
+                found += listed;
+            }
+        }
+        interactions += found;
+    });
+    return interactions;
+}
+
+size_t BarnesHutTree::attract(BallStore& balls, float strength, float openingAngle, ThreadPool* pool) {
+    size_t n = balls.getCount();
+    size_t awake = balls.getAwakeCount();
+    if (n < 2 || awake == 0 || strength == 0.0f) return 0;
+
+    const float* radius = balls.size.data();
+    float maxRadius = 0.0f;
+    mass.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        mass[i] = radius[i] * radius[i];
+        maxRadius = std::max(maxRadius, radius[i]);
+    }
+    build(balls.x.data(), balls.y.data(), mass.data(), n, maxRadius, pool);
+
+    accelX.resize(awake);
+    accelY.resize(awake);
+    size_t interactions = accelerations(awake, openingAngle, accelX.data(), accelY.data(), pool);
+    float* pvx = balls.vx.data();
+    float* pvy = balls.vy.data();
+    for (size_t i = 0; i < awake; i++) {
+        pvx[i] += strength * accelX[i];
+        pvy[i] += strength * accelY[i];
+    }
+    return interactions;
+}
@@ -0,0 +1,97 @@
+#ifndef BARNESHUT_H
+#define BARNESHUT_H
+
+#include "ballstore.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Barnes-Hut quadtree for mutual attraction between balls, rebuilt from
+ * scratch every step.
+ *
+ * Points get 32-bit Morton codes (16 bits per axis) inside the square
+ * around all of them and are radix-sorted by code, so every quadtree
+ * cell is a contiguous run of sorted points and its children are found
+ * by binary search on the next two bits. The top levels are built
+ * serially; the subtrees below them are independent runs and are built
+ * across threads, then appended in order, so the tree is the same for
+ * any thread count.
+ *
+ * A force pass walks the tree once per leaf and replaces a cell by its
+ * total mass at its centre of mass once the cell is smaller than
+ * openingAngle times its distance from the leaf, which makes the pass
+ * O(n log n). The bodies found make one interaction list that every
+ * point of the leaf then sums in a tight loop.
+ */
+class BarnesHutTree {
+public:
+    BarnesHutTree() : rootSize(0.0f), softeningSq(0.0f) {}
+
+    /**
+     * Build the tree over count points. softening is added in quadrature
+     * to every distance, so close pairs get a bounded pull.
+     */
+    void build(const float* x, const float* y, const float* mass, size_t count, float softening,
+               ThreadPool* pool);
+
+    /**
+     * Acceleration at each of the first count built points from all the
+     * others, for unit attraction strength, written to ax and ay. Runs
+     * across pool when it is not null.
+     *
+     * @return Number of point and cell interactions evaluated
+     */
+    size_t accelerations(size_t count, float openingAngle, float* ax, float* ay, ThreadPool* pool) const;
+
+    /**
+     * Pull the awake balls towards all balls, with mass proportional to
+     * size squared as in collideBalls: each awake ball's velocity changes
+     * by strength times its acceleration. Dormant balls pull but are not
+     * pulled. Softened by the largest radius.
+     *
+     * @return Number of interactions evaluated
+     */
+    size_t attract(BallStore& balls, float strength, float openingAngle, ThreadPool* pool);
+
+    size_t nodeCount() const { return nodes.size(); }
+
+private:
+    BarnesHutTree(const BarnesHutTree&);
+    BarnesHutTree& operator=(const BarnesHutTree&);
+
+    // A cell holds sorted points [begin, end); an internal cell has
+    // childCount children stored from nodes[child] on, a leaf has none
+    struct Node {
+        float comX, comY, mass;
+        float size;  // Side of the square cell
+        uint32_t begin, end;
+        uint32_t child, childCount;
+    };
+
+    // Subtree below the serially built levels, built on its own
+    struct Subtree {
+        uint32_t node;  // Its root among the top-level nodes
+        uint32_t begin, end;
+        int level;
+        std::vector<Node> nodes;  // Root first, then its descendants
+    };
+
+    void buildNode(std::vector<Node>& out, uint32_t index, uint32_t begin, uint32_t end, int level,
+                   int deferLevel);
+    void summarize(std::vector<Node>& out, uint32_t index) const;
+
+    float rootSize;
+    float softeningSq;
+    std::vector<Node> nodes;
+    std::vector<Subtree> subtrees;
+    std::vector<uint32_t> leaves;  // Leaf nodes in point order
+    std::vector<uint32_t> code, order;           // Morton code and original index of each sorted point
+    std::vector<uint32_t> codeScratch, orderScratch;
+    std::vector<float> sortedX, sortedY, sortedMass;
+    std::vector<float> mass, accelX, accelY;     // attract scratch, by ball index
+};
+
+#endif
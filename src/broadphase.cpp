@@ -0,0 +1,116 @@
+#include "broadphase.h"
+#include <algorithm>
+
+void SpatialGrid::build(const float* x, const float* y, size_t count, float size) {
+    cellSize = size;
+    invCellSize = 1.0f / size;
+
+    // Power-of-two table with about two buckets per point
+    uint32_t tableSize = 16;
+    while (tableSize < count * 2) tableSize <<= 1;
+    tableMask = tableSize - 1;
+
+    cellX.resize(count);
+    cellY.resize(count);
+    sorted.resize(count);
+    bucketOf.resize(count);
+    bucketStart.assign(tableSize + 1, 0);
+
+    // Count points per bucket
+    for (size_t i = 0; i < count; i++) {
+        cellX[i] = cellCoord(x[i]);
+        cellY[i] = cellCoord(y[i]);
+        bucketOf[i] = hashCell(cellX[i], cellY[i]);
+        bucketStart[bucketOf[i] + 1]++;
+    }
+
+    // Prefix sum, then scatter indices into their buckets
+    for (uint32_t b = 0; b < tableSize; b++)
+        bucketStart[b + 1] += bucketStart[b];
+
+    fillPos.assign(bucketStart.begin(), bucketStart.end() - 1);
+    for (size_t i = 0; i < count; i++)
+        sorted[fillPos[bucketOf[i]]++] = (uint32_t)i;
+}
+
+size_t collideBalls(BallStore& balls, const BallStepParams& params, SpatialGrid& grid) {
+    size_t n = balls.getCount();
+    size_t awake = balls.getAwakeCount();
+    if (n < 2 || awake == 0) return 0;
+
+    float* px = balls.x.data();
+    float* py = balls.y.data();
+    float* pvx = balls.vx.data();
+    float* pvy = balls.vy.data();
+    const float* radius = balls.size.data();
+    uint8_t* flags = balls.flags.data();
+
+    float maxRadius = 0.0f;
+    for (size_t i = 0; i < n; i++)
+        maxRadius = std::max(maxRadius, radius[i]);
+    if (maxRadius <= 0.0f) return 0;
+
+    // Any two touching balls lie in neighbouring cells. Dormant balls are
+    // in the grid so awake balls can land on them, but dormant pairs are
+    // never tested: j > i always holds for a dormant j.
+    grid.build(px, py, n, 2.0f * maxRadius);
+
+    size_t contacts = 0;
+    for (size_t i = 0; i < awake; i++) {
+        grid.forEachNeighbor(px[i], py[i], [&](uint32_t j) {
+            if (j <= i) return;
+
+            float dx = px[j] - px[i];
+            float dy = py[j] - py[i];
+            float minDist = radius[i] + radius[j];
+            float distSq = dx * dx + dy * dy;
+            if (distSq >= minDist * minDist) return;
+
+            float dist = std::sqrt(distSq);
+            float nx, ny;
+            if (dist > 1e-6f) {
+                nx = dx / dist;
+                ny = dy / dist;
+            } else {
+                // Coincident centres: separate sideways
+                nx = 1.0f;
+                ny = 0.0f;
+            }
+
+            // Mass proportional to area
+            float invMassI = 1.0f / (radius[i] * radius[i]);
+            float invMassJ = 1.0f / (radius[j] * radius[j]);
+            float invMassSum = invMassI + invMassJ;
+
+            // Push apart so the balls just touch
+            float overlap = (minDist - dist) / invMassSum;
+            px[i] -= nx * overlap * invMassI;
+            py[i] -= ny * overlap * invMassI;
+            px[j] += nx * overlap * invMassJ;
+            py[j] += ny * overlap * invMassJ;
+
+            // Exchange an impulse if they are still approaching
+            float vn = (pvx[j] - pvx[i]) * nx + (pvy[j] - pvy[i]) * ny;
+            if (vn < 0.0f) {
+                float impulse = -(1.0f + params.restitution) * vn / invMassSum;
+                pvx[i] -= impulse * invMassI * nx;
+                pvy[i] -= impulse * invMassI * ny;
+                pvx[j] += impulse * invMassJ * nx;
+                pvy[j] += impulse * invMassJ * ny;
+            }
+            flags[i] |= BALL_CONTACT;
+            flags[j] |= BALL_CONTACT;
+            contacts++;
+        });
+    }
+
+    // Keep separated balls inside the walls
+    for (size_t i = 0; i < n; i++) {
+        int type = balls.type[i];
+        float extentX = radius[i] * params.extentX[type];
+        float extentY = radius[i] * params.extentY[type];
+        px[i] = std::min(std::max(px[i], params.left + extentX), params.right - extentX);
+        py[i] = std::min(py[i], params.bottom - extentY);
+    }
+    return contacts;
+}
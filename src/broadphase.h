@@ -0,0 +1,75 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include "ballstore.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Uniform-grid spatial hash rebuilt from scratch every step.
+ * Points are bucketed by a counting sort on their hashed cell, so a
+ * build is two linear passes and neighbour queries touch only the 3x3
+ * block of cells around a point.
+ */
+class SpatialGrid {
+public:
+    SpatialGrid() : cellSize(1.0f), invCellSize(1.0f), tableMask(0) {}
+
+    // Bucket count points; cellSize should be at least the largest interaction distance
+    void build(const float* x, const float* y, size_t count, float cellSize);
+
+    float getCellSize() const { return cellSize; }
+
+    /**
+     * Call fn(j) for every point j stored in the 3x3 cells around (px, py).
+     * Each point is visited once even if two cells share a hash bucket.
+     */
+    template <typename Fn>
+    void forEachNeighbor(float px, float py, Fn fn) const {
+        int32_t cx = cellCoord(px);
+        int32_t cy = cellCoord(py);
+        for (int32_t dy = -1; dy <= 1; dy++) {
+            for (int32_t dx = -1; dx <= 1; dx++) {
+                int32_t nx = cx + dx, ny = cy + dy;
+                uint32_t bucket = hashCell(nx, ny);
+                for (uint32_t k = bucketStart[bucket]; k < bucketStart[bucket + 1]; k++) {
+                    uint32_t j = sorted[k];
+                    if (cellX[j] == nx && cellY[j] == ny) fn(j);
+                }
+            }
+        }
+    }
+
+private:
+    int32_t cellCoord(float v) const {
+        return (int32_t)std::floor(v * invCellSize);
+    }
+    uint32_t hashCell(int32_t cx, int32_t cy) const {
+        return ((uint32_t)cx * 73856093u ^ (uint32_t)cy * 19349663u) & tableMask;
+    }
+
+    float cellSize;
+    float invCellSize;
+    uint32_t tableMask;
+    std::vector<int32_t> cellX, cellY;    // Cell of each point
+    std::vector<uint32_t> bucketStart;    // Prefix sums, one past each bucket
+    std::vector<uint32_t> sorted;         // Point indices grouped by bucket
+    std::vector<uint32_t> bucketOf;       // Build scratch: bucket of each point
+    std::vector<uint32_t> fillPos;        // Build scratch: next free slot per bucket
+};
+
+/**
+ * Resolve overlapping balls, treating BallObject::size as the radius and
+ * mass as proportional to size squared. Overlaps are separated along the
+ * contact normal and approaching pairs exchange a restitution impulse.
+ * Balls pushed past the walls in params are clamped back inside.
+ * Only pairs with an awake ball are tested; both balls of a contact get
+ * BALL_CONTACT in their flags.
+ *
+ * @return Number of contacts resolved
+ */
+size_t collideBalls(BallStore& balls, const BallStepParams& params, SpatialGrid& grid);
+
+#endif
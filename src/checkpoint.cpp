@@ -0,0 +1,63 @@
+#include "checkpoint.h"
+#include <cstdio>
+#include <iostream>
+
+static const char SNAPSHOT_MAGIC[8] = { 'B', 'B', 'S', 'N', 'A', 'P', 'v', '1' };
+static const size_t HEADER_SIZE = 16;  // Magic, total size including the header
+
+SnapshotWriter SimSnapshot::beginWrite() {
+    blob.clear();
+    blob.assign(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + sizeof(SNAPSHOT_MAGIC));
+    blob.resize(HEADER_SIZE, 0);
+    return SnapshotWriter(blob);
+}
+
+void SimSnapshot::endWrite() {
+    if (blob.size() < HEADER_SIZE) return;
+    uint64_t total = blob.size();
+    std::memcpy(&blob[8], &total, sizeof(total));
+}
+
+bool SimSnapshot::beginRead(SnapshotReader& reader) const {
+    if (blob.size() < HEADER_SIZE || std::memcmp(&blob[0], SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+        return false;
+    uint64_t total;
+    std::memcpy(&total, &blob[8], sizeof(total));
+    if (total != blob.size()) return false;  // Cut short, or endWrite never ran
+    reader = SnapshotReader(&blob[0] + HEADER_SIZE, &blob[0] + blob.size());
+    return true;
+}
+
+bool SimSnapshot::saveFile(const char* path) const {
+    FILE* file = std::fopen(path, "wb");
+    if (!file) {
+        std::cerr << "Failed to create checkpoint " << path << std::endl;
+        return false;
+    }
+    bool ok = blob.empty() || std::fwrite(&blob[0], 1, blob.size(), file) == blob.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) std::cerr << "Failed to write checkpoint " << path << std::endl;
+    return ok;
+}
+
+bool SimSnapshot::loadFile(const char* path) {
+    FILE* file = std::fopen(path, "rb");
+    if (!file) {
+        std::cerr << "Failed to open checkpoint " << path << std::endl;
+        return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    long length = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    bool ok = length >= 0;
+    if (ok) {
+        blob.resize((size_t)length);
+        ok = length == 0 || std::fread(&blob[0], 1, blob.size(), file) == blob.size();
+    }
+    std::fclose(file);
+    if (!ok) {
+        blob.clear();
+        std::cerr << "Failed to read checkpoint " << path << std::endl;
+    }
+    return ok;
+}
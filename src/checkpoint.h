@@ -0,0 +1,163 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/**
+ * Checkpoints of the simulation state.
+ *
+ * A snapshot is one contiguous, pointer-free byte blob: a header
+ * followed by the sections its writer appended in order, each array
+ * stored as its element count and then its raw bytes. Capturing and
+ * restoring are plain memcpys of the stores' field arrays, so a
+ * million-ball state round-trips in a few milliseconds, and the blob can
+ * be kept in memory or written to disk as is. Values are stored in the
+ * host's byte order and layout; snapshots are meant for restarting on
+ * the machine that took them, not for exchange (see recording.h).
+ */
+
+/**
+ * Appends values and arrays to a snapshot blob
+ */
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(std::vector<uint8_t>& out) : out(out) {}
+
+    void bytes(const void* data, size_t n) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        out.insert(out.end(), p, p + n);
+    }
+
+    // Any trivially copyable value
+    template <typename T>
+    void value(const T& v) { bytes(&v, sizeof(T)); }
+
+    // Element count, then the elements
+    template <typename T>
+    void array(const T* data, size_t n) {
+        value((uint64_t)n);
+        bytes(data, n * sizeof(T));
+    }
+
+private:
+    std::vector<uint8_t>& out;
+};
+
+/**
+ * Reads back what a SnapshotWriter appended, in the same order. Reading
+ * past the end or an array longer than the caller allows sets ok to
+ * false and leaves the destination untouched, so callers check once
+ * after reading a whole section.
+ */
+class SnapshotReader {
+public:
+    SnapshotReader() : p(nullptr), end(nullptr), ok(false) {}
+    SnapshotReader(const uint8_t* begin, const uint8_t* stop) : p(begin), end(stop), ok(true) {}
+
+    void bytes(void* data, size_t n) {
+        if (!ok || (size_t)(end - p) < n) {
+            ok = false;
+            return;
+        }
+        if (n) std::memcpy(data, p, n);
+        p += n;
+    }
+
+    template <typename T>
+    void value(T& v) { bytes(&v, sizeof(T)); }
+
+    // Element count of the next array, without consuming it
+    size_t peekCount() {
+        uint64_t n = 0;
+        if (ok && (size_t)(end - p) >= sizeof(n)) std::memcpy(&n, p, sizeof(n));
+        return (size_t)n;
+    }
+
+    /**
+     * Read an array of exactly n elements into data.
+     * Fails if the stored count differs.
+     */
+    template <typename T>
+    void array(T* data, size_t n) {
+        uint64_t stored = 0;
+        value(stored);
+        if (stored != n || (size_t)(end - p) / sizeof(T) < n) {
+            ok = false;
+            return;
+        }
+        bytes(data, n * sizeof(T));
+    }
+
+    // Read an array of at most maxCount elements into a vector
+    template <typename T>
+    void vector(std::vector<T>& data, size_t maxCount) {
+        size_t n = peekCount();
+        if (n > maxCount || (size_t)(end - p) / sizeof(T) < n) {
+            ok = false;
+            return;
+        }
+        data.resize(n);
+        array(data.empty() ? nullptr : &data[0], n);
+    }
+
+    bool good() const { return ok; }
+    bool atEnd() const { return p == end; }
+    size_t remaining() const { return (size_t)(end - p); }
+    void fail() { ok = false; }
+
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok;
+};
+
+/**
+ * Owns one snapshot blob. The callers decide what goes in it by writing
+ * sections (e.g. BallStore::save) between beginWrite and endWrite, and
+ * read them back in the same order after beginRead. The blob is reused
+ * across captures, so taking a checkpoint allocates only when the state
+ * has grown.
+ */
+class SimSnapshot {
+public:
+    SimSnapshot() {}
+
+    // Drop the contents and start a new snapshot
+    SnapshotWriter beginWrite();
+
+    // Finish the snapshot started by beginWrite
+    void endWrite();
+
+    /**
+     * Start reading the sections back.
+     *
+     * @return false if the blob is empty or not a complete snapshot
+     */
+    bool beginRead(SnapshotReader& reader) const;
+
+    bool empty() const { return blob.empty(); }
+    const uint8_t* data() const { return blob.empty() ? nullptr : &blob[0]; }
+    size_t size() const { return blob.size(); }
+
+    // Replace the contents with a blob taken elsewhere (checked by beginRead)
+    void assign(const uint8_t* data, size_t size) { blob.assign(data, data + size); }
+
+    /**
+     * Write the blob to path, or read it back.
+     *
+     * @return false if the file could not be written or read
+     */
+    bool saveFile(const char* path) const;
+    bool loadFile(const char* path);
+
+private:
+    SimSnapshot(const SimSnapshot&);
+    SimSnapshot& operator=(const SimSnapshot&);
+
+    std::vector<uint8_t> blob;
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include "ensemble.h"
+#include "simdops.h"
+#include "simulation.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+// Members handed to a worker at a time (a multiple of Ensemble::LANES)
+static const size_t ENSEMBLE_CHUNK = 256;
+
+// Floor rebounds slower than this settle, as in updateBall
+static const float MIN_BOUNCE = 0.5f;
+
+// A member on the floor with |vx| + |vy| below this is at rest (see integrateBalls)
+static const float REST_ENERGY = 0.1f;
+
+void Ensemble::reserve(size_t n) {
+    if (n <= cap) return;
+    size_t newCap = cap ? cap : LANES;
+    while (newCap < n) newCap *= 2;
+    newCap = (newCap + LANES - 1) / LANES * LANES;
+
+    gravity.reallocate(newCap, count);
+    restitution.reallocate(newCap, count);
+    airResistance.reallocate(newCap, count);
+    vx.reallocate(newCap, count);
+    vy.reallocate(newCap, count);
+    bounces.reallocate(newCap, count);
+    restTime.reallocate(newCap, count);
+    peakHeight.reallocate(newCap, count);
+    cap = newCap;
+}
+
+size_t Ensemble::push(const EnsembleMember& member) {
+    if (count == cap) reserve(count + 1);
+    size_t i = count++;
+    gravity[i] = member.gravity;
+    restitution[i] = member.restitution;
+    airResistance[i] = member.airResistance;
+    vx[i] = member.vx;
+    vy[i] = member.vy;
+    bounces[i] = 0.0f;
+    restTime[i] = -1.0f;
+    peakHeight[i] = 0.0f;
+    return i;
+}
+
+EnsembleStats Ensemble::stats(size_t i) const {
+    EnsembleStats s;
+    s.bounces = (uint32_t)bounces[i];
+    s.restTime = restTime[i];
+    s.peakHeight = peakHeight[i];
+    return s;
+}
+
+// Per-step quantities shared by every member, as updateBall derives them
+struct EnsembleStep {
+    float stepFrames;  // Reference frames per step
+    float move;        // Velocity-to-displacement scale
+    float stepTime;    // Simulated seconds per step
+    float left, right, bottom;
+    size_t maxSteps;
+};
+
+static EnsembleStep setupEnsembleStep(const EnsembleSettings& s) {
+    EnsembleStep k;
+    k.stepFrames = s.dt * REFERENCE_HZ;
+    k.move = s.speed * k.stepFrames;
+    k.stepTime = s.dt * s.speed;
+    k.left = s.width * 0.05f;
+    k.right = s.width * 0.95f;
+    k.bottom = s.height * 0.9f;
+    k.maxSteps = k.stepTime > 0.0f ? (size_t)std::ceil(s.maxTime / k.stepTime) : 0;
+    return k;
+}
+
+#ifdef HAVE_SIMD_OPS
+
+// Lane numbers, for masking the partial vector at the end of a range
+alignas(32) static const float LANE_INDEX[8] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+
+size_t runEnsembleRange(Ensemble& e, const EnsembleSettings& s, size_t begin, size_t end) {
+    typedef SimdOps::V V;
+    const int W = SimdOps::WIDTH;
+    const EnsembleStep k = setupEnsembleStep(s);
+
+    const V stepFrames = SimdOps::set1(k.stepFrames);
+    const V move = SimdOps::set1(k.move);
+    const V left = SimdOps::set1(k.left);
+    const V right = SimdOps::set1(k.right);
+    const V bottom = SimdOps::set1(k.bottom);
+    const V restLine = SimdOps::set1(k.bottom - 1.0f);
+    const V zero = SimdOps::set1(0.0f);
+    const V one = SimdOps::set1(1.0f);
+    const V minBounce = SimdOps::set1(MIN_BOUNCE);
+    const V restEnergy = SimdOps::set1(REST_ENERGY);
+    const V signBit = SimdOps::set1(-0.0f);
+    const V laneIndex = SimdOps::load(LANE_INDEX);
+    const int allLanes = (1 << W) - 1;
+
+    alignas(32) float airStep[8];
+    size_t memberSteps = 0;
+    for (size_t i = begin; i < end; i += W) {
+        int lanes = (end - i < (size_t)W) ? (int)(end - i) : W;
+
+        // Air resistance per step needs a pow, so it is converted once per vector
+        for (int l = 0; l < W; l++)
+            airStep[l] = std::pow(e.airResistance[i + l], k.stepFrames);
+        const V gravity = SimdOps::mul(SimdOps::load(e.gravity.data() + i), stepFrames);
+        const V air = SimdOps::load(airStep);
+        const V restitution = SimdOps::load(e.restitution.data() + i);
+
+        V x = SimdOps::set1(s.startX);
+        V y = SimdOps::set1(s.startY);
+        V vx = SimdOps::load(e.vx.data() + i);
+        V vy = SimdOps::load(e.vy.data() + i);
+        V bounces = zero;
+        V restStep = SimdOps::set1(-1.0f);
+        V peak = SimdOps::sub(bottom, y);
+
+        // Lanes past end are done from the start, so padding cannot keep a vector running
+        V done = SimdOps::ge(laneIndex, SimdOps::set1((float)lanes));
+        size_t step = 0;
+        while (step < k.maxSteps && SimdOps::mask(done) != allLanes) {
+            V x0 = x, y0 = y;
+            vy = SimdOps::add(vy, gravity);
+            vx = SimdOps::mul(vx, air);
+            vy = SimdOps::mul(vy, air);
+            x = SimdOps::add(x, SimdOps::mul(vx, move));
+            y = SimdOps::add(y, SimdOps::mul(vy, move));
+
+            // Swept floor contact (see sweepWall); slow bounces settle on the floor
+            V floorHit = SimdOps::gt(y, bottom);
+            V below = SimdOps::min(SimdOps::sub(y, bottom), SimdOps::max(SimdOps::sub(y, y0), zero));
+            V bouncedVy = SimdOps::mul(SimdOps::bitXor(vy, signBit), restitution);
+            V settled = SimdOps::lt(SimdOps::bitAndNot(signBit, bouncedVy), minBounce);
+            bouncedVy = SimdOps::bitAndNot(settled, bouncedVy);
+            V reboundY = SimdOps::select(settled, bottom, SimdOps::sub(bottom, SimdOps::mul(below, restitution)));
+            vy = SimdOps::select(floorHit, bouncedVy, vy);
+            y = SimdOps::select(floorHit, reboundY, y);
+
+            // Swept side walls, clamped in case a rebound is longer than the arena is wide
+            V leftHit = SimdOps::lt(x, left);
+            V rightHit = SimdOps::bitAndNot(leftHit, SimdOps::gt(x, right));
+            V pastLeft = SimdOps::min(SimdOps::sub(left, x), SimdOps::max(SimdOps::sub(x0, x), zero));
+            V pastRight = SimdOps::min(SimdOps::sub(x, right), SimdOps::max(SimdOps::sub(x, x0), zero));
+            x = SimdOps::select(leftHit, SimdOps::add(left, SimdOps::mul(pastLeft, restitution)), x);
+            x = SimdOps::select(rightHit, SimdOps::sub(right, SimdOps::mul(pastRight, restitution)), x);
+            x = SimdOps::max(x, left);
+            x = SimdOps::min(x, right);
+            V wallHit = SimdOps::bitOr(leftHit, rightHit);
+            vx = SimdOps::select(wallHit, SimdOps::mul(SimdOps::bitXor(vx, signBit), restitution), vx);
+            step++;
+
+            // Statistics of the lanes still moving
+            V rebound = SimdOps::bitAndNot(done, SimdOps::bitAndNot(settled, floorHit));
+            bounces = SimdOps::add(bounces, SimdOps::bitAnd(rebound, one));
+            peak = SimdOps::max(peak, SimdOps::sub(bottom, y));
+            V energy = SimdOps::add(SimdOps::bitAndNot(signBit, vx), SimdOps::bitAndNot(signBit, vy));
+            V rest = SimdOps::bitAnd(SimdOps::ge(y, restLine), SimdOps::lt(energy, restEnergy));
+            restStep = SimdOps::select(SimdOps::bitAndNot(done, rest), SimdOps::set1((float)step), restStep);
+            done = SimdOps::bitOr(done, rest);
+        }
+        memberSteps += step * (size_t)lanes;
+
+        V restTime = SimdOps::select(SimdOps::ge(restStep, zero), SimdOps::mul(restStep, SimdOps::set1(k.stepTime)),
+                                     restStep);
+        if (lanes < W) {
+            // Keep whatever lies past end, which may belong to another range
+            V outside = SimdOps::ge(laneIndex, SimdOps::set1((float)lanes));
+            bounces = SimdOps::select(outside, SimdOps::load(e.bounces.data() + i), bounces);
+            restTime = SimdOps::select(outside, SimdOps::load(e.restTime.data() + i), restTime);
+            peak = SimdOps::select(outside, SimdOps::load(e.peakHeight.data() + i), peak);
+        }
+        SimdOps::store(e.bounces.data() + i, bounces);
+        SimdOps::store(e.restTime.data() + i, restTime);
+        SimdOps::store(e.peakHeight.data() + i, peak);
+    }
+    return memberSteps;
+}
+
+#else
+
+size_t runEnsembleRange(Ensemble& e, const EnsembleSettings& s, size_t begin, size_t end) {
+    const EnsembleStep k = setupEnsembleStep(s);
+    size_t memberSteps = 0;
+    for (size_t i = begin; i < end; i++) {
+        float gravity = e.gravity[i] * k.stepFrames;
+        float air = std::pow(e.airResistance[i], k.stepFrames);
+        float restitution = e.restitution[i];
+        float x = s.startX, y = s.startY;
+        float vx = e.vx[i], vy = e.vy[i];
+        float bounces = 0.0f, restTime = -1.0f;
+        float peak = k.bottom - y;
+
+        size_t step = 0;
+        while (step < k.maxSteps) {
+            float x0 = x, y0 = y;
+            vy += gravity;
+            vx *= air;
+            vy *= air;
+            x += vx * k.move;
+            y += vy * k.move;
+
+            if (sweepWall(y0, y, k.bottom, 1.0f, restitution)) {
+                vy = -vy * restitution;
+                if (std::fabs(vy) < MIN_BOUNCE) {
+                    vy = 0.0f;
+                    y = k.bottom;
+                } else {
+                    bounces += 1.0f;
+                }
+            }
+            if (sweepWall(x0, x, k.left, -1.0f, restitution) || sweepWall(x0, x, k.right, 1.0f, restitution))
+                vx = -vx * restitution;
+            x = std::min(std::max(x, k.left), k.right);
+            step++;
+
+            peak = std::max(peak, k.bottom - y);
+            if (y >= k.bottom - 1.0f && std::fabs(vx) + std::fabs(vy) < REST_ENERGY) {
+                restTime = step * k.stepTime;
+                break;
+            }
+        }
+        memberSteps += step;
+        e.bounces[i] = bounces;
+        e.restTime[i] = restTime;
+        e.peakHeight[i] = peak;
+    }
+    return memberSteps;
+}
+
+#endif
+
+size_t runEnsemble(Ensemble& ensemble, const EnsembleSettings& settings, ThreadPool* pool) {
+    size_t count = ensemble.getCount();
+    if (!pool || count <= ENSEMBLE_CHUNK)
+        return runEnsembleRange(ensemble, settings, 0, count);
+
+    std::atomic<size_t> memberSteps(0);
+    pool->parallelFor(count, ENSEMBLE_CHUNK, [&](size_t begin, size_t end, unsigned) {
+        memberSteps += runEnsembleRange(ensemble, settings, begin, end);
+    });
+    return memberSteps;
+}
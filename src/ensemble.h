@@ -0,0 +1,104 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include "ballstore.h"
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+// Physics parameters of one ensemble member, in the units of SimSettings
+struct EnsembleMember {
+    float gravity;
+    float restitution;
+    float airResistance;
+    float vx, vy;  // Launch velocity, pixels per reference frame
+};
+
+// Outcome of one member's run
+struct EnsembleStats {
+    uint32_t bounces;  // Floor hits the ball rebounded from
+    float restTime;    // Seconds until the ball came to rest, or -1 if it never did
+    float peakHeight;  // Highest point above the floor, in pixels
+};
+
+/**
+ * Settings shared by every member. The arena matches single-ball mode:
+ * walls at 5%/95% of the width and the floor at 90% of the height.
+ */
+struct EnsembleSettings {
+    float width, height;    // Arena size in pixels
+    float startX, startY;   // Launch position
+    float dt;               // Step size in seconds
+    float speed;            // Simulation speed multiplier
+    float maxTime;          // Members still moving after this many seconds never rest
+
+    EnsembleSettings()
+        : width(800.0f), height(600.0f), startX(40.0f), startY(40.0f), dt(1.0f / 120.0f), speed(1.0f),
+          maxTime(60.0f) {}
+};
+
+/**
+ * Independent single-ball simulations with per-member parameters, for
+ * sweeping the physics constants.
+ *
+ * Every member follows the single-ball path of updateBall (gravity, air
+ * resistance, swept floor and wall contacts, slow bounces settling on
+ * the floor) without obstacles. A member is at rest once it lies on the
+ * floor with |vx| + |vy| below 0.1, the test multi-object mode expires
+ * resting balls with. Members are stored as structure of arrays and run
+ * a SIMD vector at a time: one vector's state stays in registers for its
+ * whole run, which ends as soon as all of its lanes are at rest.
+ */
+class Ensemble {
+public:
+    static const size_t LANES = BallStore::LANES;
+
+    // Member parameters, per reference frame like SimSettings
+    AlignedArray<float> gravity;
+    AlignedArray<float> restitution;
+    AlignedArray<float> airResistance;
+    AlignedArray<float> vx, vy;  // Launch velocity
+
+    // Results written by runEnsemble; bounces holds whole numbers
+    AlignedArray<float> bounces;
+    AlignedArray<float> restTime;
+    AlignedArray<float> peakHeight;
+
+    Ensemble() : count(0), cap(0) {}
+
+    size_t getCount() const { return count; }
+    size_t capacity() const { return cap; }
+    bool empty() const { return count == 0; }
+    void clear() { count = 0; }
+
+    void reserve(size_t n);
+
+    // Add a member and return its index
+    size_t push(const EnsembleMember& member);
+
+    // Results of member i after runEnsemble
+    EnsembleStats stats(size_t i) const;
+
+private:
+    Ensemble(const Ensemble&);
+    Ensemble& operator=(const Ensemble&);
+
+    size_t count;
+    size_t cap;
+};
+
+/**
+ * Run members [begin, end) from launch until they rest or maxTime
+ * passes. begin must be a multiple of Ensemble::LANES so ranges can run
+ * on separate threads.
+ *
+ * @return Number of member-steps simulated; a vector's members all
+ *         take as many steps as its slowest one
+ */
+size_t runEnsembleRange(Ensemble& ensemble, const EnsembleSettings& settings, size_t begin, size_t end);
+
+// Run every member, across pool when it is not null, returning the member-steps simulated
+size_t runEnsemble(Ensemble& ensemble, const EnsembleSettings& settings, ThreadPool* pool);
+
+#endif
@@ -0,0 +1,99 @@
+#include "glstate.h"
+
+GLStateCache glState;
+
+// Stands for a binding or enum GL may hold anything in
+static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+static const GLenum CACHED_CAPABILITIES[] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_PROGRAM_POINT_SIZE };
+
+void GLStateCache::invalidate() {
+    program = vertexArray = arrayBuffer = uniformBuffer = UNKNOWN;
+    for (int i = 0; i < UNIFORM_BINDINGS; i++) uniformBinding[i] = UNKNOWN;
+    textureUnit = UNKNOWN;
+    for (int i = 0; i < TEXTURE_UNITS; i++) texture2D[i] = UNKNOWN;
+    polygon = UNKNOWN;
+    for (int i = 0; i < CAPABILITIES; i++) capability[i] = -1;
+    blendSource = blendDestination = UNKNOWN;
+    width = -1.0f;
+}
+
+void GLStateCache::useProgram(GLuint p) {
+    if (change(p != program)) {
+        glUseProgram(p);
+        program = p;
+    }
+}
+
+void GLStateCache::bindVertexArray(GLuint vao) {
+    if (change(vao != vertexArray)) {
+        glBindVertexArray(vao);
+        vertexArray = vao;
+    }
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer) {
+    GLuint* bound = target == GL_ARRAY_BUFFER ? &arrayBuffer : target == GL_UNIFORM_BUFFER ? &uniformBuffer : nullptr;
+    if (change(!bound || buffer != *bound)) {
+        glBindBuffer(target, buffer);
+        if (bound) *bound = buffer;
+    }
+}
+
+void GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    GLuint* bound = target == GL_UNIFORM_BUFFER && index < (GLuint)UNIFORM_BINDINGS ? &uniformBinding[index] : nullptr;
+    if (change(!bound || buffer != *bound)) {
+        glBindBufferBase(target, index, buffer);
+        if (bound) *bound = buffer;
+        if (target == GL_UNIFORM_BUFFER) uniformBuffer = buffer;
+    }
+}
+
+void GLStateCache::activeTexture(GLenum unit) {
+    if (change(unit != textureUnit)) {
+        glActiveTexture(unit);
+        textureUnit = unit;
+    }
+}
+
+void GLStateCache::bindTexture(GLenum target, GLuint texture) {
+    int unit = textureUnit == UNKNOWN ? -1 : (int)(textureUnit - GL_TEXTURE0);
+    GLuint* bound = target == GL_TEXTURE_2D && unit >= 0 && unit < TEXTURE_UNITS ? &texture2D[unit] : nullptr;
+    if (change(!bound || texture != *bound)) {
+        glBindTexture(target, texture);
+        if (bound) *bound = texture;
+    }
+}
+
+void GLStateCache::polygonMode(GLenum mode) {
+    if (change(mode != polygon)) {
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+        polygon = mode;
+    }
+}
+
+void GLStateCache::setEnabled(GLenum cap, bool enabled) {
+    int* state = nullptr;
+    for (int i = 0; i < CAPABILITIES; i++)
+        if (CACHED_CAPABILITIES[i] == cap) state = &capability[i];
+    if (change(!state || *state != (enabled ? 1 : 0))) {
+        if (enabled) glEnable(cap);
+        else glDisable(cap);
+        if (state) *state = enabled ? 1 : 0;
+    }
+}
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination) {
+    if (change(source != blendSource || destination != blendDestination)) {
+        glBlendFunc(source, destination);
+        blendSource = source;
+        blendDestination = destination;
+    }
+}
+
+void GLStateCache::lineWidth(float w) {
+    if (change(w != width)) {
+        glLineWidth(w);
+        width = w;
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include "Angel.h"
+#include <cstddef>
+
+/**
+ * Shadow copy of the GL bindings and fixed-function state the viewer
+ * changes while drawing: program, vertex array, array and uniform
+ * buffers, uniform block bindings, active texture unit and its 2D
+ * texture, polygon mode, enabled capabilities, blend function and line
+ * width.
+ *
+ * Every change goes through here and is only passed to GL when it
+ * differs from what GL already has, so drawing code can state what it
+ * needs per object without paying for the calls that change nothing.
+ * State starts unknown, so the first request for each one is always
+ * issued. Code that changes state behind the cache's back must call
+ * invalidate().
+ *
+ * The issued and elided counts cover every request, to measure how many
+ * driver calls the cache saves.
+ */
+class GLStateCache {
+public:
+    GLStateCache() : issued(0), elided(0) { invalidate(); }
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+
+    // Only GL_ARRAY_BUFFER and GL_UNIFORM_BUFFER are cached; the element
+    // buffer belongs to the vertex array and is always passed through
+    void bindBuffer(GLenum target, GLuint buffer);
+
+    // Indexed binding, which also sets the generic one; only
+    // GL_UNIFORM_BUFFER indices below UNIFORM_BINDINGS are cached
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+    void activeTexture(GLenum unit);
+
+    // Binds on the active unit; only GL_TEXTURE_2D is cached
+    void bindTexture(GLenum target, GLuint texture);
+
+    // Both faces
+    void polygonMode(GLenum mode);
+
+    // glEnable or glDisable; GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE and
+    // GL_PROGRAM_POINT_SIZE are cached
+    void setEnabled(GLenum capability, bool enabled);
+
+    void blendFunc(GLenum source, GLenum destination);
+    void lineWidth(float width);
+
+    // Forget everything, so the next request of each kind is issued
+    void invalidate();
+
+    size_t issuedCount() const { return issued; }
+    size_t elidedCount() const { return elided; }
+    void resetCounters() { issued = elided = 0; }
+
+private:
+    static const int TEXTURE_UNITS = 8;
+    static const int UNIFORM_BINDINGS = 8;
+    static const int CAPABILITIES = 4;
+
+    // Count the request and report whether it must reach GL
+    bool change(bool differs) {
+        if (differs) issued++;
+        else elided++;
+        return differs;
+    }
+
+    GLuint program, vertexArray, arrayBuffer, uniformBuffer;
+    GLuint uniformBinding[UNIFORM_BINDINGS];
+    GLenum textureUnit;
+    GLuint texture2D[TEXTURE_UNITS];
+    GLenum polygon;
+    int capability[CAPABILITIES];  // 1 on, 0 off, -1 unknown
+    GLenum blendSource, blendDestination;
+    float width;
+    size_t issued, elided;
+};
+
+// The viewer's one GL context
+extern GLStateCache glState;
+
+#endif
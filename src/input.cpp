@@ -8,11 +8,29 @@
 #include <iomanip>
 #include "texture.h"
 
-extern GLuint phongProgram, gouraudProgram, currentProgram;
 static bool usePhong = true;
 static int componentToggleIndex = 0;
 void toggleTexture();
 
+/**
+ * File name of the form prefix_YYYYMMDD_HHMMSS.extension for the current local time
+ */
+static std::string timestampedName(const char* prefix, const char* extension) {
+    std::time_t t = std::time(nullptr);
+    std::tm* now = std::localtime(&t);
+    std::stringstream ss;
+    ss << prefix << "_"
+       << (now->tm_year + 1900) 
+       << std::setfill('0') << std::setw(2) << (now->tm_mon + 1)
+       << std::setfill('0') << std::setw(2) << now->tm_mday
+       << "_"
+       << std::setfill('0') << std::setw(2) << now->tm_hour
+       << std::setfill('0') << std::setw(2) << now->tm_min
+       << std::setfill('0') << std::setw(2) << now->tm_sec
+       << "." << extension;
+    return ss.str();
+}
+
 /**
  * Callback function for keyboard input
  */
@@ -118,15 +136,8 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         case GLFW_KEY_S:  // Toggle shading technique (Phong/Gouraud)
             usePhong = !usePhong;
             useGouraud = !usePhong;
-            currentProgram = usePhong ? phongProgram : gouraudProgram;
-            glUseProgram(currentProgram);
-            
-            // Update uniform locations for the new program
-            modelLoc = glGetUniformLocation(currentProgram, "model");
-            projectionLoc = glGetUniformLocation(currentProgram, "projection");
-            objColorLoc = glGetUniformLocation(currentProgram, "objColor");
-            lightDirLoc = glGetUniformLocation(currentProgram, "lightDir");
-            viewPosLoc = glGetUniformLocation(currentProgram, "viewPos");
+            currentProgram = usePhong ? &phongProgram : &gouraudProgram;
+            currentProgram->use();
             
             std::cout << "Shading: " << (usePhong ? "Phong" : "Gouraud") << "\n";
             break;
@@ -147,19 +158,6 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
                     break;
             }
             componentToggleIndex = (componentToggleIndex + 1) % 3;
-            
-            // Update uniforms for both programs
-            glUseProgram(phongProgram);
-            glUniform1i(glGetUniformLocation(phongProgram, "useAmbient"), useAmbient);
-            glUniform1i(glGetUniformLocation(phongProgram, "useDiffuse"), useDiffuse);
-            glUniform1i(glGetUniformLocation(phongProgram, "useSpecular"), useSpecular);
-            
-            glUseProgram(gouraudProgram);
-            glUniform1i(glGetUniformLocation(gouraudProgram, "useAmbient"), useAmbient);
-            glUniform1i(glGetUniformLocation(gouraudProgram, "useDiffuse"), useDiffuse);
-            glUniform1i(glGetUniformLocation(gouraudProgram, "useSpecular"), useSpecular);
-            
-            glUseProgram(currentProgram);  // Switch back to current program
             break;
             
         case GLFW_KEY_L:  // Toggle light movement
@@ -176,6 +174,28 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             toggleTexture();
             break;
             
+        case GLFW_KEY_K:  // Toggle obstacles
+            toggleObstacles();
+            break;
+            
+        case GLFW_KEY_J:  // Toggle event-driven physics
+            eventPhysics = !eventPhysics;
+            std::cout << "Event-driven physics: " << (eventPhysics ? "On" : "Off") << "\n";
+            break;
+            
+        case GLFW_KEY_N:  // Cycle contact solver iterations (0 = impulse contacts)
+            contactIterations = contactIterations >= 16 ? 0 : std::max(contactIterations * 2, 1);
+            if (contactIterations > 0)
+                std::cout << "Contacts: position-based, " << contactIterations << " iterations\n";
+            else
+                std::cout << "Contacts: impulse\n";
+            break;
+            
+        case GLFW_KEY_A:  // Toggle mutual attraction between balls
+            ballAttraction = !ballAttraction;
+            std::cout << "Attraction: " << (ballAttraction ? "On" : "Off") << "\n";
+            break;
+            
         case GLFW_KEY_T:  // Toggle display mode
             currentRenderMode = static_cast<RenderMode>((currentRenderMode + 1) % 3);
             std::cout << "Render Mode: ";
@@ -242,22 +262,26 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             
         // Take a screenshot
         case GLFW_KEY_F12:
-            {
-                std::time_t t = std::time(nullptr);
-                std::tm* now = std::localtime(&t);
-                std::stringstream ss;
-                ss << "screenshot_" 
-                   << (now->tm_year + 1900) 
-                   << std::setfill('0') << std::setw(2) << (now->tm_mon + 1)
-                   << std::setfill('0') << std::setw(2) << now->tm_mday
-                   << "_"
-                   << std::setfill('0') << std::setw(2) << now->tm_hour
-                   << std::setfill('0') << std::setw(2) << now->tm_min
-                   << std::setfill('0') << std::setw(2) << now->tm_sec
-                   << ".ppm";
-                
-                takeScreenshot(ss.str());
-            }
+            takeScreenshot(timestampedName("screenshot", "ppm"));
+            break;
+            
+        // Start or stop recording multi-object steps
+        case GLFW_KEY_U:
+            toggleRecording(timestampedName("recording", "bbrec"));
+            break;
+            
+        // Save the simulation state, or go back to the last saved one
+        case GLFW_KEY_F6:
+            saveCheckpoint("checkpoint.bbsnap");
+            break;
+            
+        case GLFW_KEY_F7:
+            restoreCheckpoint("checkpoint.bbsnap");
+            break;
+            
+        // Load or clear the level in scene.txt
+        case GLFW_KEY_F8:
+            toggleScene();
             break;
             
         default:
@@ -320,17 +344,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     // Update view position for lighting (camera position in world space)
     vec3 viewPos(0.0f, 0.0f, 15.0f);
     
-    // Apply all updates to both shaders
-    glUseProgram(phongProgram);
-    glUniformMatrix4fv(glGetUniformLocation(phongProgram, "projection"), 1, GL_TRUE, viewProjection);
-    glUniform3fv(glGetUniformLocation(phongProgram, "viewPos"), 1, &viewPos[0]);
-    
-    glUseProgram(gouraudProgram);
-    glUniformMatrix4fv(glGetUniformLocation(gouraudProgram, "projection"), 1, GL_TRUE, viewProjection);
-    glUniform3fv(glGetUniformLocation(gouraudProgram, "viewPos"), 1, &viewPos[0]);
-    
-    // Switch back to current program
-    glUseProgram(currentProgram);
+    // Shared by every program through the camera block
+    uniformBlocks.setCamera(viewProjection, viewPos, (float)height);
     
     std::cout << "Window resized to " << width << "x" << height << std::endl;
 }
@@ -1,6 +1,6 @@
 #include "Angel.h"
 #include "Globals.h"
-#include "InitShader.h"
+#include "glstate.h"
 #include "input.h"
 #include "objects.h"
 #include "physics.h"
@@ -9,21 +9,22 @@
 #include <vector>
 #include <GLFW/glfw3.h>
 #include "texture.h"  
+#include "timestep.h"
 
 extern std::vector<Vertex> sphereData;
 
 // Setup textured sphere VAO
 static void setupTexturedSphereVAO() {
     glGenVertexArrays(1, &vaoSphere);
-    glBindVertexArray(vaoSphere);
+    glState.bindVertexArray(vaoSphere);
 
     glGenBuffers(1, &vboSphere);
-    glBindBuffer(GL_ARRAY_BUFFER, vboSphere);
+    glState.bindBuffer(GL_ARRAY_BUFFER, vboSphere);
     glBufferData(GL_ARRAY_BUFFER, sphereData.size() * sizeof(Vertex), sphereData.data(), GL_STATIC_DRAW);
 
-    GLuint posLoc = glGetAttribLocation(currentProgram, "vPosition");
-    GLuint normLoc = glGetAttribLocation(currentProgram, "vNormal");
-    GLuint texLoc  = glGetAttribLocation(currentProgram, "vTexCoord");
+    GLuint posLoc = currentProgram->attributeLocation(ATTRIBUTE_POSITION);
+    GLuint normLoc = currentProgram->attributeLocation(ATTRIBUTE_NORMAL);
+    GLuint texLoc  = currentProgram->attributeLocation(ATTRIBUTE_TEX_COORD);
 
     glEnableVertexAttribArray(posLoc);
     glVertexAttribPointer(posLoc, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(0));
@@ -34,16 +35,16 @@ static void setupTexturedSphereVAO() {
     glEnableVertexAttribArray(texLoc);
     glVertexAttribPointer(texLoc, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(sizeof(vec4) + sizeof(vec3)));
 
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
 }
 
 // Setup cube VAO with proper vertex structure
 static void setupCubeVAO() {
     glGenVertexArrays(1, &vaoCube);
-    glBindVertexArray(vaoCube);
+    glState.bindVertexArray(vaoCube);
     
     glGenBuffers(1, &vboCube);
-    glBindBuffer(GL_ARRAY_BUFFER, vboCube);
+    glState.bindBuffer(GL_ARRAY_BUFFER, vboCube);
     
     std::vector<Vertex> cubeCombined;
     for (size_t i = 0; i < cubeVertices.size(); ++i) {
@@ -52,9 +53,9 @@ static void setupCubeVAO() {
     
     glBufferData(GL_ARRAY_BUFFER, cubeCombined.size() * sizeof(Vertex), cubeCombined.data(), GL_STATIC_DRAW);
     
-    GLuint posLoc = glGetAttribLocation(currentProgram, "vPosition");
-    GLuint normLoc = glGetAttribLocation(currentProgram, "vNormal");
-    GLuint texLoc = glGetAttribLocation(currentProgram, "vTexCoord");
+    GLuint posLoc = currentProgram->attributeLocation(ATTRIBUTE_POSITION);
+    GLuint normLoc = currentProgram->attributeLocation(ATTRIBUTE_NORMAL);
+    GLuint texLoc = currentProgram->attributeLocation(ATTRIBUTE_TEX_COORD);
     
     glEnableVertexAttribArray(posLoc);
     glVertexAttribPointer(posLoc, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(0));
@@ -67,7 +68,7 @@ static void setupCubeVAO() {
         glVertexAttribPointer(texLoc, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(sizeof(vec4) + sizeof(vec3)));
     }
     
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
 }
 
 // Setup bunny VAO
@@ -75,10 +76,10 @@ static void setupBunnyVAO() {
     if (!bunnyLoaded) return;
     
     glGenVertexArrays(1, &vaoBunny);
-    glBindVertexArray(vaoBunny);
+    glState.bindVertexArray(vaoBunny);
     
     glGenBuffers(1, &vboBunny);
-    glBindBuffer(GL_ARRAY_BUFFER, vboBunny);
+    glState.bindBuffer(GL_ARRAY_BUFFER, vboBunny);
     
     std::vector<Vertex> bunnyCombined;
     for (size_t i = 0; i < bunnyVertices.size(); ++i) {
@@ -87,9 +88,9 @@ static void setupBunnyVAO() {
     
     glBufferData(GL_ARRAY_BUFFER, bunnyCombined.size() * sizeof(Vertex), bunnyCombined.data(), GL_STATIC_DRAW);
     
-    GLuint posLoc = glGetAttribLocation(currentProgram, "vPosition");
-    GLuint normLoc = glGetAttribLocation(currentProgram, "vNormal");
-    GLuint texLoc = glGetAttribLocation(currentProgram, "vTexCoord");
+    GLuint posLoc = currentProgram->attributeLocation(ATTRIBUTE_POSITION);
+    GLuint normLoc = currentProgram->attributeLocation(ATTRIBUTE_NORMAL);
+    GLuint texLoc = currentProgram->attributeLocation(ATTRIBUTE_TEX_COORD);
     
     glEnableVertexAttribArray(posLoc);
     glVertexAttribPointer(posLoc, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(0));
@@ -102,36 +103,24 @@ static void setupBunnyVAO() {
         glVertexAttribPointer(texLoc, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(sizeof(vec4) + sizeof(vec3)));
     }
     
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
 }
 
-// Setup a separate VAO/VBO for the trajectory  
-static void setupTrajectoryVAO() {
-    glGenVertexArrays(1, &vaoTrajectory);
-    glBindVertexArray(vaoTrajectory);
+// Setup a VAO/VBO of bare positions for line drawing. The normal is a
+// constant attribute set at draw time, so it costs no buffer space.
+static void setupLineVAO(GLuint& vao, GLuint& vbo, size_t vertices) {
+    glGenVertexArrays(1, &vao);
+    glState.bindVertexArray(vao);
     
-    glGenBuffers(1, &vboTrajectory);
-    glBindBuffer(GL_ARRAY_BUFFER, vboTrajectory);
-    glBufferData(GL_ARRAY_BUFFER, MAX_TRAJECTORY_POINTS * sizeof(vec4), nullptr, GL_DYNAMIC_DRAW);
+    glGenBuffers(1, &vbo);
+    glState.bindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices * sizeof(vec4), nullptr, GL_DYNAMIC_DRAW);
     
-    GLuint posLoc = glGetAttribLocation(currentProgram, "vPosition");
+    GLuint posLoc = currentProgram->attributeLocation(ATTRIBUTE_POSITION);
     glEnableVertexAttribArray(posLoc);
     glVertexAttribPointer(posLoc, 4, GL_FLOAT, GL_FALSE, 0, (GLvoid*)0);
     
-    GLuint normLoc = glGetAttribLocation(currentProgram, "vNormal");
-    if (normLoc != (GLuint)-1) {
-        GLuint normalVBO;
-        glGenBuffers(1, &normalVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
-        
-        std::vector<vec3> defaultNormals(MAX_TRAJECTORY_POINTS, vec3(0.0, 0.0, 1.0));
-        glBufferData(GL_ARRAY_BUFFER, MAX_TRAJECTORY_POINTS * sizeof(vec3), defaultNormals.data(), GL_STATIC_DRAW);
-        
-        glEnableVertexAttribArray(normLoc);
-        glVertexAttribPointer(normLoc, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)0);
-    }
-    
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
 }
 
 void initSphere(int subdivisions);
@@ -175,63 +164,37 @@ int main() {
     registerCallbacks(window);
     
     // ASSIGNMENT REQUIREMENT: Enable depth test and culling
-    glEnable(GL_DEPTH_TEST);
+    glState.setEnabled(GL_DEPTH_TEST, true);
     glDepthFunc(GL_LEQUAL);
-    glEnable(GL_CULL_FACE);  // Enable culling as required
+    glState.setEnabled(GL_CULL_FACE, true);  // Enable culling as required
     glCullFace(GL_BACK);     // Cull back-facing triangles
     glFrontFace(GL_CCW);     // Counter-clockwise is front-facing
     
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glState.setEnabled(GL_BLEND, true);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     
-    // Initialize shaders
-    phongProgram = Angel::InitShader("vshader.glsl", "fshader.glsl");
-    gouraudProgram = Angel::InitShader("vshader_gouraud.glsl", "fshader_gouraud.glsl");
+    // Initialize shaders; their uniform and attribute locations are resolved here once
+    phongProgram.load("vshader.glsl", "fshader.glsl");
+    gouraudProgram.load("vshader_gouraud.glsl", "fshader_gouraud.glsl");
+    instancedProgram.load("vshader_instanced.glsl", "fshader_instanced.glsl");
+    particleProgram.load("vshader_particles.glsl", "fshader_particles.glsl");
     
     // Start with Phong shading (default)
-    currentProgram = phongProgram;
-    glUseProgram(currentProgram);
-    
-    // Get uniform locations for current program
-    modelLoc = glGetUniformLocation(currentProgram, "model");
-    projectionLoc = glGetUniformLocation(currentProgram, "projection");
-    objColorLoc = glGetUniformLocation(currentProgram, "objColor");
-    lightDirLoc = glGetUniformLocation(currentProgram, "lightDir");
-    viewPosLoc = glGetUniformLocation(currentProgram, "viewPos");
-    
-    // Initialize lighting component uniforms for both programs
-    glUseProgram(phongProgram);
-    glUniform1i(glGetUniformLocation(phongProgram, "useAmbient"), useAmbient);
-    glUniform1i(glGetUniformLocation(phongProgram, "useDiffuse"), useDiffuse);
-    glUniform1i(glGetUniformLocation(phongProgram, "useSpecular"), useSpecular);
-    glUniform1i(glGetUniformLocation(phongProgram, "textureMap"), 0);
-    
-    glUseProgram(gouraudProgram);
-    glUniform1i(glGetUniformLocation(gouraudProgram, "useAmbient"), useAmbient);
-    glUniform1i(glGetUniformLocation(gouraudProgram, "useDiffuse"), useDiffuse);
-    glUniform1i(glGetUniformLocation(gouraudProgram, "useSpecular"), useSpecular);
-    glUniform1i(glGetUniformLocation(gouraudProgram, "textureMap"), 0);
+    currentProgram = &phongProgram;
     
     // Load default texture
     int texWidth, texHeight;
     texID = loadPPMTexture("earth.ppm", texWidth, texHeight);
     
-    // Set directional light
-    vec3 lightDir(0.5f, 1.0f, 0.75f);
-    glUseProgram(phongProgram);
-    glUniform3fv(glGetUniformLocation(phongProgram, "lightDir"), 1, &lightDir[0]);
-    
-    glUseProgram(gouraudProgram);
-    glUniform3fv(glGetUniformLocation(gouraudProgram, "lightDir"), 1, &lightDir[0]);
-    
-    // Set camera position (view position) - FIXED for perspective projection
+    // Camera, light and materials are shared blocks; display() keeps the light current
+    uniformBlocks.init(plasticShininess, plasticSpecularStrength, metallicShininess, metallicSpecularStrength);
     vec3 viewPos(0.0f, 0.0f, 15.0f);  // Camera positioned back from the scene
-    glUseProgram(phongProgram);
-    glUniform3fv(glGetUniformLocation(phongProgram, "viewPos"), 1, &viewPos[0]);
-    
-    glUseProgram(gouraudProgram);
-    glUniform3fv(glGetUniformLocation(gouraudProgram, "viewPos"), 1, &viewPos[0]);
+    ShaderProgram* programs[3] = { &phongProgram, &gouraudProgram, &instancedProgram };
+    for (int i = 0; i < 3; i++) {
+        programs[i]->use();
+        programs[i]->set(UNIFORM_TEXTURE_MAP, 0);
+    }
     
     // Initialize objects
     initCube();
@@ -241,6 +204,7 @@ int main() {
     if (loadBunnyModel("bunny.off")) {
         calculateBunnyNormals();
         bunnyLoaded = true;
+        initMeshColliders();
         std::cout << "Bunny model loaded successfully\n";
     } else {
         bunnyLoaded = false;
@@ -248,13 +212,22 @@ int main() {
     }
     
     // Set current program back to default
-    glUseProgram(currentProgram);
+    currentProgram->use();
     
     // Setup VAOs for all objects
     setupTexturedSphereVAO();
     setupCubeVAO();
     setupBunnyVAO();
-    setupTrajectoryVAO();
+    setupLineVAO(vaoTrajectory, vboTrajectory, 0);  // Sized to the ring on first upload
+    setupLineVAO(vaoGrid, vboGrid, 2 * 21 * 2);      // Finest grid: 21 lines each way
+    setupLineVAO(vaoScene, vboScene, 0);             // Sized to the level when it is loaded
+    
+    // Instanced multi-object balls share the mesh buffers
+    const GLuint meshBuffers[3] = { vboCube, vboSphere, vboBunny };
+    const int meshVertices[3] = { numCubeVertices, numSphereVertices, bunnyLoaded ? numBunnyVertices : 0 };
+    ballRenderer.init(instancedProgram, meshBuffers, meshVertices);
+    ballRenderer.setPalette(colorPalette);
+    particleRenderer.init(particleProgram);
     
     // FIXED: Setup proper perspective projection and view matrix
     glViewport(0, 0, windowWidth, windowHeight);
@@ -271,14 +244,9 @@ int main() {
     // Combine view and projection (since shader expects just "projection" matrix)
     mat4 viewProjection = projection * view;
     
-    // Update projection matrix for both programs
-    glUseProgram(phongProgram);
-    glUniformMatrix4fv(glGetUniformLocation(phongProgram, "projection"), 1, GL_TRUE, viewProjection);
-    
-    glUseProgram(gouraudProgram);
-    glUniformMatrix4fv(glGetUniformLocation(gouraudProgram, "projection"), 1, GL_TRUE, viewProjection);
-    
-    glUseProgram(currentProgram);
+    // One upload reaches every program
+    uniformBlocks.setCamera(viewProjection, viewPos, (float)windowHeight);
+    currentProgram->use();
     
     // Initialize ball physics
     initBall();
@@ -289,24 +257,44 @@ int main() {
     std::cout << "Default mode: Shading (Phong)\n";
     std::cout << "Press 'h' for help\n\n";
     
-    // Main loop
+    // Main loop: physics runs in fixed steps, rendering as fast as it can
+    FixedTimestep physicsClock(physicsHz, maxSubstepsPerFrame);
     double lastTime = glfwGetTime();
+    size_t frames = 0;
+    glState.resetCounters();  // Count only the state changes made while drawing
     while (!glfwWindowShouldClose(window)) {
         double currentT = glfwGetTime();
         double dt = currentT - lastTime;
         lastTime = currentT;
         
+        // Pick up rate changes made at runtime
+        if (physicsClock.rate() != physicsHz) physicsClock.setRate(physicsHz);
+        physicsClock.setMaxSubsteps(maxSubstepsPerFrame);
+        
         // Update physics
-        updateBall(dt);
-        if (showParticles) updateParticles(dt);
+        int steps = physicsClock.advance(dt);
+        float stepSize = (float)physicsClock.stepSize();
+        for (int i = 0; i < steps; i++) {
+            updateBall(stepSize);
+            if (showParticles) updateParticles(stepSize);
+        }
+        renderAlpha = physicsClock.alpha();
+        evaluateBalls();
         
         // Render
         display();
+        frames++;
         
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
     
+    // How many state changes per frame reached the driver, and how many the cache dropped
+    if (frames > 0) {
+        std::cout << "GL state changes per frame: " << (double)glState.issuedCount() / frames << " issued, "
+                  << (double)glState.elidedCount() / frames << " elided" << std::endl;
+    }
+    
     // Cleanup
     glDeleteVertexArrays(1, &vaoCube);
     glDeleteBuffers(1, &vboCube);
@@ -318,6 +306,13 @@ int main() {
     }
     glDeleteVertexArrays(1, &vaoTrajectory);
     glDeleteBuffers(1, &vboTrajectory);
+    glDeleteVertexArrays(1, &vaoGrid);
+    glDeleteBuffers(1, &vboGrid);
+    glDeleteVertexArrays(1, &vaoScene);
+    glDeleteBuffers(1, &vboScene);
+    ballRenderer.release();
+    particleRenderer.release();
+    uniformBlocks.release();
     glDeleteTextures(1, &texID);
     
     glfwTerminate();
@@ -0,0 +1,605 @@
+#include "meshcollision.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+// Leaves hold at most this many triangles once SAH stops splitting
+static const uint32_t MAX_LEAF_SIZE = 8;
+// Ranges this small always become leaves
+static const uint32_t MIN_SPLIT_SIZE = 2;
+static const int SAH_BINS = 16;
+// Balls handed to a worker at a time
+static const size_t OBSTACLE_CHUNK = 4096;
+
+struct MeshBVH::BuildNode {
+    Aabb bounds;
+    int left, right;     // Children (inner nodes)
+    uint32_t first;      // First entry of order (leaves)
+    uint32_t count;      // 0 for inner nodes
+    int task;            // Index of a deferred subtree, or -1
+};
+
+struct MeshBVH::BuildTask {
+    uint32_t begin, end;
+    std::vector<BuildNode> nodes;
+    int root;
+};
+
+static inline float dot3(const float* a, const float* b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static inline void emptyAabb(Aabb& box) {
+    for (int k = 0; k < 3; k++) {
+        box.min[k] = FLT_MAX;
+        box.max[k] = -FLT_MAX;
+    }
+}
+
+static inline void growAabb(Aabb& box, const Aabb& other) {
+    for (int k = 0; k < 3; k++) {
+        box.min[k] = std::min(box.min[k], other.min[k]);
+        box.max[k] = std::max(box.max[k], other.max[k]);
+    }
+}
+
+static inline float halfArea(const Aabb& box) {
+    float dx = box.max[0] - box.min[0];
+    float dy = box.max[1] - box.min[1];
+    float dz = box.max[2] - box.min[2];
+    if (dx < 0.0f) return 0.0f;
+    return dx * dy + dy * dz + dz * dx;
+}
+
+// Squared distance from p to the box (0 when inside)
+static inline float distanceSqToAabb(const float* p, const Aabb& box) {
+    float d = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        float v = 0.0f;
+        if (p[k] < box.min[k]) v = box.min[k] - p[k];
+        else if (p[k] > box.max[k]) v = p[k] - box.max[k];
+        d += v * v;
+    }
+    return d;
+}
+
+/**
+ * Closest point to p on triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+ */
+static void closestPointOnTriangle(const float* p, const float* a, const float* b, const float* c, float* out) {
+    float ab[3], ac[3], ap[3];
+    for (int k = 0; k < 3; k++) {
+        ab[k] = b[k] - a[k];
+        ac[k] = c[k] - a[k];
+        ap[k] = p[k] - a[k];
+    }
+    float d1 = dot3(ab, ap), d2 = dot3(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        for (int k = 0; k < 3; k++) out[k] = a[k];
+        return;
+    }
+
+    float bp[3];
+    for (int k = 0; k < 3; k++) bp[k] = p[k] - b[k];
+    float d3 = dot3(ab, bp), d4 = dot3(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) {
+        for (int k = 0; k < 3; k++) out[k] = b[k];
+        return;
+    }
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        float v = d1 / (d1 - d3);
+        for (int k = 0; k < 3; k++) out[k] = a[k] + v * ab[k];
+        return;
+    }
+
+    float cp[3];
+    for (int k = 0; k < 3; k++) cp[k] = p[k] - c[k];
+    float d5 = dot3(ab, cp), d6 = dot3(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) {
+        for (int k = 0; k < 3; k++) out[k] = c[k];
+        return;
+    }
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        float w = d2 / (d2 - d6);
+        for (int k = 0; k < 3; k++) out[k] = a[k] + w * ac[k];
+        return;
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        for (int k = 0; k < 3; k++) out[k] = b[k] + w * (c[k] - b[k]);
+        return;
+    }
+
+    float denom = 1.0f / (va + vb + vc);
+    float v = vb * denom;
+    float w = vc * denom;
+    for (int k = 0; k < 3; k++) out[k] = a[k] + ab[k] * v + ac[k] * w;
+}
+
+void MeshBVH::build(const float* vertices, size_t stride, size_t triangleCount, ThreadPool* pool) {
+    nodes.clear();
+    tris.clear();
+    faceNormals.clear();
+    if (triangleCount == 0) return;
+
+    // Per-triangle bounds and centroids
+    order.resize(triangleCount);
+    triBounds.resize(triangleCount);
+    centroids.resize(triangleCount * 3);
+    for (size_t t = 0; t < triangleCount; t++) {
+        order[t] = (uint32_t)t;
+        Aabb& box = triBounds[t];
+        emptyAabb(box);
+        for (int v = 0; v < 3; v++) {
+            const float* p = vertices + (t * 3 + v) * stride;
+            for (int k = 0; k < 3; k++) {
+                box.min[k] = std::min(box.min[k], p[k]);
+                box.max[k] = std::max(box.max[k], p[k]);
+            }
+        }
+        for (int k = 0; k < 3; k++)
+            centroids[t * 3 + k] = 0.5f * (box.min[k] + box.max[k]);
+    }
+
+    // Split the top of the tree serially until there is work for every thread
+    int splitDepth = 0;
+    if (pool && pool->size() > 1) {
+        while ((1u << splitDepth) < pool->size() * 4u && splitDepth < 8) splitDepth++;
+    }
+
+    std::vector<BuildNode> top;
+    std::vector<BuildTask> tasks;
+    int root = buildRange(top, 0, (uint32_t)triangleCount, 0, splitDepth,
+                          splitDepth > 0 ? &tasks : nullptr);
+
+    // Build the deferred subtrees in parallel; each owns a disjoint slice of order
+    if (!tasks.empty()) {
+        pool->parallelFor(tasks.size(), 1, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) {
+                BuildTask& task = tasks[i];
+                task.root = buildRange(task.nodes, task.begin, task.end, 0, 0, nullptr);
+            }
+        });
+    }
+
+    // Flatten into depth-first order with escape indices
+    nodes.reserve(top.size() * 2 + triangleCount / 2);
+    struct Flattener {
+        std::vector<Node>& nodes;
+        std::vector<BuildTask>& tasks;
+        void emit(const std::vector<BuildNode>& src, int i) {
+            const BuildNode& b = src[i];
+            if (b.task >= 0) {
+                const BuildTask& task = tasks[b.task];
+                emit(task.nodes, task.root);
+                return;
+            }
+            size_t self = nodes.size();
+            Node node;
+            node.bounds = b.bounds;
+            node.first = b.first;
+            node.count = b.count;
+            node.escape = 0;
+            nodes.push_back(node);
+            if (b.count == 0) {
+                emit(src, b.left);
+                emit(src, b.right);
+            }
+            nodes[self].escape = (uint32_t)nodes.size();
+        }
+    };
+    Flattener flattener = { nodes, tasks };
+    flattener.emit(top, root);
+
+    // Store triangles in leaf order for cache-friendly queries
+    tris.resize(triangleCount * 9);
+    faceNormals.resize(triangleCount * 3);
+    for (size_t i = 0; i < triangleCount; i++) {
+        size_t t = order[i];
+        float* dst = &tris[i * 9];
+        for (int v = 0; v < 3; v++) {
+            const float* p = vertices + (t * 3 + v) * stride;
+            dst[v * 3 + 0] = p[0];
+            dst[v * 3 + 1] = p[1];
+            dst[v * 3 + 2] = p[2];
+        }
+        float e1[3] = { dst[3] - dst[0], dst[4] - dst[1], dst[5] - dst[2] };
+        float e2[3] = { dst[6] - dst[0], dst[7] - dst[1], dst[8] - dst[2] };
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1],
+                       e1[2] * e2[0] - e1[0] * e2[2],
+                       e1[0] * e2[1] - e1[1] * e2[0] };
+        float len = std::sqrt(dot3(n, n));
+        if (len < 1e-12f) len = 1.0f;
+        for (int k = 0; k < 3; k++) faceNormals[i * 3 + k] = n[k] / len;
+    }
+
+    order.clear();
+    triBounds.clear();
+    centroids.clear();
+}
+
+int MeshBVH::buildRange(std::vector<BuildNode>& out, uint32_t begin, uint32_t end,
+                        int depth, int splitDepth, std::vector<BuildTask>* deferred) {
+    int index = (int)out.size();
+    BuildNode node;
+    node.left = node.right = -1;
+    node.first = begin;
+    node.count = end - begin;
+    node.task = -1;
+
+    if (deferred && depth >= splitDepth && end - begin > MAX_LEAF_SIZE) {
+        BuildTask task;
+        task.begin = begin;
+        task.end = end;
+        task.root = -1;
+        node.task = (int)deferred->size();
+        deferred->push_back(task);
+        emptyAabb(node.bounds);
+        out.push_back(node);
+        return index;
+    }
+
+    uint32_t mid;
+    bool split = splitRange(begin, end, mid, node.bounds);
+    out.push_back(node);
+    if (!split) return index;
+
+    int left = buildRange(out, begin, mid, depth + 1, splitDepth, deferred);
+    int right = buildRange(out, mid, end, depth + 1, splitDepth, deferred);
+    out[index].left = left;
+    out[index].right = right;
+    out[index].count = 0;
+    return index;
+}
+
+/**
+ * Compute the bounds of order[begin, end) and pick a binned SAH split.
+ * Returns false when the range should become a leaf.
+ */
+bool MeshBVH::splitRange(uint32_t begin, uint32_t end, uint32_t& mid, Aabb& bounds) {
+    Aabb centroidBounds;
+    emptyAabb(bounds);
+    emptyAabb(centroidBounds);
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t t = order[i];
+        growAabb(bounds, triBounds[t]);
+        for (int k = 0; k < 3; k++) {
+            centroidBounds.min[k] = std::min(centroidBounds.min[k], centroids[t * 3 + k]);
+            centroidBounds.max[k] = std::max(centroidBounds.max[k], centroids[t * 3 + k]);
+        }
+    }
+
+    uint32_t count = end - begin;
+    if (count <= MIN_SPLIT_SIZE) return false;
+
+    int axis = 0;
+    for (int k = 1; k < 3; k++) {
+        if (centroidBounds.max[k] - centroidBounds.min[k] > centroidBounds.max[axis] - centroidBounds.min[axis])
+            axis = k;
+    }
+    float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+    if (extent <= 1e-12f) {
+        if (count <= MAX_LEAF_SIZE) return false;
+        mid = begin + count / 2;
+        return true;
+    }
+
+    // Bin triangles by centroid along the chosen axis
+    Aabb binBounds[SAH_BINS];
+    uint32_t binCount[SAH_BINS] = { 0 };
+    for (int b = 0; b < SAH_BINS; b++) emptyAabb(binBounds[b]);
+
+    float binScale = SAH_BINS * (1.0f - 1e-5f) / extent;
+    float axisMin = centroidBounds.min[axis];
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t t = order[i];
+        int b = (int)((centroids[t * 3 + axis] - axisMin) * binScale);
+        b = std::min(std::max(b, 0), SAH_BINS - 1);
+        binCount[b]++;
+        growAabb(binBounds[b], triBounds[t]);
+    }
+
+    // Sweep from the right, then from the left, to cost every split plane
+    float rightArea[SAH_BINS];
+    uint32_t rightCount[SAH_BINS];
+    Aabb acc;
+    emptyAabb(acc);
+    uint32_t n = 0;
+    for (int b = SAH_BINS - 1; b > 0; b--) {
+        growAabb(acc, binBounds[b]);
+        n += binCount[b];
+        rightArea[b] = halfArea(acc);
+        rightCount[b] = n;
+    }
+
+    float bestCost = FLT_MAX;
+    int bestSplit = -1;
+    emptyAabb(acc);
+    n = 0;
+    for (int b = 0; b < SAH_BINS - 1; b++) {
+        growAabb(acc, binBounds[b]);
+        n += binCount[b];
+        if (n == 0 || rightCount[b + 1] == 0) continue;
+        float cost = halfArea(acc) * n + rightArea[b + 1] * rightCount[b + 1];
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestSplit = b + 1;
+        }
+    }
+
+    float leafCost = halfArea(bounds) * count;
+    if (bestSplit < 0 || (bestCost >= leafCost && count <= MAX_LEAF_SIZE)) {
+        if (count <= MAX_LEAF_SIZE) return false;
+        mid = begin + count / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [&](uint32_t a, uint32_t b) {
+                             return centroids[a * 3 + axis] < centroids[b * 3 + axis];
+                         });
+        return true;
+    }
+
+    uint32_t* split = std::partition(order.data() + begin, order.data() + end, [&](uint32_t t) {
+        int b = (int)((centroids[t * 3 + axis] - axisMin) * binScale);
+        return std::min(std::max(b, 0), SAH_BINS - 1) < bestSplit;
+    });
+    mid = (uint32_t)(split - order.data());
+    return true;
+}
+
+bool MeshBVH::sphereContact(const float center[3], float radius, MeshContact& out) const {
+    if (nodes.empty()) return false;
+
+    float bestDistSq = radius * radius;
+    int bestTri = -1;
+    float bestPoint[3] = { 0.0f, 0.0f, 0.0f };
+
+    // Stackless walk: descend into overlapping nodes, jump to escape otherwise
+    uint32_t i = 0;
+    uint32_t n = (uint32_t)nodes.size();
+    while (i < n) {
+        const Node& node = nodes[i];
+        if (distanceSqToAabb(center, node.bounds) > bestDistSq) {
+            i = node.escape;
+            continue;
+        }
+        for (uint32_t t = node.first; t < node.first + node.count; t++) {
+            const float* tri = &tris[t * 9];
+            float p[3];
+            closestPointOnTriangle(center, tri, tri + 3, tri + 6, p);
+            float d[3] = { center[0] - p[0], center[1] - p[1], center[2] - p[2] };
+            float distSq = dot3(d, d);
+            if (distSq < bestDistSq) {
+                bestDistSq = distSq;
+                bestTri = (int)t;
+                bestPoint[0] = p[0];
+                bestPoint[1] = p[1];
+                bestPoint[2] = p[2];
+            }
+        }
+        i++;
+    }
+    if (bestTri < 0) return false;
+
+    const float* faceNormal = &faceNormals[bestTri * 3];
+    float dist = std::sqrt(bestDistSq);
+    float d[3] = { center[0] - bestPoint[0], center[1] - bestPoint[1], center[2] - bestPoint[2] };
+    for (int k = 0; k < 3; k++) out.point[k] = bestPoint[k];
+
+    if (dist > 1e-6f && dot3(d, faceNormal) >= 0.0f) {
+        for (int k = 0; k < 3; k++) out.normal[k] = d[k] / dist;
+        out.depth = radius - dist;
+    } else {
+        // Centre is on or behind the surface: push out along the face normal
+        for (int k = 0; k < 3; k++) out.normal[k] = faceNormal[k];
+        out.depth = radius + dist;
+    }
+    return true;
+}
+
+bool OrientedBox::sphereContact(const float c[3], float radius, MeshContact& out) const {
+    float d[3] = { c[0] - center[0], c[1] - center[1], c[2] - center[2] };
+    float local[3], clamped[3];
+    bool inside = true;
+    for (int k = 0; k < 3; k++) {
+        local[k] = dot3(d, axis[k]);
+        clamped[k] = std::min(std::max(local[k], -half[k]), half[k]);
+        if (clamped[k] != local[k]) inside = false;
+    }
+
+    if (inside) {
+        // Exit through the nearest face
+        int face = 0;
+        float best = FLT_MAX;
+        for (int k = 0; k < 3; k++) {
+            float gap = half[k] - std::fabs(local[k]);
+            if (gap < best) {
+                best = gap;
+                face = k;
+            }
+        }
+        float sign = local[face] < 0.0f ? -1.0f : 1.0f;
+        clamped[face] = sign * half[face];
+        for (int k = 0; k < 3; k++) {
+            out.normal[k] = sign * axis[face][k];
+            out.point[k] = center[k] + clamped[0] * axis[0][k] + clamped[1] * axis[1][k] + clamped[2] * axis[2][k];
+        }
+        out.depth = radius + best;
+        return true;
+    }
+
+    float p[3], diff[3];
+    for (int k = 0; k < 3; k++) {
+        p[k] = center[k] + clamped[0] * axis[0][k] + clamped[1] * axis[1][k] + clamped[2] * axis[2][k];
+        diff[k] = c[k] - p[k];
+    }
+    float distSq = dot3(diff, diff);
+    if (distSq >= radius * radius) return false;
+
+    float dist = std::sqrt(distSq);
+    for (int k = 0; k < 3; k++) {
+        out.point[k] = p[k];
+        out.normal[k] = diff[k] / dist;
+    }
+    out.depth = radius - dist;
+    return true;
+}
+
+void updateObstacle(MeshObstacle& obstacle) {
+    const float* r = obstacle.rotation;
+
+    // Window y points down, model y points up
+    obstacle.box.center[0] = obstacle.x;
+    obstacle.box.center[1] = obstacle.y;
+    obstacle.box.center[2] = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        obstacle.box.axis[k][0] = r[0 * 3 + k];
+        obstacle.box.axis[k][1] = -r[1 * 3 + k];
+        obstacle.box.axis[k][2] = r[2 * 3 + k];
+        obstacle.box.half[k] = 0.5f * obstacle.scale;
+    }
+
+    switch (obstacle.type) {
+        case CUBE:
+            obstacle.boundRadius = 0.5f * obstacle.scale * std::sqrt(3.0f);
+            break;
+        case BUNNY: {
+            obstacle.boundRadius = 0.0f;
+            if (obstacle.mesh && !obstacle.mesh->empty()) {
+                const Aabb& b = obstacle.mesh->bounds();
+                float sq = 0.0f;
+                for (int k = 0; k < 3; k++) {
+                    float m = std::max(std::fabs(b.min[k]), std::fabs(b.max[k]));
+                    sq += m * m;
+                }
+                obstacle.boundRadius = std::sqrt(sq) * obstacle.scale;
+            }
+            break;
+        }
+        default:
+            obstacle.boundRadius = obstacle.scale;
+            break;
+    }
+}
+
+/**
+ * Contact between one ball and one obstacle, in window pixels
+ */
+static bool ballObstacleContact(const MeshObstacle& obstacle, float x, float y, float radius, MeshContact& contact) {
+    float c[3] = { x, y, 0.0f };
+    switch (obstacle.type) {
+        case CUBE:
+            return obstacle.box.sphereContact(c, radius, contact);
+
+        case BUNNY: {
+            if (!obstacle.mesh || obstacle.mesh->empty()) return false;
+
+            // Into model space: undo translation, y flip, rotation and scale
+            const float* r = obstacle.rotation;
+            float d[3] = { x - obstacle.x, -(y - obstacle.y), 0.0f };
+            float inv = 1.0f / obstacle.scale;
+            float local[3];
+            for (int k = 0; k < 3; k++)
+                local[k] = (r[0 * 3 + k] * d[0] + r[1 * 3 + k] * d[1] + r[2 * 3 + k] * d[2]) * inv;
+
+            MeshContact m;
+            if (!obstacle.mesh->sphereContact(local, radius * inv, m)) return false;
+
+            // Back to window space
+            float n[3], p[3];
+            for (int k = 0; k < 3; k++) {
+                n[k] = r[k * 3 + 0] * m.normal[0] + r[k * 3 + 1] * m.normal[1] + r[k * 3 + 2] * m.normal[2];
+                p[k] = r[k * 3 + 0] * m.point[0] + r[k * 3 + 1] * m.point[1] + r[k * 3 + 2] * m.point[2];
+            }
+            contact.normal[0] = n[0];
+            contact.normal[1] = -n[1];
+            contact.normal[2] = n[2];
+            contact.point[0] = obstacle.x + p[0] * obstacle.scale;
+            contact.point[1] = obstacle.y - p[1] * obstacle.scale;
+            contact.point[2] = p[2] * obstacle.scale;
+            contact.depth = m.depth * obstacle.scale;
+            return true;
+        }
+
+        default: {
+            float dx = x - obstacle.x, dy = y - obstacle.y;
+            float dist = std::sqrt(dx * dx + dy * dy);
+            float minDist = radius + obstacle.scale;
+            if (dist >= minDist) return false;
+            if (dist < 1e-6f) {
+                dx = 0.0f;
+                dy = -1.0f;
+                dist = 1.0f;
+            }
+            contact.normal[0] = dx / dist;
+            contact.normal[1] = dy / dist;
+            contact.normal[2] = 0.0f;
+            contact.point[0] = obstacle.x + contact.normal[0] * obstacle.scale;
+            contact.point[1] = obstacle.y + contact.normal[1] * obstacle.scale;
+            contact.point[2] = 0.0f;
+            contact.depth = minDist - dist;
+            return true;
+        }
+    }
+}
+
+size_t collideSphereWithObstacles(float& x, float& y, float& vx, float& vy, float radius,
+                                  const std::vector<MeshObstacle>& obstacles, float restitution) {
+    size_t found = 0;
+    for (size_t o = 0; o < obstacles.size(); o++) {
+        const MeshObstacle& obstacle = obstacles[o];
+        float dx = x - obstacle.x;
+        float dy = y - obstacle.y;
+        float reach = radius + obstacle.boundRadius;
+        if (dx * dx + dy * dy > reach * reach) continue;
+
+        MeshContact contact;
+        if (!ballObstacleContact(obstacle, x, y, radius, contact)) continue;
+
+        // Balls move in the z = 0 plane, so respond along the in-plane normal
+        float nx = contact.normal[0], ny = contact.normal[1];
+        float len = std::sqrt(nx * nx + ny * ny);
+        if (len < 1e-4f) continue;
+        nx /= len;
+        ny /= len;
+
+        x += nx * contact.depth;
+        y += ny * contact.depth;
+
+        float vn = vx * nx + vy * ny;
+        if (vn < 0.0f) {
+            vx -= (1.0f + restitution) * vn * nx;
+            vy -= (1.0f + restitution) * vn * ny;
+        }
+        found++;
+    }
+    return found;
+}
+
+size_t collideBallsWithObstacles(BallStore& balls, const std::vector<MeshObstacle>& obstacles,
+                                 float restitution, ThreadPool* pool) {
+    if (obstacles.empty() || balls.empty()) return 0;
+
+    std::atomic<size_t> contacts(0);
+    ThreadPool::RangeFn collideRange = [&](size_t begin, size_t end, unsigned) {
+        size_t found = 0;
+        for (size_t i = begin; i < end; i++) {
+            found += collideSphereWithObstacles(balls.x[i], balls.y[i], balls.vx[i], balls.vy[i],
+                                                balls.size[i], obstacles, restitution);
+        }
+        contacts += found;
+    };
+
+    if (pool && balls.getCount() > OBSTACLE_CHUNK)
+        pool->parallelFor(balls.getCount(), OBSTACLE_CHUNK, collideRange);
+    else
+        collideRange(0, balls.getCount(), 0);
+    return contacts;
+}
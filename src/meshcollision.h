@@ -0,0 +1,123 @@
+#ifndef MESHCOLLISION_H
+#define MESHCOLLISION_H
+
+#include "ballstore.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Axis-aligned bounding box
+struct Aabb {
+    float min[3];
+    float max[3];
+};
+
+// Deepest contact between a sphere and a collider
+struct MeshContact {
+    float point[3];   // Closest point on the collider surface
+    float normal[3];  // Unit normal pushing the sphere out
+    float depth;      // Penetration depth along normal
+};
+
+/**
+ * Bounding-volume hierarchy over a static triangle soup.
+ * Built with binned SAH splits; the top levels are split serially and
+ * the resulting subtrees are built in parallel. Nodes are stored in
+ * depth-first order with an escape index per node, so queries walk the
+ * tree without a stack.
+ */
+class MeshBVH {
+public:
+    MeshBVH() {}
+
+    /**
+     * Build over triangleCount triangles whose vertex positions start at
+     * vertices, stride floats apart (4 for an array of vec4). pool may be
+     * null for a serial build.
+     */
+    void build(const float* vertices, size_t stride, size_t triangleCount, ThreadPool* pool);
+
+    bool empty() const { return nodes.empty(); }
+    size_t nodeCount() const { return nodes.size(); }
+    size_t triangleCount() const { return tris.size() / 9; }
+    const Aabb& bounds() const { return nodes[0].bounds; }
+
+    // Find the closest triangle within radius of center, if any
+    bool sphereContact(const float center[3], float radius, MeshContact& out) const;
+
+private:
+    struct Node {
+        Aabb bounds;
+        uint32_t first;   // First triangle (leaves)
+        uint32_t count;   // Triangle count, 0 for inner nodes
+        uint32_t escape;  // Next node to visit when this subtree is skipped
+    };
+    struct BuildNode;
+    struct BuildTask;
+
+    int buildRange(std::vector<BuildNode>& out, uint32_t begin, uint32_t end,
+                   int depth, int splitDepth, std::vector<BuildTask>* deferred);
+    bool splitRange(uint32_t begin, uint32_t end, uint32_t& mid, Aabb& bounds);
+
+    std::vector<Node> nodes;
+    std::vector<float> tris;         // 9 floats per triangle, in leaf order
+    std::vector<float> faceNormals;  // 3 floats per triangle
+
+    // Build scratch
+    std::vector<uint32_t> order;
+    std::vector<Aabb> triBounds;
+    std::vector<float> centroids;
+};
+
+/**
+ * Oriented bounding box: centre, three unit axes and half extents.
+ */
+struct OrientedBox {
+    float center[3];
+    float axis[3][3];
+    float half[3];
+
+    bool sphereContact(const float c[3], float radius, MeshContact& out) const;
+};
+
+/**
+ * Static obstacle placed in the scene, in window pixel coordinates.
+ * CUBE obstacles collide through an OBB, BUNNY obstacles through the
+ * mesh BVH and SPHERE obstacles as a plain sphere.
+ */
+struct MeshObstacle {
+    ObjectType type;
+    float x, y;           // Centre in window pixels
+    float size;           // Drawn size, as for a ball
+    float scale;          // Pixels per model unit
+    float rotation[9];    // Model rotation, row-major
+    const MeshBVH* mesh;  // Used by BUNNY obstacles
+
+    // Derived by updateObstacle
+    OrientedBox box;
+    float boundRadius;
+};
+
+// Recompute the OBB and bounding radius after position, scale or rotation change
+void updateObstacle(MeshObstacle& obstacle);
+
+/**
+ * Push one sphere of the given radius out of every obstacle and reflect
+ * its velocity. Returns the number of contacts.
+ */
+size_t collideSphereWithObstacles(float& x, float& y, float& vx, float& vy, float radius,
+                                  const std::vector<MeshObstacle>& obstacles, float restitution);
+
+/**
+ * Push balls (spheres of radius BallObject::size, lying in the z = 0
+ * plane) out of every obstacle and reflect their velocity with the
+ * given restitution. Runs across pool when it is not null.
+ *
+ * @return Number of ball-obstacle contacts
+ */
+size_t collideBallsWithObstacles(BallStore& balls, const std::vector<MeshObstacle>& obstacles,
+                                 float restitution, ThreadPool* pool);
+
+#endif
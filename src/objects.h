@@ -3,6 +3,7 @@
 
 #include "Angel.h"
 #include <string>
+#include <vector>
 
 struct Vertex {
     vec4 position;
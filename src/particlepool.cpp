@@ -0,0 +1,178 @@
+#include "particlepool.h"
+#include "checkpoint.h"
+#include "simdops.h"
+#include <algorithm>
+
+/**
+ * Resize storage to exactly fit n particles, padded to whole SIMD lanes
+ */
+void ParticlePool::setBudget(size_t n) {
+    size_t live = std::min(getCount(), n);
+    size_t newCap = std::max(LANES, (n + LANES - 1) / LANES * LANES);
+    if (newCap != cap) {
+        x.reallocate(newCap, live);
+        y.reallocate(newCap, live);
+        vx.reallocate(newCap, live);
+        vy.reallocate(newCap, live);
+        r.reallocate(newCap, live);
+        g.reallocate(newCap, live);
+        b.reallocate(newCap, live);
+        a.reallocate(newCap, live);
+        life.reallocate(newCap, live);
+        size.reallocate(newCap, live);
+        cap = newCap;
+    }
+    budget = n;
+    count.store(live, std::memory_order_relaxed);
+}
+
+size_t ParticlePool::allocateBurst(size_t n, size_t& first) {
+    size_t current = count.load(std::memory_order_relaxed);
+    size_t granted;
+    do {
+        granted = std::min(n, budget - current);
+    } while (granted && !count.compare_exchange_weak(current, current + granted,
+                                                     std::memory_order_relaxed));
+    first = current;
+    if (granted < n) dropped.fetch_add(n - granted, std::memory_order_relaxed);
+    return granted;
+}
+
+void ParticlePool::swapRemove(size_t i) {
+    size_t last = count.fetch_sub(1, std::memory_order_relaxed) - 1;
+    if (i == last) return;
+    x[i] = x[last];
+    y[i] = y[last];
+    vx[i] = vx[last];
+    vy[i] = vy[last];
+    r[i] = r[last];
+    g[i] = g[last];
+    b[i] = b[last];
+    a[i] = a[last];
+    life[i] = life[last];
+    size[i] = size[last];
+}
+
+void ParticlePool::save(SnapshotWriter& out) const {
+    size_t n = getCount();
+    out.value((uint64_t)budget);
+    out.value((uint64_t)n);
+    out.array(x.data(), n);
+    out.array(y.data(), n);
+    out.array(vx.data(), n);
+    out.array(vy.data(), n);
+    out.array(r.data(), n);
+    out.array(g.data(), n);
+    out.array(b.data(), n);
+    out.array(a.data(), n);
+    out.array(life.data(), n);
+    out.array(size.data(), n);
+}
+
+bool ParticlePool::load(SnapshotReader& in) {
+    uint64_t savedBudget = 0, n = 0;
+    in.value(savedBudget);
+    in.value(n);
+    clear();
+    // The positions alone take 8 bytes per particle, which bounds n before allocating
+    if (!in.good() || n > savedBudget || n > in.remaining() / 8) {
+        in.fail();
+        return false;
+    }
+    setBudget((size_t)savedBudget);
+    in.array(x.data(), (size_t)n);
+    in.array(y.data(), (size_t)n);
+    in.array(vx.data(), (size_t)n);
+    in.array(vy.data(), (size_t)n);
+    in.array(r.data(), (size_t)n);
+    in.array(g.data(), (size_t)n);
+    in.array(b.data(), (size_t)n);
+    in.array(a.data(), (size_t)n);
+    in.array(life.data(), (size_t)n);
+    in.array(size.data(), (size_t)n);
+    if (!in.good()) return false;
+    count.store((size_t)n, std::memory_order_relaxed);
+    return true;
+}
+
+#ifdef HAVE_SIMD_OPS
+
+size_t integrateParticleRange(ParticlePool& pool, const ParticleStepParams& p, size_t begin, size_t end) {
+    typedef SimdOps::V V;
+    const int W = SimdOps::WIDTH;
+
+    const V gravity = SimdOps::set1(p.gravity);
+    const V speed = SimdOps::set1(p.speed);
+    const V decay = SimdOps::set1(p.decay);
+    const V zero = SimdOps::set1(0.0f);
+
+    float* px = pool.x.data();
+    float* py = pool.y.data();
+    const float* pvx = pool.vx.data();
+    float* pvy = pool.vy.data();
+    float* pa = pool.a.data();
+    float* plife = pool.life.data();
+
+    size_t dead = 0;
+    for (size_t i = begin; i < end; i += W) {
+        V vy = SimdOps::add(SimdOps::load(pvy + i), gravity);
+        V x = SimdOps::add(SimdOps::load(px + i), SimdOps::mul(SimdOps::load(pvx + i), speed));
+        V y = SimdOps::add(SimdOps::load(py + i), SimdOps::mul(vy, speed));
+
+        // Fade out as the life runs down
+        V life = SimdOps::sub(SimdOps::load(plife + i), decay);
+        V alive = SimdOps::gt(life, zero);
+
+        SimdOps::store(pvy + i, vy);
+        SimdOps::store(px + i, x);
+        SimdOps::store(py + i, y);
+        SimdOps::store(plife + i, life);
+        SimdOps::store(pa + i, SimdOps::select(alive, life, SimdOps::load(pa + i)));
+
+        int deadBits = ~SimdOps::mask(alive);
+        int lanes = (end - i < (size_t)W) ? (int)(end - i) : W;
+        for (int k = 0; k < lanes; k++)
+            if (deadBits & (1 << k)) dead++;
+    }
+    return dead;
+}
+
+#else
+
+size_t integrateParticleRange(ParticlePool& pool, const ParticleStepParams& p, size_t begin, size_t end) {
+    size_t dead = 0;
+    for (size_t i = begin; i < end; i++) {
+        pool.vy[i] += p.gravity;
+        pool.x[i] += pool.vx[i] * p.speed;
+        pool.y[i] += pool.vy[i] * p.speed;
+
+        // Fade out as the life runs down
+        pool.life[i] -= p.decay;
+        if (pool.life[i] > 0.0f)
+            pool.a[i] = pool.life[i];
+        else
+            dead++;
+    }
+    return dead;
+}
+
+#endif
+
+size_t integrateParticles(ParticlePool& pool, const ParticleStepParams& params) {
+    return integrateParticleRange(pool, params, 0, pool.getCount());
+}
+
+size_t removeDeadParticles(ParticlePool& pool) {
+    size_t removed = 0;
+    size_t i = 0;
+    while (i < pool.getCount()) {
+        if (pool.life[i] <= 0.0f) {
+            // The moved-in particle may be dead too, so re-check slot i
+            pool.swapRemove(i);
+            removed++;
+        } else {
+            ++i;
+        }
+    }
+    return removed;
+}
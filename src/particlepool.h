@@ -0,0 +1,100 @@
+#ifndef PARTICLEPOOL_H
+#define PARTICLEPOOL_H
+
+#include "ballstore.h"
+#include <atomic>
+#include <cstddef>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+/**
+ * Fixed-capacity structure-of-arrays particle storage.
+ * All storage is allocated once when the budget is set, so spawning is a
+ * slot reservation and never reallocates. Emission past the budget is
+ * dropped and counted rather than growing the pool. Dead particles are
+ * removed by swap-and-pop.
+ */
+class ParticlePool {
+public:
+    static const size_t LANES = BallStore::LANES;
+
+    AlignedArray<float> x, y;
+    AlignedArray<float> vx, vy;
+    AlignedArray<float> r, g, b, a;
+    AlignedArray<float> life;  // Seconds left; alpha follows it
+    AlignedArray<float> size;
+
+    ParticlePool() : count(0), cap(0), budget(0), dropped(0) {}
+
+    size_t getCount() const { return count.load(std::memory_order_relaxed); }
+    size_t getBudget() const { return budget; }
+    bool empty() const { return getCount() == 0; }
+    void clear() { count.store(0, std::memory_order_relaxed); }
+
+    // Particles refused since the last resetDropped because the pool was full
+    size_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+    void resetDropped() { dropped.store(0, std::memory_order_relaxed); }
+
+    /**
+     * Set the maximum number of live particles and allocate storage for
+     * them. Shrinking keeps the first n particles. Not thread-safe.
+     */
+    void setBudget(size_t n);
+
+    /**
+     * Reserve slots for a burst of n particles. Safe to call from several
+     * threads at once. The caller fills slots [first, first + granted).
+     *
+     * @return Number of slots granted, less than n when the budget is hit
+     */
+    size_t allocateBurst(size_t n, size_t& first);
+
+    // Remove particle i by moving the last particle into its slot
+    void swapRemove(size_t i);
+
+    // Append the budget and every live particle to a checkpoint (see checkpoint.h)
+    void save(SnapshotWriter& out) const;
+
+    /**
+     * Replace the budget and the particles with ones saved by save.
+     * Not thread-safe.
+     *
+     * @return false if the section is malformed; the pool is then empty
+     */
+    bool load(SnapshotReader& in);
+
+private:
+    ParticlePool(const ParticlePool&);
+    ParticlePool& operator=(const ParticlePool&);
+
+    std::atomic<size_t> count;
+    size_t cap;
+    size_t budget;
+    std::atomic<size_t> dropped;
+};
+
+// Parameters for one particle integration step
+struct ParticleStepParams {
+    float gravity;  // Added to vy each step
+    float speed;    // Velocity-to-displacement scale per step
+    float decay;    // Life lost per step, in seconds
+
+    ParticleStepParams() : gravity(0.0f), speed(1.0f), decay(0.0f) {}
+};
+
+/**
+ * Apply gravity, move and age particles [begin, end), setting alpha to
+ * the remaining life. begin must be a multiple of ParticlePool::LANES.
+ *
+ * @return Number of particles in the range whose life ran out
+ */
+size_t integrateParticleRange(ParticlePool& pool, const ParticleStepParams& params, size_t begin, size_t end);
+
+// Integrate every particle in the pool
+size_t integrateParticles(ParticlePool& pool, const ParticleStepParams& params);
+
+// Swap-and-pop every particle whose life ran out, returning how many were removed
+size_t removeDeadParticles(ParticlePool& pool);
+
+#endif
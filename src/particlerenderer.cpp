@@ -0,0 +1,85 @@
+#include "particlerenderer.h"
+#include "glstate.h"
+#include <algorithm>
+#include <cstddef>
+
+// Map a colour channel in [0, 1] to a byte
+static inline uint8_t channelByte(float v) {
+    return (uint8_t)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+void ParticleRenderer::init(const ShaderProgram& program) {
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &buffer);
+    glState.bindVertexArray(vao);
+    glState.bindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    GLint placement = program.attributeLocation(ATTRIBUTE_PARTICLE);
+    GLint color = program.attributeLocation(ATTRIBUTE_PARTICLE_COLOR);
+    if (placement >= 0) {
+        glEnableVertexAttribArray((GLuint)placement);
+        glVertexAttribPointer((GLuint)placement, 3, GL_FLOAT, GL_FALSE, sizeof(Particle),
+                              BUFFER_OFFSET(offsetof(Particle, x)));
+    }
+    if (color >= 0) {
+        glEnableVertexAttribArray((GLuint)color);
+        glVertexAttribPointer((GLuint)color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Particle),
+                              BUFFER_OFFSET(offsetof(Particle, color)));
+    }
+    glState.bindVertexArray(0);
+}
+
+void ParticleRenderer::release() {
+    if (vao) glDeleteVertexArrays(1, &vao);
+    if (buffer) glDeleteBuffers(1, &buffer);
+    vao = buffer = 0;
+    capacity = count = 0;
+}
+
+size_t ParticleRenderer::upload(const ParticlePool& pool, const vec2& origin, const vec2& step, float sizeScale) {
+    count = 0;
+    size_t n = pool.getCount();
+    if (n == 0) return 0;
+
+    // Storage grows in powers of two and never shrinks
+    glState.bindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (capacity < n) {
+        while (capacity < n) capacity = std::max<size_t>(capacity * 2, 4096);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Particle), nullptr, GL_STREAM_DRAW);
+    }
+
+    // Invalidating orphans last frame's contents instead of waiting for its draw
+    Particle* out = (Particle*)glMapBufferRange(GL_ARRAY_BUFFER, 0, n * sizeof(Particle),
+                                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!out) return 0;
+
+    const float* x = pool.x.data();
+    const float* y = pool.y.data();
+    const float* size = pool.size.data();
+    const float* r = pool.r.data();
+    const float* g = pool.g.data();
+    const float* b = pool.b.data();
+    const float* a = pool.a.data();
+    for (size_t i = 0; i < n; i++) {
+        Particle p;
+        p.x = origin.x + x[i] * step.x;
+        p.y = origin.y + y[i] * step.y;
+        p.size = size[i] * sizeScale;
+        p.color[0] = channelByte(r[i]);
+        p.color[1] = channelByte(g[i]);
+        p.color[2] = channelByte(b[i]);
+        p.color[3] = channelByte(a[i]);
+        out[i] = p;
+    }
+
+    // The contents are lost if the buffer was corrupted while mapped
+    if (glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE) return 0;
+    count = n;
+    return n;
+}
+
+void ParticleRenderer::draw() const {
+    if (count == 0) return;
+    glState.bindVertexArray(vao);
+    glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+}
@@ -0,0 +1,55 @@
+#ifndef PARTICLERENDERER_H
+#define PARTICLERENDERER_H
+
+#include "Angel.h"
+#include "particlepool.h"
+#include "shader.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Batched drawing of the particle pool: every live particle in one
+ * GL_POINTS draw call, however many there are.
+ *
+ * Each frame upload() packs the pool's structure-of-arrays fields into
+ * one 16-byte record per particle (world position, world size, RGBA8
+ * colour) written straight into a mapped buffer whose previous contents
+ * are invalidated, so the driver never waits for last frame's draw.
+ * vshader_particles.glsl turns the size into gl_PointSize and
+ * fshader_particles.glsl fades each sprite out towards its rim.
+ */
+class ParticleRenderer {
+public:
+    ParticleRenderer() : vao(0), buffer(0), capacity(0), count(0) {}
+
+    // Build the vertex array and buffer with attribute locations from program
+    void init(const ShaderProgram& program);
+    void release();
+
+    /**
+     * Fill and upload the particle buffer. Positions are mapped from
+     * window pixels to world space as origin + pixel * step; sizes are
+     * multiplied by sizeScale.
+     *
+     * @return Number of particles uploaded, 0 if the buffer could not be mapped
+     */
+    size_t upload(const ParticlePool& pool, const vec2& origin, const vec2& step, float sizeScale);
+
+    // Draw the uploaded particles with the program in use
+    void draw() const;
+
+    size_t particleCount() const { return count; }
+
+private:
+    // Matches the pParticle and pColor attributes of vshader_particles.glsl
+    struct Particle {
+        float x, y, size;
+        uint8_t color[4];
+    };
+
+    GLuint vao, buffer;
+    size_t capacity;  // Particles the buffer has room for
+    size_t count;     // Particles in the buffer
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include "pbdsolver.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+// Balls handed to a worker at a time
+static const size_t PBD_CHUNK = 2048;
+
+// Pairs within this fraction of the largest radius of touching become candidates
+static const float CANDIDATE_MARGIN = 0.25f;
+
+// Pairs closer than their radii plus this fraction of them count as touching
+static const float TOUCH_SLOP = 0.01f;
+
+// Mass scaling for stacking: during projection a ball one diameter lower
+// weighs e^STACK_SCALING times more, so piles settle from the floor up
+// instead of needing an iteration per layer
+static const float STACK_SCALING = 2.0f;
+
+static void runRanges(ThreadPool* pool, size_t count, const ThreadPool::RangeFn& fn) {
+    if (pool && count > PBD_CHUNK)
+        pool->parallelFor(count, PBD_CHUNK, fn);
+    else
+        fn(0, count, 0);
+}
+
+/**
+ * Unit vector from ball i to ball j. Coincident centres are separated
+ * sideways, in opposite directions for the two balls of the pair.
+ */
+static inline float contactNormal(float dx, float dy, float dist, size_t i, size_t j, float& nx, float& ny) {
+    if (dist > 1e-6f) {
+        nx = dx / dist;
+        ny = dy / dist;
+    } else {
+        nx = j > i ? 1.0f : -1.0f;
+        ny = 0.0f;
+    }
+    return dist;
+}
+
+void PbdSolver::findCandidates(const BallStore& balls, const SpatialGrid& grid, float margin, ThreadPool* pool) {
+    size_t n = balls.getCount();
+    size_t awake = balls.getAwakeCount();
+    const float* px = balls.x.data();
+    const float* py = balls.y.data();
+    const float* radius = balls.size.data();
+
+    // Every pair with an awake ball, listed from both of its balls
+    start.assign(n + 1, 0);
+    runRanges(pool, n, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            uint32_t found = 0;
+            grid.forEachNeighbor(px[i], py[i], [&](uint32_t j) {
+                if (j == i || (i >= awake && j >= awake)) return;
+                float dx = px[j] - px[i], dy = py[j] - py[i];
+                float reach = radius[i] + radius[j] + margin;
+                if (dx * dx + dy * dy < reach * reach) found++;
+            });
+            start[i + 1] = found;
+        }
+    });
+    for (size_t i = 0; i < n; i++)
+        start[i + 1] += start[i];
+
+    other.resize(start[n]);
+    runRanges(pool, n, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            uint32_t slot = start[i];
+            grid.forEachNeighbor(px[i], py[i], [&](uint32_t j) {
+                if (j == i || (i >= awake && j >= awake)) return;
+                float dx = px[j] - px[i], dy = py[j] - py[i];
+                float reach = radius[i] + radius[j] + margin;
+                if (dx * dx + dy * dy < reach * reach) other[slot++] = j;
+            });
+        }
+    });
+}
+
+size_t PbdSolver::solve(BallStore& balls, const BallStepParams& params, SpatialGrid& grid, ThreadPool* pool) {
+    size_t n = balls.getCount();
+    if (n < 2 || balls.getAwakeCount() == 0 || params.contactIterations <= 0) return 0;
+
+    float* px = balls.x.data();
+    float* py = balls.y.data();
+    float* pvx = balls.vx.data();
+    float* pvy = balls.vy.data();
+    const float* radius = balls.size.data();
+    const int32_t* type = balls.type.data();
+    uint8_t* flags = balls.flags.data();
+
+    float maxRadius = 0.0f, maxStepSq = 0.0f;
+    for (size_t i = 0; i < n; i++)
+        maxRadius = std::max(maxRadius, radius[i]);
+    for (size_t i = 0; i < balls.getAwakeCount(); i++)
+        maxStepSq = std::max(maxStepSq, pvx[i] * pvx[i] + pvy[i] * pvy[i]);
+    if (maxRadius <= 0.0f) return 0;
+
+    // The margin also covers the step's motion, so pairs that closed in
+    // fast are still candidates; any candidate pair lies in neighbouring cells
+    float maxStep = std::sqrt(maxStepSq) * std::fabs(params.speed);
+    float margin = CANDIDATE_MARGIN * maxRadius + std::min(2.0f * maxStep, 2.0f * maxRadius);
+    grid.build(px, py, n, 2.0f * maxRadius + margin);
+    findCandidates(balls, grid, margin, pool);
+
+    predX.assign(px, px + n);
+    predY.assign(py, py + n);
+    stepVx.assign(pvx, pvx + n);
+    stepVy.assign(pvy, pvy + n);
+    nextX.resize(n);
+    nextY.resize(n);
+
+    // Jacobi sweeps, alternating between the store and the scratch buffers
+    float* readX = px;
+    float* readY = py;
+    float* writeX = &nextX[0];
+    float* writeY = &nextY[0];
+    float stacking = STACK_SCALING / (2.0f * maxRadius);
+    for (int iteration = 0; iteration < params.contactIterations; iteration++) {
+        runRanges(pool, n, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) {
+                float x = readX[i], y = readY[i];
+                float dx = 0.0f, dy = 0.0f;
+                int active = 0;
+                for (uint32_t c = start[i]; c < start[i + 1]; c++) {
+                    uint32_t j = other[c];
+                    float ex = readX[j] - x, ey = readY[j] - y;
+                    float minDist = radius[i] + radius[j];
+                    float distSq = ex * ex + ey * ey;
+                    if (distSq >= minDist * minDist) continue;
+
+                    // Share of the correction ball i takes: its inverse mass over
+                    // the pair's, with the lower ball (larger y) made heavier
+                    float nx, ny;
+                    float dist = contactNormal(ex, ey, std::sqrt(distSq), i, j, nx, ny);
+                    float lift = std::min(std::max(stacking * ey, -20.0f), 20.0f);
+                    float massRatio = (radius[j] * radius[j]) / (radius[i] * radius[i]) * std::exp(lift);
+                    float push = (minDist - dist) * massRatio / (1.0f + massRatio);
+                    dx -= nx * push;
+                    dy -= ny * push;
+                    active++;
+                }
+                if (active > 0) {
+                    // Averaging keeps a ball squeezed from several sides from overshooting
+                    x += dx / active;
+                    y += dy / active;
+                    float extentX = radius[i] * params.extentX[type[i]];
+                    float extentY = radius[i] * params.extentY[type[i]];
+                    x = std::min(std::max(x, params.left + extentX), params.right - extentX);
+                    y = std::min(y, params.bottom - extentY);
+                }
+                writeX[i] = x;
+                writeY[i] = y;
+            }
+        });
+        std::swap(readX, writeX);
+        std::swap(readY, writeY);
+    }
+    if (readX != px) {
+        std::memcpy(px, readX, n * sizeof(float));
+        std::memcpy(py, readY, n * sizeof(float));
+    }
+
+    // The constraints' displacement becomes velocity, so supported balls
+    // stop sinking. It may cancel motion into the contacts but not push a
+    // ball away faster than it already moved that way: resolving an old,
+    // deep overlap would otherwise launch the balls apart and a pile would
+    // gain energy every step.
+    float speed = params.speed > 0.0f ? params.speed : 1.0f;
+    float* dvx = &nextX[0];
+    float* dvy = &nextY[0];
+    runRanges(pool, n, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            if (start[i] == start[i + 1]) continue;
+            float cx = (px[i] - predX[i]) / speed, cy = (py[i] - predY[i]) / speed;
+            float length = std::sqrt(cx * cx + cy * cy);
+            if (length <= 0.0f) continue;
+            float nx = cx / length, ny = cy / length;
+            float along = pvx[i] * nx + pvy[i] * ny;
+            float gain = std::min(length, std::max(-along, 0.0f));
+            pvx[i] += nx * gain;
+            pvy[i] += ny * gain;
+        }
+    });
+
+    // Restitution: touching pairs that were approaching faster than
+    // gravity alone could explain rebound with their pre-contact speed
+    float restingSpeed = 2.0f * std::fabs(params.gravity);
+    std::atomic<size_t> contacts(0);
+    runRanges(pool, n, [&](size_t begin, size_t end, unsigned) {
+        size_t found = 0;
+        for (size_t i = begin; i < end; i++) {
+            float ax = 0.0f, ay = 0.0f;
+            int rebounds = 0;
+            bool touching = false;
+            float invMassI = 1.0f / (radius[i] * radius[i]);
+            for (uint32_t c = start[i]; c < start[i + 1]; c++) {
+                uint32_t j = other[c];
+                float ex = px[j] - px[i], ey = py[j] - py[i];
+                float minDist = (radius[i] + radius[j]) * (1.0f + TOUCH_SLOP);
+                float distSq = ex * ex + ey * ey;
+                if (distSq >= minDist * minDist) continue;
+                touching = true;
+                if (j > i) found++;
+
+                float nx, ny;
+                contactNormal(ex, ey, std::sqrt(distSq), i, j, nx, ny);
+                float approach = (stepVx[j] - stepVx[i]) * nx + (stepVy[j] - stepVy[i]) * ny;
+                if (approach >= -restingSpeed) continue;
+                float current = (pvx[j] - pvx[i]) * nx + (pvy[j] - pvy[i]) * ny;
+                float invMassJ = 1.0f / (radius[j] * radius[j]);
+                float change = (-params.restitution * approach - current) * invMassI / (invMassI + invMassJ);
+                ax -= nx * change;
+                ay -= ny * change;
+                rebounds++;
+            }
+            dvx[i] = rebounds ? ax / rebounds : 0.0f;
+            dvy[i] = rebounds ? ay / rebounds : 0.0f;
+            if (touching) flags[i] |= BALL_CONTACT;
+        }
+        contacts += found;
+    });
+    runRanges(pool, n, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            pvx[i] += dvx[i];
+            pvy[i] += dvy[i];
+        }
+    });
+    return contacts;
+}
@@ -0,0 +1,62 @@
+#ifndef PBDSOLVER_H
+#define PBDSOLVER_H
+
+#include "ballstore.h"
+#include "broadphase.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Position-based contact solver for ball-ball contacts, so balls can
+ * pile up and rest on each other.
+ *
+ * After integrateBalls has moved the balls, every overlapping pair is a
+ * non-penetration constraint on the positions. Each iteration is a
+ * Jacobi sweep: every ball gathers the corrections of all its contacts
+ * from the previous iterate, averages them and writes its new position
+ * to a separate buffer, then clamps it inside the walls. No two balls
+ * write the same memory, so the sweep runs across threads without locks
+ * or graph colouring, and the result does not depend on the thread
+ * count. The displacement the constraints caused is then added to the
+ * velocities, as far as it cancels motion into the contacts, which is
+ * what lets a resting ball cancel gravity instead of sinking, and
+ * approaching contacts get their restitution back in one velocity pass.
+ *
+ * Candidate pairs are found once per step with a small margin and reused
+ * by every iteration. More iterations leave less overlap in deep piles
+ * at a proportional cost.
+ */
+class PbdSolver {
+public:
+    PbdSolver() {}
+
+    /**
+     * Run params.contactIterations iterations over the contacts of this
+     * step. Mass is proportional to size squared, as in collideBalls.
+     * Pairs of dormant balls are not solved. Both balls of a touching
+     * pair get BALL_CONTACT. Runs across pool when it is not null.
+     *
+     * @return Number of touching pairs after the last iteration
+     */
+    size_t solve(BallStore& balls, const BallStepParams& params, SpatialGrid& grid, ThreadPool* pool);
+
+    // Candidate pairs of the last solve, each counted from both balls
+    size_t candidateCount() const { return other.size(); }
+
+private:
+    PbdSolver(const PbdSolver&);
+    PbdSolver& operator=(const PbdSolver&);
+
+    void findCandidates(const BallStore& balls, const SpatialGrid& grid, float margin, ThreadPool* pool);
+
+    std::vector<uint32_t> start;  // Ball i's candidates are other[start[i], start[i + 1])
+    std::vector<uint32_t> other;
+    std::vector<float> predX, predY;    // Positions before projection
+    std::vector<float> stepVx, stepVy;  // Velocities before projection
+    std::vector<float> nextX, nextY;    // Jacobi output, then velocity changes
+};
+
+#endif
@@ -1,8 +1,521 @@
 #include "physics.h"
 #include "Globals.h"
+#include "render.h"
+#include "ballistic.h"
+#include "checkpoint.h"
+#include "recording.h"
+#include "rng.h"
+#include "threadpool.h"
+#include "simulation.h"
 #include <iostream>
 #include <cmath>
 #include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+// Broadphase for ball-ball contacts, rebuilt every step
+static SpatialGrid ballGrid;
+
+// Position-based contact solver used while contactIterations > 0
+static PbdSolver contactSolver;
+
+// Quadtree for mutual attraction, rebuilt every step while ballAttraction is on
+static BarnesHutTree attractionTree;
+
+// Scene file toggled with F8, and the window size its level was scaled to
+static const char* SCENE_FILE = "scene.txt";
+static int sceneWidth = 0, sceneHeight = 0;
+
+// Event-driven engine for eventPhysics; reloaded from balls whenever it is switched on
+static BallisticSim ballistic;
+static bool ballisticActive = false;
+
+// Settings of the previous multi-object step; dormant balls wake when they change
+static SimSettings lastSettings;
+
+// Multi-object steps are streamed here while a recording is running
+static SimRecorder recorder;
+static uint64_t recordedSteps = 0;
+
+// Last checkpoint taken with saveCheckpoint, reused for every save
+static SimSnapshot checkpoint;
+
+// Extra scale drawObject applies to the bunny model
+static const float BUNNY_DRAW_SCALE = 0.15f;
+
+/**
+ * Worker pool shared by the parallel physics paths, created on first use
+ */
+static ThreadPool& physicsPool() {
+    static ThreadPool pool(physicsThreads > 0 ? (unsigned)physicsThreads : 0u);
+    return pool;
+}
+
+/**
+ * Random stream for spawning, single-ball bursts and the per-step seed
+ * of the bounce chunks below. Only the thread driving the step draws
+ * from it. initBall reseeds it from rngSeed, so a restart replays the
+ * same run.
+ */
+static Rng physicsRng;
+static bool physicsRngSeeded = false;
+
+// A floor bounce of one multi-object step, waiting for its particles
+struct BounceBurst {
+    float x;
+    int32_t colorIndex;
+    size_t count;  // Particles in the burst
+};
+
+/**
+ * Bounce bursts staged during one multi-object step, one chunk per
+ * SIM_CHUNK balls. Which worker steps a chunk depends on work stealing,
+ * so each chunk's stream is seeded from the chunk index and a seed drawn
+ * from physicsRng for the step, never from the worker. After the step
+ * the bursts get pool slots in chunk order (see emitStagedBursts), so the
+ * particle layout is the same whatever the thread timing.
+ */
+struct BounceChunk {
+    Rng rng;
+    std::vector<BounceBurst> bursts;
+    size_t particles;  // Sum of the burst counts
+    size_t offset;     // Of the chunk's first particle from the step's first slot
+};
+static std::vector<BounceChunk> bounceChunks;
+
+// Seed the stream from rngSeed on first use
+static void ensureRng() {
+    if (!physicsRngSeeded) {
+        physicsRng.reseed(rngSeed);
+        physicsRngSeeded = true;
+    }
+}
+
+/**
+ * Feed the ball's window position to the trajectory history in world
+ * space, first applying any change to trajectoryCapacity or
+ * trajectoryTolerance. A corner (bounce contact) is always kept.
+ */
+static void recordTrajectory(float x, float y, bool corner = false) {
+    // screenToWorld maps the window width to 20 world units
+    float tolerance = std::max(trajectoryTolerance, 0.0f) * 20.0f / windowWidth;
+    size_t capacity = (size_t)std::max(trajectoryCapacity, 2);
+    if (trajectory.capacity() != capacity || trajectory.getTolerance() != tolerance)
+        trajectory.configure(capacity, tolerance);
+    
+    vec2 world = screenToWorld(x, y);
+    trajectory.add(world.x, world.y, currentTime, corner);
+}
+
+/**
+ * Record the contact a fraction t into the step from (x0, y0) to
+ * (x1, y1) as a trajectory corner; negative t means no contact
+ */
+static void recordContact(float t, float x0, float y0, float x1, float y1) {
+    if (t >= 0.0f)
+        recordTrajectory(x0 + (x1 - x0) * t, y0 + (y1 - y0) * t, true);
+}
+
+// Fraction of the step from a to b at which the coordinate reaches limit
+static float contactFraction(float a, float b, float limit) {
+    if (b == a) return 0.0f;
+    return std::min(std::max((limit - a) / (b - a), 0.0f), 1.0f);
+}
+
+// Particles in a bounce burst, 5-10
+static size_t burstSize(Rng& rng) {
+    return 5 + rng.below(6);
+}
+
+/**
+ * Fill pool slots [first, first + n) with a burst from (x, y). Random
+ * fields are filled a whole burst at a time from rng.
+ */
+static void fillBurst(size_t first, size_t n, float x, float y, const vec4& color, Rng& rng) {
+    // Random velocity, mostly upward
+    rng.fillUniform(&particles.vx[first], n, -10.0f, 10.0f);
+    rng.fillUniform(&particles.vy[first], n, -15.0f, -5.0f);
+    rng.fillUniform(&particles.life[first], n, 0.5f, 1.5f);  // Seconds
+    rng.fillUniform(&particles.size[first], n, 3.0f, 8.0f);  // Pixels
+    for (size_t i = first; i < first + n; i++) {
+        particles.x[i] = x;
+        particles.y[i] = y;
+        particles.r[i] = color.x;
+        particles.g[i] = color.y;
+        particles.b[i] = color.z;
+        particles.a[i] = 0.7f;  // Semi-transparent
+    }
+}
+
+/**
+ * Emit a burst of particles from a floor bounce at (x, y); particles
+ * beyond the pool budget are dropped
+ */
+static void emitBounceParticles(float x, float y, const vec4& color, Rng& rng) {
+    size_t first;
+    size_t granted = particles.allocateBurst(burstSize(rng), first);
+    if (granted > 0)
+        fillBurst(first, granted, x, y, color, rng);
+}
+
+/**
+ * Start staging the bounce bursts of a step over balls, seeding each
+ * chunk's stream from stepSeed
+ */
+static void beginStagedBursts(const BallStore& balls, uint64_t stepSeed) {
+    bounceChunks.resize((balls.getCount() + SIM_CHUNK - 1) / SIM_CHUNK);
+    for (size_t c = 0; c < bounceChunks.size(); c++) {
+        BounceChunk& chunk = bounceChunks[c];
+        chunk.rng.reseed(stepSeed, c);
+        chunk.bursts.clear();
+        chunk.particles = 0;
+    }
+}
+
+/**
+ * Give the staged bursts pool slots and fill them. Offsets are a prefix
+ * sum of the chunk counts in chunk order, and the whole step is reserved
+ * at once, so the layout and the bursts dropped at the budget never
+ * depend on which worker stepped which chunk. Chunks then fill their own
+ * ranges, in parallel when pool is not null.
+ */
+static void emitStagedBursts(float y, ThreadPool* pool) {
+    size_t total = 0;
+    for (size_t c = 0; c < bounceChunks.size(); c++) {
+        bounceChunks[c].offset = total;
+        total += bounceChunks[c].particles;
+    }
+    if (total == 0) return;
+    
+    size_t first;
+    size_t granted = particles.allocateBurst(total, first);
+    if (granted == 0) return;
+    
+    ThreadPool::RangeFn fillChunks = [&](size_t begin, size_t end, unsigned) {
+        for (size_t c = begin; c < end; c++) {
+            BounceChunk& chunk = bounceChunks[c];
+            size_t at = chunk.offset;
+            for (size_t b = 0; b < chunk.bursts.size() && at < granted; b++) {
+                const BounceBurst& burst = chunk.bursts[b];
+                fillBurst(first + at, std::min(burst.count, granted - at), burst.x, y,
+                          colorPalette[burst.colorIndex], chunk.rng);
+                at += burst.count;
+            }
+        }
+    };
+    if (pool && bounceChunks.size() > 1)
+        pool->parallelFor(bounceChunks.size(), 1, fillChunks);
+    else
+        fillChunks(0, bounceChunks.size(), 0);
+}
+
+/**
+ * Rotation drawObject applies to each object type
+ */
+static mat4 objectRotation(ObjectType type) {
+    switch (type) {
+        case CUBE:  return RotateY(cubeRotation) * RotateX(20.0f) * RotateZ(10.0f);
+        case BUNNY: return RotateY(bunnyRotation) * RotateX(90.0f);
+        default:    return mat4();
+    }
+}
+
+/**
+ * Pixels per model unit of an object drawn at the given size,
+ * matching the world scale used by screenToWorld and drawObject
+ */
+static float objectPixelScale(ObjectType type, float size) {
+    float scale = size * objectScale * 0.01f * (windowWidth / 20.0f);
+    return type == BUNNY ? scale * BUNNY_DRAW_SCALE : scale;
+}
+
+/**
+ * Half extent of each object type along x and y per unit of ball size,
+ * for the current rotations. Balls use their size as the radius, so a
+ * sphere spans 1 and the unit cube spans 0.5 before rotation.
+ */
+static void computeBallExtents(BallStepParams& params) {
+    params.extentX[SPHERE] = params.extentY[SPHERE] = 1.0f;
+    
+    mat4 cube = objectRotation(CUBE);
+    params.extentX[CUBE] = 0.5f * (fabs(cube[0][0]) + fabs(cube[0][1]) + fabs(cube[0][2]));
+    params.extentY[CUBE] = 0.5f * (fabs(cube[1][0]) + fabs(cube[1][1]) + fabs(cube[1][2]));
+    
+    params.extentX[BUNNY] = params.extentY[BUNNY] = 1.0f;
+    if (!bunnyBVH.empty()) {
+        const Aabb& b = bunnyBVH.bounds();
+        mat4 bunny = objectRotation(BUNNY);
+        float ex = 0.0f, ey = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            float reach = std::max(fabs(b.min[k]), fabs(b.max[k]));
+            ex += fabs(bunny[0][k]) * reach;
+            ey += fabs(bunny[1][k]) * reach;
+        }
+        params.extentX[BUNNY] = ex * BUNNY_DRAW_SCALE;
+        params.extentY[BUNNY] = ey * BUNNY_DRAW_SCALE;
+    }
+}
+
+/**
+ * Refresh obstacle transforms after the rotations or window size changed
+ */
+static void updateObstacles() {
+    for (size_t i = 0; i < obstacles.size(); i++) {
+        MeshObstacle& o = obstacles[i];
+        mat4 r = objectRotation(o.type);
+        for (int row = 0; row < 3; row++)
+            for (int col = 0; col < 3; col++)
+                o.rotation[row * 3 + col] = r[row][col];
+        o.scale = objectPixelScale(o.type, o.size);
+        o.mesh = &bunnyBVH;
+        updateObstacle(o);
+    }
+}
+
+/**
+ * Build the bunny BVH once the model is loaded
+ */
+void initMeshColliders() {
+    if (!bunnyLoaded || numBunnyVertices < 3) return;
+    
+    bunnyBVH.build(&bunnyVertices[0].x, 4, numBunnyVertices / 3, &physicsPool());
+    std::cout << "Bunny BVH: " << bunnyBVH.triangleCount() << " triangles, "
+              << bunnyBVH.nodeCount() << " nodes" << std::endl;
+}
+
+/**
+ * Place a cube, a sphere and (if loaded) a bunny in the scene, or clear them
+ */
+void toggleObstacles() {
+    // Balls resting where an obstacle appears or disappears must react
+    balls.wakeAll();
+    
+    if (!obstacles.empty()) {
+        obstacles.clear();
+        std::cout << "Obstacles: Off" << std::endl;
+        return;
+    }
+    
+    const ObjectType types[3] = { CUBE, SPHERE, BUNNY };
+    const float xs[3] = { 0.3f, 0.55f, 0.8f };
+    const float ys[3] = { 0.65f, 0.75f, 0.6f };
+    for (int i = 0; i < 3; i++) {
+        if (types[i] == BUNNY && bunnyBVH.empty()) continue;
+        MeshObstacle o = MeshObstacle();
+        o.type = types[i];
+        o.x = windowWidth * xs[i];
+        o.y = windowHeight * ys[i];
+        o.size = BALL_SIZE * 1.5f;
+        obstacles.push_back(o);
+    }
+    updateObstacles();
+    std::cout << "Obstacles: On (" << obstacles.size() << ")" << std::endl;
+}
+
+/**
+ * (Re)load the level from SCENE_FILE, scaled to the current window
+ */
+static bool loadScene() {
+    if (!sceneGeometry.load(SCENE_FILE, (float)windowWidth, (float)windowHeight)) return false;
+    sceneWidth = windowWidth;
+    sceneHeight = windowHeight;
+    sceneVersion++;
+    return true;
+}
+
+/**
+ * Load the level in scene.txt, or clear it
+ */
+void toggleScene() {
+    // Balls resting where a ledge appears or disappears must react
+    balls.wakeAll();
+    
+    if (!sceneGeometry.empty()) {
+        sceneGeometry.clear();
+        sceneVersion++;
+        std::cout << "Scene: Off" << std::endl;
+        return;
+    }
+    if (!loadScene()) return;
+    std::cout << "Scene: On (" << sceneGeometry.getSegments().size() << " segments, "
+              << sceneGeometry.getCircles().size() << " circles)" << std::endl;
+}
+
+// Finish the recording, if one is running
+static void stopRecording() {
+    if (!recorder.isOpen()) return;
+    recorder.close();
+    std::cout << "Recording: Off (" << recorder.frameCount() << " steps)" << std::endl;
+}
+
+void toggleRecording(const std::string& path) {
+    if (recorder.isOpen()) {
+        stopRecording();
+        return;
+    }
+    if (!recorder.open(path.c_str(), 120)) return;
+    recordedSteps = 0;
+    std::cout << "Recording: On (" << path << ")" << std::endl;
+}
+
+/**
+ * Everything a checkpoint restores besides the stores: time, rotations,
+ * the single ball and the physics and spawning parameters. Written to
+ * the snapshot as one trivially copyable block.
+ */
+struct ViewerCheckpoint {
+    float currentTime;
+    float bunnyRotation, cubeRotation;
+    float xPos, yPos, prevXPos, prevYPos;
+    float xVel, yVel;
+    float initialVelocityX, initialVelocityY;
+    float gravityStrength;
+    float simulationSpeed;
+    float physicsHz;
+    float trajectoryTolerance;
+    int32_t trajectoryCapacity;
+    int32_t particleBudget;
+    uint32_t rngSeed;
+    int32_t currentObject;
+    int32_t contactIterations;
+    float attractionStrength;
+    uint8_t multipleObjects, ballCollisions, ballSleeping, eventPhysics, showParticles, obstaclesOn, ballAttraction;
+    uint8_t sceneOn;
+    SimSettings lastSettings;
+};
+
+/**
+ * Capture the whole simulation in memory and write it to path,
+ * replacing the previous checkpoint
+ */
+void saveCheckpoint(const std::string& path) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ViewerCheckpoint state = ViewerCheckpoint();
+    state.currentTime = currentTime;
+    state.bunnyRotation = bunnyRotation;
+    state.cubeRotation = cubeRotation;
+    state.xPos = xPos;
+    state.yPos = yPos;
+    state.prevXPos = prevXPos;
+    state.prevYPos = prevYPos;
+    state.xVel = xVel;
+    state.yVel = yVel;
+    state.initialVelocityX = initialVelocityX;
+    state.initialVelocityY = initialVelocityY;
+    state.gravityStrength = gravityStrength;
+    state.simulationSpeed = simulationSpeed;
+    state.physicsHz = physicsHz;
+    state.trajectoryTolerance = trajectoryTolerance;
+    state.trajectoryCapacity = trajectoryCapacity;
+    state.particleBudget = particleBudget;
+    state.rngSeed = rngSeed;
+    state.currentObject = currentObject;
+    state.contactIterations = contactIterations;
+    state.attractionStrength = attractionStrength;
+    state.ballAttraction = ballAttraction;
+    state.multipleObjects = multipleObjects;
+    state.ballCollisions = ballCollisions;
+    state.ballSleeping = ballSleeping;
+    state.eventPhysics = eventPhysics;
+    state.showParticles = showParticles;
+    state.obstaclesOn = !obstacles.empty();
+    state.sceneOn = !sceneGeometry.empty();
+    state.lastSettings = lastSettings;
+    
+    ensureRng();
+    SnapshotWriter out = checkpoint.beginWrite();
+    out.value(state);
+    balls.save(out);
+    particles.save(out);
+    trajectory.save(out);
+    physicsRng.save(out);
+    checkpoint.endWrite();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    
+    std::cout << "Checkpoint: " << balls.getCount() << " balls, " << checkpoint.size() / 1024
+              << " KB in " << ms << " ms" << std::endl;
+    if (checkpoint.saveFile(path.c_str()))
+        std::cout << "Checkpoint saved to " << path << std::endl;
+}
+
+/**
+ * Go back to the last checkpoint, loading it from path first if none
+ * was taken since the program started
+ */
+void restoreCheckpoint(const std::string& path) {
+    if (checkpoint.empty() && !checkpoint.loadFile(path.c_str())) return;
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    SnapshotReader in;
+    ViewerCheckpoint state;
+    if (!checkpoint.beginRead(in)) {
+        std::cerr << "Checkpoint " << path << " is not a complete snapshot" << std::endl;
+        checkpoint.assign(nullptr, 0);
+        return;
+    }
+    in.value(state);
+    if (!in.good()) {
+        std::cerr << "Checkpoint is damaged" << std::endl;
+        return;
+    }
+    
+    // Time jumps back to the checkpoint's, which a recording cannot follow
+    stopRecording();
+    
+    // Obstacles are placed from the window size, so only whether they are on is saved
+    if (state.obstaclesOn != !obstacles.empty())
+        toggleObstacles();
+    if (state.sceneOn != !sceneGeometry.empty())
+        toggleScene();
+    
+    bool loaded = balls.load(in) && particles.load(in) && trajectory.load(in) && physicsRng.load(in);
+    if (!loaded || !in.atEnd()) {
+        // Parts of the state may already be replaced; start over rather than mix two runs
+        std::cerr << "Checkpoint is damaged, restarting instead" << std::endl;
+        initBall();
+        return;
+    }
+    physicsRngSeeded = true;
+    
+    currentTime = state.currentTime;
+    bunnyRotation = state.bunnyRotation;
+    cubeRotation = state.cubeRotation;
+    xPos = state.xPos;
+    yPos = state.yPos;
+    prevXPos = state.prevXPos;
+    prevYPos = state.prevYPos;
+    xVel = state.xVel;
+    yVel = state.yVel;
+    initialVelocityX = state.initialVelocityX;
+    initialVelocityY = state.initialVelocityY;
+    gravityStrength = state.gravityStrength;
+    simulationSpeed = state.simulationSpeed;
+    physicsHz = state.physicsHz;
+    trajectoryTolerance = state.trajectoryTolerance;
+    trajectoryCapacity = state.trajectoryCapacity;
+    particleBudget = state.particleBudget;
+    rngSeed = state.rngSeed;
+    currentObject = static_cast<ObjectType>(state.currentObject);
+    contactIterations = state.contactIterations;
+    attractionStrength = state.attractionStrength;
+    ballAttraction = state.ballAttraction != 0;
+    multipleObjects = state.multipleObjects != 0;
+    ballCollisions = state.ballCollisions != 0;
+    ballSleeping = state.ballSleeping != 0;
+    eventPhysics = state.eventPhysics != 0;
+    showParticles = state.showParticles != 0;
+    lastSettings = state.lastSettings;
+    
+    // The event engine is rebuilt from the restored balls on its next step
+    ballisticActive = false;
+    if (!obstacles.empty())
+        updateObstacles();
+    
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Checkpoint restored: " << balls.getCount() << " balls at t = " << currentTime
+              << " s in " << ms << " ms" << std::endl;
+}
 
 /**
  * Initialize the ball at the starting position with initial velocity
@@ -13,6 +526,8 @@ void initBall() {
     float margin = windowWidth * 0.05f;
     xPos = margin;
     yPos = margin;
+    prevXPos = xPos;
+    prevYPos = yPos;
     
     // Use the globals xVel and yVel
     xVel = initialVelocityX;
@@ -21,14 +536,19 @@ void initBall() {
     currentTime = 0.0f;
     
     // Initialize with starting point
-    trajectoryPoints.clear();
-    TrajectoryPoint pt;
-    pt.position = vec2(xPos, yPos);
-    pt.timeStamp = currentTime;
-    trajectoryPoints.push_back(pt);
+    trajectory.clear();
+    recordTrajectory(xPos, yPos);
+    
+    // A restart goes back to time zero, so it ends any recording
+    stopRecording();
     
     // Clear any existing multiple-ball objects
     balls.clear();
+    ballisticActive = false;  // Rebuilt from the empty store on the next event step
+    
+    // Restart the random stream so every run from here is reproducible
+    physicsRng.reseed(rngSeed);
+    physicsRngSeeded = true;
     
     std::cout << "Ball initialized at (" << xPos << ", " << yPos << ")" << std::endl;
 }
@@ -39,31 +559,33 @@ void initBall() {
  */
 void launchBall() {
     BallObject ball;
+    ensureRng();
+    Rng& rng = physicsRng;
     
     // Set random starting position near top-left
     float marginX = windowWidth * 0.1f;
     float marginY = windowHeight * 0.1f;
-    ball.x = marginX + (marginX * (rand() % 100) / 100.0f);
-    ball.y = marginY + (marginY * (rand() % 100) / 100.0f);
+    ball.x = marginX * rng.uniform(1.0f, 2.0f);
+    ball.y = marginY * rng.uniform(1.0f, 2.0f);
     
     // Set random initial velocity based on global settings
-    ball.vx = initialVelocityX * (0.8f + (rand() % 40) / 100.0f);
-    ball.vy = initialVelocityY * (0.8f + (rand() % 40) / 100.0f);
+    ball.vx = initialVelocityX * rng.uniform(0.8f, 1.2f);
+    ball.vy = initialVelocityY * rng.uniform(0.8f, 1.2f);
     
     // Set random properties
-    ball.colorIndex = rand() % 8;
-    ball.type = static_cast<ObjectType>(rand() % (bunnyLoaded ? 3 : 2));
-    ball.size = BALL_SIZE * (0.6f + (rand() % 80) / 100.0f);
+    ball.colorIndex = (int)rng.below(8);
+    ball.type = static_cast<ObjectType>(rng.below(bunnyLoaded ? 3 : 2));
+    ball.size = BALL_SIZE * rng.uniform(0.6f, 1.4f);
     ball.launchTime = currentTime;
     
-    // Add to the balls list
-    balls.push_back(ball);
+    // Add to the ball store
+    balls.push(ball);
     
     std::cout << "Launched ball at (" << ball.x << ", " << ball.y << ")" << std::endl;
 }
 
 /**
- * Update the physics simulation for a time step
+ * Update the physics simulation for one fixed time step
  * 
  * @param deltaTime Time step size in seconds
  */
@@ -71,143 +593,180 @@ void updateBall(float deltaTime) {
     // Apply simulation speed to delta time
     float scaledDeltaTime = deltaTime * simulationSpeed;
     
+    // Velocities are in pixels per reference frame, so scale each
+    // per-step quantity by how many reference frames this step covers
+    float stepFrames = deltaTime * REFERENCE_HZ;
+    float gravityStep = gravityStrength * stepFrames;
+    float airStep = powf(AIR_RESISTANCE, stepFrames);
+    float moveStep = simulationSpeed * stepFrames;
+    
     // Update time and rotations
     currentTime += scaledDeltaTime;
     bunnyRotation += scaledDeltaTime * 30.0f;
     cubeRotation += scaledDeltaTime * 20.0f;
     
+    // Apply budget changes before any worker emits into the pool
+    size_t budget = (size_t)std::max(particleBudget, 0);
+    if (particles.getBudget() != budget)
+        particles.setBudget(budget);
+    
+    // Obstacles turn with the rotations above
+    if (!obstacles.empty())
+        updateObstacles();
+    
+    // The level is laid out for the window, so follow it when it is resized
+    if (!sceneGeometry.empty() && (windowWidth != sceneWidth || windowHeight != sceneHeight)) {
+        balls.wakeAll();
+        loadScene();
+    }
+    
+    ensureRng();
+    
     if (multipleObjects) {
-        // Multiple objects mode: update each ball independently
-        for (auto it = balls.begin(); it != balls.end(); ) {
-            // Apply gravity
-            it->vy += gravityStrength;
-            
-            // Apply air resistance
-            it->vx *= AIR_RESISTANCE;
-            it->vy *= AIR_RESISTANCE;
-            
-            // Update position using the ball's velocity values
-            it->x += it->vx * simulationSpeed;
-            it->y += it->vy * simulationSpeed;
-            
-            // Define boundaries (using a 10% margin at the bottom)
-            float bottom = windowHeight * 0.9f;
-            if (it->y > bottom) {
-                // Bounce with energy loss
-                it->vy = -it->vy * RESTITUTION;
-                it->y = bottom;
-                if (fabs(it->vy) < 0.5f) {
-                    it->vy = 0.0f;
-                }
-                
-                // Generate particles on bounce if enabled
-                if (showParticles) {
-                    // Create 5-10 particles on bounce
-                    int numParticles = 5 + (rand() % 6);
-                    for (int i = 0; i < numParticles; i++) {
-                        Particle p;
-                        p.position = vec2(it->x, bottom);
-                        // Random velocity, mostly upward
-                        p.velocity = vec2(
-                            (rand() % 200 - 100) / 10.0f,  // -10 to 10
-                            -(rand() % 100) / 10.0f - 5.0f  // -15 to -5
-                        );
-                        // Use the ball's color
-                        p.color = colorPalette[it->colorIndex];
-                        p.color.w = 0.7f;  // Semi-transparent
-                        p.life = 0.5f + (rand() % 100) / 100.0f;  // 0.5 to 1.5 seconds
-                        p.size = 3.0f + (rand() % 50) / 10.0f;  // 3 to 8 pixels
-                        particles.push_back(p);
-                    }
-                }
+        // Multiple objects mode: the shared simulation core steps every ball
+        SimSettings settings;
+        settings.width = (float)windowWidth;
+        settings.height = (float)windowHeight;
+        settings.gravity = gravityStrength;
+        settings.speed = simulationSpeed;
+        settings.allowSleep = ballSleeping;
+        settings.contactIterations = contactIterations;
+        settings.attraction = ballAttraction ? attractionStrength : 0.0f;
+        
+        // Balls settled under other gravity, speed, contacts or window size are no longer at rest
+        if (settings.width != lastSettings.width || settings.height != lastSettings.height ||
+            settings.gravity != lastSettings.gravity || settings.speed != lastSettings.speed ||
+            settings.contactIterations != lastSettings.contactIterations)
+            balls.wakeAll();
+        lastSettings = settings;
+        
+        BallStepParams params;
+        setupBallStep(params, settings, deltaTime, currentTime);
+        computeBallExtents(params);
+        
+        // Stage a burst for each ball that bounced in its chunk; the
+        // thread stepping a chunk is the only one touching it
+        BounceFn onBounce;
+        if (showParticles) {
+            Rng& stepRng = physicsRng;
+            beginStagedBursts(balls, ((uint64_t)stepRng.next() << 32) | stepRng.next());
+            onBounce = [&](size_t i, unsigned) {
+                BounceChunk& chunk = bounceChunks[i / SIM_CHUNK];
+                BounceBurst burst;
+                burst.x = balls.x[i];
+                burst.colorIndex = balls.colorIndex[i];
+                burst.count = burstSize(chunk.rng);
+                chunk.bursts.push_back(burst);
+                chunk.particles += burst.count;
+            };
+        }
+        
+        // Particles appended from here on were spawned by this step
+        size_t firstSpawn = particles.getCount();
+        
+        if (eventPhysics) {
+            // Closed-form arcs between bounces; no ball-ball contacts, attraction, obstacles or scene
+            ballistic.configure(settings, currentTime);
+            if (!ballisticActive) {
+                balls.wakeAll();  // The engine mirrors removals only without a dormant set
+                ballistic.reset(balls, currentTime);
             }
+            ballisticActive = true;
             
-            // Check side boundaries
-            float left = windowWidth * 0.05f;
-            float right = windowWidth * 0.95f;
-            if (it->x < left) {
-                it->x = left;
-                it->vx = -it->vx * RESTITUTION;
-            }
-            if (it->x > right) {
-                it->x = right;
-                it->vx = -it->vx * RESTITUTION;
-            }
+            // Positions are only evaluated once per frame (evaluateBalls) or for a recording
+            ballistic.sync(balls, currentTime);
+            ballistic.advanceEvents(balls, currentTime, onBounce);
+            if (recorder.isOpen())
+                ballistic.evaluate(balls, currentTime);
+        } else {
+            ballisticActive = false;
             
-            // Remove ball if its lifetime exceeds 30 seconds or energy is too low
-            float lifetime = currentTime - it->launchTime;
-            float energy = fabs(it->vx) + fabs(it->vy);
-            if (lifetime > 30.0f || (it->y >= bottom - 1.0f && energy < 0.1f)) {
-                it = balls.erase(it);
-            } else {
-                ++it;
-            }
+            // Balls whose lifetime exceeds 30 seconds are removed, and so are balls
+            // that came to rest on the floor unless contacts let them pile up
+            stepBalls(balls, params, ballCollisions ? &ballGrid : nullptr, obstacles,
+                      parallelPhysics ? &physicsPool() : nullptr, onBounce, &contactSolver,
+                      &attractionTree, &sceneGeometry);
         }
+        
+        if (showParticles)
+            emitStagedBursts(params.bottom, parallelPhysics ? &physicsPool() : nullptr);
+        
+        if (recorder.isOpen())
+            recorder.writeStep(recordedSteps++, currentTime, balls, &particles, firstSpawn);
     } else {
         // Single ball mode: update global xVel and yVel
-        yVel += gravityStrength;
-        xVel *= AIR_RESISTANCE;
-        yVel *= AIR_RESISTANCE;
-        xPos += xVel * simulationSpeed;
-        yPos += yVel * simulationSpeed;
+        prevXPos = xPos;
+        prevYPos = yPos;
+        yVel += gravityStep;
+        xVel *= airStep;
+        yVel *= airStep;
+        xPos += xVel * moveStep;
+        yPos += yVel * moveStep;
+        float rawX = xPos, rawY = yPos;  // Unresolved end of the step, for the contact points
+        float floorAt = -1.0f, wallAt = -1.0f;
         
+        // Swept contacts, so fast or coarse steps rebound off the walls instead of sticking
         float bottom = windowHeight * 0.9f;
-        if (yPos > bottom) {
+        if (sweepWall(prevYPos, yPos, bottom, 1.0f, RESTITUTION)) {
+            floorAt = contactFraction(prevYPos, rawY, bottom);
             yVel = -yVel * RESTITUTION;
-            yPos = bottom;
             
-            if (fabs(yVel) < 0.5f)
+            if (fabs(yVel) < 0.5f) {
                 yVel = 0.0f;
+                yPos = bottom;
+            }
                 
             // Generate particles on bounce if enabled
-            if (showParticles) {
-                // Create 5-10 particles on bounce
-                int numParticles = 5 + (rand() % 6);
-                for (int i = 0; i < numParticles; i++) {
-                    Particle p;
-                    p.position = vec2(xPos, bottom);
-                    // Random velocity, mostly upward
-                    p.velocity = vec2(
-                        (rand() % 200 - 100) / 10.0f,  // -10 to 10
-                        -(rand() % 100) / 10.0f - 5.0f  // -15 to -5
-                    );
-                    // Use the current color
-                    p.color = colorPalette[currentColorIndex];
-                    p.color.w = 0.7f;  // Semi-transparent
-                    p.life = 0.5f + (rand() % 100) / 100.0f;  // 0.5 to 1.5 seconds
-                    p.size = 3.0f + (rand() % 50) / 10.0f;  // 3 to 8 pixels
-                    particles.push_back(p);
-                }
-            }
+            if (showParticles)
+                emitBounceParticles(xPos, bottom, colorPalette[currentColorIndex], physicsRng);
         }
         
         float left = windowWidth * 0.05f;
         float right = windowWidth * 0.95f;
-        if (xPos < left) {
-            xPos = left;
-            xVel = -xVel * RESTITUTION;
-        }
-        if (xPos > right) {
-            xPos = right;
+        if (sweepWall(prevXPos, xPos, left, -1.0f, RESTITUTION) ||
+            sweepWall(prevXPos, xPos, right, 1.0f, RESTITUTION)) {
+            wallAt = contactFraction(prevXPos, rawX, rawX < left ? left : right);
             xVel = -xVel * RESTITUTION;
         }
+        xPos = std::min(std::max(xPos, left), right);
+        
+        // Collide with obstacles and the level as a sphere of the object's drawn radius
+        float radius = objectPixelScale(SPHERE, BALL_SIZE);
+        if (currentObject != SPHERE) radius *= 0.5f;
+        if (!obstacles.empty())
+            collideSphereWithObstacles(xPos, yPos, xVel, yVel, radius, obstacles, RESTITUTION);
+        if (!sceneGeometry.empty())
+            sceneGeometry.collideSphere(xPos, yPos, xVel, yVel, prevXPos, prevYPos, radius, RESTITUTION);
         
         // Add trajectory recording regardless of current mode to build up trajectory data
-        // This ensures trajectory points are always recorded for when user enables display
-        if (trajectoryPoints.empty() ||
-            length(vec2(xPos, yPos) - trajectoryPoints.back().position) > 5.0f) {
-            TrajectoryPoint pt;
-            pt.position = vec2(xPos, yPos);
-            pt.timeStamp = currentTime;
-            trajectoryPoints.push_back(pt);
-            
-            // Limit the number of points to avoid excessive memory usage
-            while (trajectoryPoints.size() > MAX_TRAJECTORY_POINTS)
-                trajectoryPoints.pop_front();
-        }
+        // This ensures trajectory points are always recorded for when user enables display.
+        // Every step is sampled; the history keeps only the points the path's shape needs,
+        // with the bounce contacts as corners in the order they were reached.
+        float firstAt = floorAt, secondAt = wallAt;
+        if (wallAt >= 0.0f && (floorAt < 0.0f || wallAt < floorAt))
+            std::swap(firstAt, secondAt);
+        recordContact(firstAt, prevXPos, prevYPos, rawX, rawY);
+        recordContact(secondAt, prevXPos, prevYPos, rawX, rawY);
+        recordTrajectory(xPos, yPos);
     }
 }
 
+/**
+ * Bring the multi-object balls to the current time while the
+ * event-driven engine holds them. Its arcs are closed-form, so this is
+ * the only per-ball work of the mode, and it runs once per frame rather
+ * than once per physics step. The previous positions are set to the new
+ * ones, as the evaluation is already exact for the frame.
+ */
+void evaluateBalls() {
+    if (!ballisticActive) return;
+    ballistic.sync(balls, currentTime);
+    ballistic.evaluate(balls, currentTime);
+    size_t n = balls.getCount();
+    std::copy(balls.x.data(), balls.x.data() + n, balls.prevX.data());
+    std::copy(balls.y.data(), balls.y.data() + n, balls.prevY.data());
+}
+
 /**
  * Update all particles in the scene
  * 
@@ -216,23 +775,27 @@ void updateBall(float deltaTime) {
 void updateParticles(float deltaTime) {
     // Apply simulation speed to delta time
     float scaledDeltaTime = deltaTime * simulationSpeed;
+    float stepFrames = deltaTime * REFERENCE_HZ;
+    float gravityStep = gravityStrength * 0.5f * stepFrames;  // Half strength for visual appeal
     
-    for (auto it = particles.begin(); it != particles.end(); ) {
-        // Apply gravity to particles (half strength for visual appeal)
-        it->velocity.y += gravityStrength * 0.5f;
-        
-        // Update position
-        it->position += it->velocity * simulationSpeed;
-        
-        // Decrease life span
-        it->life -= scaledDeltaTime;
-        
-        if (it->life <= 0.0f)
-            it = particles.erase(it);
-        else {
-            // Fade out as life decreases
-            it->color.w = it->life;
-            ++it;
-        }
+    ParticleStepParams params;
+    params.gravity = gravityStep;
+    params.speed = simulationSpeed * stepFrames;
+    params.decay = scaledDeltaTime;
+    
+    size_t count = particles.getCount();
+    size_t dead = 0;
+    if (parallelPhysics && count > SIM_CHUNK) {
+        std::atomic<size_t> deadTotal(0);
+        physicsPool().parallelFor(count, SIM_CHUNK, [&](size_t begin, size_t end, unsigned) {
+            deadTotal += integrateParticleRange(particles, params, begin, end);
+        });
+        dead = deadTotal;
+    } else {
+        dead = integrateParticles(particles, params);
     }
+    
+    // Swap-and-pop the particles whose life ran out
+    if (dead > 0)
+        removeDeadParticles(particles);
 }
\ No newline at end of file
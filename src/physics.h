@@ -2,10 +2,26 @@
 #define PHYSICS_H
 
 #include "Angel.h"
+#include <string>
 
 void initBall();
 void updateBall(float deltaTime);
 void launchBall();
 void updateParticles(float deltaTime);
 
+// Evaluate event-driven ball positions for drawing; call once per frame before display()
+void evaluateBalls();
+void initMeshColliders();
+void toggleObstacles();
+void toggleScene();
+
+// Start recording multi-object steps to path, or stop the current recording
+void toggleRecording(const std::string& path);
+
+// Snapshot the whole simulation in memory and write it to path (see checkpoint.h)
+void saveCheckpoint(const std::string& path);
+
+// Return to the last snapshot, reading it from path if none was taken this run
+void restoreCheckpoint(const std::string& path);
+
 #endif
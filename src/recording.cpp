@@ -0,0 +1,502 @@
+#include "recording.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char RECORDING_MAGIC[8] = { 'B', 'B', 'R', 'E', 'C', 'v', '1', '\n' };
+static const uint32_t INDEX_MAGIC = 0x58444942;  // "BIDX"
+static const size_t HEADER_SIZE = 16;            // Magic, keyframe interval, reserved
+static const size_t TRAILER_SIZE = 16;           // Index offset, entry count, magic
+static const size_t INDEX_ENTRY_SIZE = 24;
+
+enum FrameKind { FRAME_KEY = 1, FRAME_DELTA = 2 };
+
+/**
+ * Map float bits to integers that sort like the floats, so nearby values
+ * have nearby codes even across exponent boundaries
+ */
+static uint32_t orderedBits(float f) {
+    uint32_t b;
+    std::memcpy(&b, &f, sizeof(b));
+    return (b & 0x80000000u) ? ~b : (b | 0x80000000u);
+}
+
+static float fromOrdered(uint32_t o) {
+    uint32_t b = (o & 0x80000000u) ? (o & 0x7fffffffu) : ~o;
+    float f;
+    std::memcpy(&f, &b, sizeof(f));
+    return f;
+}
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+// Signed difference of two codes as a zigzag varint
+static void putDelta(std::vector<uint8_t>& out, uint32_t value, uint32_t base) {
+    int64_t d = (int64_t)value - (int64_t)base;
+    putVarint(out, ((uint64_t)d << 1) ^ (uint64_t)(d >> 63));
+}
+
+static uint8_t colorByte(float c) {
+    return (uint8_t)(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+template <typename T>
+static void putRaw(std::vector<uint8_t>& out, T v) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &v, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+/**
+ * Bounds-checked reader over one frame or the index. Every read past the
+ * end sets ok to false and returns zero, so callers check once at the end.
+ */
+struct ByteReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok;
+
+    ByteReader(const uint8_t* begin, const uint8_t* stop) : p(begin), end(stop), ok(true) {}
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) break;
+            uint8_t b = *p++;
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+
+    uint32_t delta(uint32_t base) {
+        uint64_t z = varint();
+        int64_t d = (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+        return (uint32_t)((int64_t)base + d);
+    }
+
+    template <typename T>
+    T raw() {
+        T v = T();
+        if ((size_t)(end - p) < sizeof(T)) {
+            ok = false;
+            return v;
+        }
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+};
+
+SimRecorder::SimRecorder() : file(nullptr), interval(1), frames(0), written(0), lastTime(0.0), previousCount(0) {}
+
+SimRecorder::~SimRecorder() {
+    close();
+}
+
+bool SimRecorder::open(const char* path, unsigned keyframeInterval) {
+    close();
+    file = std::fopen(path, "wb");
+    if (!file) {
+        std::cerr << "Failed to create recording: " << path << std::endl;
+        return false;
+    }
+    interval = std::max(keyframeInterval, 1u);
+    frames = 0;
+    lastTime = 0.0;
+    previousCount = 0;
+    keyframes.clear();
+
+    buffer.assign(RECORDING_MAGIC, RECORDING_MAGIC + sizeof(RECORDING_MAGIC));
+    putRaw<uint32_t>(buffer, interval);
+    putRaw<uint32_t>(buffer, 0);
+    std::fwrite(buffer.data(), 1, buffer.size(), file);
+    written = buffer.size();
+    return true;
+}
+
+void SimRecorder::close() {
+    if (!file) return;
+
+    // Keyframe index, then a trailer pointing back at it
+    buffer.clear();
+    for (size_t i = 0; i < keyframes.size(); i++) {
+        putRaw<uint64_t>(buffer, keyframes[i].step);
+        putRaw<double>(buffer, keyframes[i].time);
+        putRaw<uint64_t>(buffer, keyframes[i].offset);
+    }
+    putRaw<uint64_t>(buffer, written);
+    putRaw<uint32_t>(buffer, (uint32_t)keyframes.size());
+    putRaw<uint32_t>(buffer, INDEX_MAGIC);
+    std::fwrite(buffer.data(), 1, buffer.size(), file);
+    std::fclose(file);
+    file = nullptr;
+}
+
+bool SimRecorder::writeStep(uint64_t step, double time, const BallStore& balls,
+                            const ParticlePool* particles, size_t firstSpawn) {
+    if (!file) return false;
+    if (frames > 0 && time < lastTime) {
+        std::cerr << "Recording: step " << step << " at time " << time << " is before the last frame at "
+                  << lastTime << ", not written" << std::endl;
+        return false;
+    }
+    bool key = frames % interval == 0;
+    size_t n = balls.getCount();
+
+    // Payload length is patched in once the frame is encoded
+    buffer.assign(4, 0);
+    buffer.push_back(key ? FRAME_KEY : FRAME_DELTA);
+    putVarint(buffer, step);
+    putRaw<double>(buffer, time);
+    putVarint(buffer, n);
+
+    // Field-major, so each field's deltas sit together
+    const float* fields[RECORDED_FIELDS - 1] = {
+        balls.x.data(), balls.y.data(), balls.vx.data(), balls.vy.data(),
+        balls.size.data(), balls.launchTime.data()
+    };
+    size_t base = key ? 0 : std::min(previousCount, n);
+    for (int f = 0; f < RECORDED_FIELDS; f++) {
+        std::vector<uint32_t>& prev = previous[f];
+        prev.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            uint32_t code = f < RECORDED_FIELDS - 1
+                ? orderedBits(fields[f][i])
+                : ((uint32_t)balls.colorIndex[i] << 2) | (uint32_t)balls.type[i];
+            putDelta(buffer, code, i < base ? prev[i] : 0);
+            prev[i] = code;
+        }
+    }
+    previousCount = n;
+
+    // Bounced slots, ascending, as gaps
+    size_t bounced = 0;
+    for (size_t i = 0; i < n; i++)
+        if (balls.flags[i] & BALL_BOUNCED) bounced++;
+    putVarint(buffer, bounced);
+    size_t last = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!(balls.flags[i] & BALL_BOUNCED)) continue;
+        putVarint(buffer, i - last);
+        last = i;
+    }
+
+    // Particles spawned this step, each relative to the one before
+    size_t spawnEnd = particles ? particles->getCount() : 0;
+    size_t spawned = spawnEnd > firstSpawn ? spawnEnd - firstSpawn : 0;
+    putVarint(buffer, spawned);
+    uint32_t prevSpawn[5] = { 0, 0, 0, 0, 0 };
+    for (size_t i = firstSpawn; i < firstSpawn + spawned; i++) {
+        const float values[5] = { particles->x[i], particles->y[i], particles->vx[i], particles->vy[i],
+                                  particles->life[i] };
+        for (int k = 0; k < 5; k++) {
+            uint32_t code = orderedBits(values[k]);
+            putDelta(buffer, code, prevSpawn[k]);
+            prevSpawn[k] = code;
+        }
+        buffer.push_back(colorByte(particles->r[i]));
+        buffer.push_back(colorByte(particles->g[i]));
+        buffer.push_back(colorByte(particles->b[i]));
+    }
+
+    uint32_t payload = (uint32_t)(buffer.size() - 4);
+    std::memcpy(buffer.data(), &payload, sizeof(payload));
+    if (key) {
+        RecordingKeyframe k;
+        k.step = step;
+        k.time = time;
+        k.offset = written;
+        keyframes.push_back(k);
+    }
+    std::fwrite(buffer.data(), 1, buffer.size(), file);
+    written += buffer.size();
+    lastTime = time;
+    frames++;
+    return true;
+}
+
+SimReplay::SimReplay()
+    : data(nullptr), size(0), mapping(nullptr), interval(1), framesStart(HEADER_SIZE), framesEnd(0),
+      lastTime(0.0), frameOffset(0), nextFrameOffset(0), haveFrame(false), frameStep(0), frameTime(0.0),
+      stateCount(0) {}
+
+SimReplay::~SimReplay() {
+    close();
+}
+
+bool SimReplay::open(const char* path) {
+    close();
+#ifdef HAVE_MMAP
+    int fd = ::open(path, O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* m = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED) {
+            mapping = m;
+            data = static_cast<const uint8_t*>(m);
+            size = (size_t)st.st_size;
+        }
+    }
+    if (fd >= 0) ::close(fd);
+#endif
+    if (!data) {
+        // No mapping available: read the whole file instead
+        std::FILE* f = std::fopen(path, "rb");
+        if (f) {
+            uint8_t chunk[65536];
+            size_t got;
+            while ((got = std::fread(chunk, 1, sizeof(chunk), f)) > 0)
+                fallback.insert(fallback.end(), chunk, chunk + got);
+            std::fclose(f);
+        }
+        if (!fallback.empty()) {
+            data = fallback.data();
+            size = fallback.size();
+        }
+    }
+    if (!data) {
+        std::cerr << "Failed to open recording: " << path << std::endl;
+        return false;
+    }
+
+    if (size < HEADER_SIZE || std::memcmp(data, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0) {
+        std::cerr << "Not a recording: " << path << std::endl;
+        close();
+        return false;
+    }
+    ByteReader header(data + sizeof(RECORDING_MAGIC), data + HEADER_SIZE);
+    interval = std::max(header.raw<uint32_t>(), 1u);
+
+    if (!readIndex() && !scanFrames()) {
+        std::cerr << "Recording has no complete frames: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    // The last frame follows the last keyframe by less than one interval
+    size_t offset = (size_t)keyframes.back().offset;
+    lastTime = keyframes.back().time;
+    while (offset + 4 <= framesEnd) {
+        ByteReader r(data + offset, data + framesEnd);
+        size_t payload = r.raw<uint32_t>();
+        r.raw<uint8_t>();
+        r.varint();
+        double t = r.raw<double>();
+        if (!r.ok || offset + 4 + payload > framesEnd) break;
+        lastTime = t;
+        offset += 4 + payload;
+    }
+    return true;
+}
+
+void SimReplay::close() {
+#ifdef HAVE_MMAP
+    if (mapping) munmap(mapping, size);
+#endif
+    mapping = nullptr;
+    data = nullptr;
+    size = 0;
+    fallback.clear();
+    keyframes.clear();
+    haveFrame = false;
+    stateCount = 0;
+}
+
+double SimReplay::startTime() const {
+    return keyframes.empty() ? 0.0 : keyframes.front().time;
+}
+
+/**
+ * Load the index named by the trailer, checking that it fits inside the
+ * file and that the frames end where it starts
+ */
+bool SimReplay::readIndex() {
+    if (size < HEADER_SIZE + TRAILER_SIZE) return false;
+    ByteReader trailer(data + size - TRAILER_SIZE, data + size);
+    uint64_t indexOffset = trailer.raw<uint64_t>();
+    uint32_t count = trailer.raw<uint32_t>();
+    if (trailer.raw<uint32_t>() != INDEX_MAGIC || count == 0) return false;
+    if (indexOffset < HEADER_SIZE || indexOffset + (uint64_t)count * INDEX_ENTRY_SIZE != size - TRAILER_SIZE)
+        return false;
+
+    ByteReader r(data + indexOffset, data + size - TRAILER_SIZE);
+    keyframes.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        keyframes[i].step = r.raw<uint64_t>();
+        keyframes[i].time = r.raw<double>();
+        keyframes[i].offset = r.raw<uint64_t>();
+    }
+    framesEnd = (size_t)indexOffset;
+    return r.ok;
+}
+
+/**
+ * Rebuild the index of a file without one by walking the length fields,
+ * stopping at the first truncated frame
+ */
+bool SimReplay::scanFrames() {
+    keyframes.clear();
+    size_t offset = HEADER_SIZE;
+    while (offset + 4 <= size) {
+        ByteReader r(data + offset, data + size);
+        size_t payload = r.raw<uint32_t>();
+        if (offset + 4 + payload > size) break;
+        uint8_t kind = r.raw<uint8_t>();
+        uint64_t step = r.varint();
+        double t = r.raw<double>();
+        if (!r.ok) break;
+        if (kind == FRAME_KEY) {
+            RecordingKeyframe k;
+            k.step = step;
+            k.time = t;
+            k.offset = offset;
+            keyframes.push_back(k);
+        }
+        offset += 4 + payload;
+    }
+    framesEnd = offset;
+    return !keyframes.empty();
+}
+
+/**
+ * Decode the frame at offset on top of the current state, which must be
+ * the frame before it unless this is a keyframe
+ */
+bool SimReplay::decodeFrame(size_t offset, size_t& nextOffset) {
+    if (offset + 4 > framesEnd) return false;
+    ByteReader r(data + offset, data + framesEnd);
+    size_t payload = r.raw<uint32_t>();
+    if (offset + 4 + payload > framesEnd) return false;
+    r.end = data + offset + 4 + payload;
+
+    bool key = r.raw<uint8_t>() == FRAME_KEY;
+    frameStep = r.varint();
+    frameTime = r.raw<double>();
+    size_t n = (size_t)r.varint();
+    if (!r.ok || n > payload) return false;  // Every ball takes at least a byte per field
+
+    lastX = state[0];
+    lastY = state[1];
+    size_t base = key ? 0 : std::min(stateCount, n);
+    for (int f = 0; f < RECORDED_FIELDS; f++) {
+        std::vector<uint32_t>& values = state[f];
+        values.resize(n);
+        for (size_t i = 0; i < n; i++)
+            values[i] = r.delta(i < base ? values[i] : 0);
+    }
+    stateCount = n;
+
+    size_t bounced = (size_t)r.varint();
+    frameBounces.clear();
+    uint64_t slot = 0;
+    for (size_t i = 0; i < bounced && r.ok; i++) {
+        slot += r.varint();
+        frameBounces.push_back((uint32_t)slot);
+    }
+
+    size_t spawned = (size_t)r.varint();
+    frameSpawns.clear();
+    uint32_t prev[5] = { 0, 0, 0, 0, 0 };
+    for (size_t i = 0; i < spawned && r.ok; i++) {
+        for (int k = 0; k < 5; k++) prev[k] = r.delta(prev[k]);
+        RecordedSpawn s;
+        s.x = fromOrdered(prev[0]);
+        s.y = fromOrdered(prev[1]);
+        s.vx = fromOrdered(prev[2]);
+        s.vy = fromOrdered(prev[3]);
+        s.life = fromOrdered(prev[4]);
+        s.r = r.raw<uint8_t>();
+        s.g = r.raw<uint8_t>();
+        s.b = r.raw<uint8_t>();
+        frameSpawns.push_back(s);
+    }
+    if (!r.ok) {
+        std::cerr << "Corrupt recording frame at offset " << offset << std::endl;
+        haveFrame = false;
+        return false;
+    }
+
+    frameOffset = offset;
+    nextOffset = offset + 4 + payload;
+    haveFrame = true;
+    return true;
+}
+
+void SimReplay::storeBalls(BallStore& balls, bool keepPrevious) const {
+    size_t n = stateCount;
+    balls.clear();
+    balls.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        BallObject ball;
+        ball.x = fromOrdered(state[0][i]);
+        ball.y = fromOrdered(state[1][i]);
+        ball.vx = fromOrdered(state[2][i]);
+        ball.vy = fromOrdered(state[3][i]);
+        ball.size = fromOrdered(state[4][i]);
+        ball.launchTime = fromOrdered(state[5][i]);
+        ball.colorIndex = (int)(state[6][i] >> 2);
+        ball.type = static_cast<ObjectType>(state[6][i] & 3);
+        balls.push(ball);
+    }
+    if (!keepPrevious) return;
+
+    // Slots carry over between frames; balls new to a slot start where they are
+    size_t carried = std::min(n, lastX.size());
+    for (size_t i = 0; i < carried; i++) {
+        balls.prevX[i] = fromOrdered(lastX[i]);
+        balls.prevY[i] = fromOrdered(lastY[i]);
+    }
+}
+
+bool SimReplay::seek(double time, BallStore& balls) {
+    if (keyframes.empty() || time < keyframes.front().time) return false;
+
+    // Last keyframe at or before time
+    size_t lo = 0, hi = keyframes.size();
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (keyframes[mid].time <= time) lo = mid;
+        else hi = mid;
+    }
+    if (!decodeFrame((size_t)keyframes[lo].offset, nextFrameOffset)) return false;
+
+    // Delta frames up to time; peek at each frame's time before decoding it
+    while (nextFrameOffset + 4 <= framesEnd) {
+        ByteReader r(data + nextFrameOffset, data + framesEnd);
+        r.raw<uint32_t>();
+        r.raw<uint8_t>();
+        r.varint();
+        double t = r.raw<double>();
+        if (!r.ok || t > time) break;
+        if (!decodeFrame(nextFrameOffset, nextFrameOffset)) return false;
+    }
+    storeBalls(balls, false);
+    return true;
+}
+
+bool SimReplay::next(BallStore& balls) {
+    if (!haveFrame) {
+        if (!decodeFrame(framesStart, nextFrameOffset)) return false;
+        storeBalls(balls, false);
+        return true;
+    }
+    if (nextFrameOffset >= framesEnd || !decodeFrame(nextFrameOffset, nextFrameOffset)) return false;
+    storeBalls(balls, true);
+    return true;
+}
@@ -0,0 +1,179 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include "ballstore.h"
+#include "particlepool.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/**
+ * Binary recordings of multi-object runs.
+ *
+ * A recording is a header followed by one frame per recorded step and a
+ * keyframe index. Every frame holds the full ball state (positions,
+ * velocities, sizes, launch times, types and colours), the slots of the
+ * balls that bounced in that step and the particles spawned in it.
+ * Keyframes store each float as an absolute value; the frames between
+ * them store only the difference from the previous frame. Float bit
+ * patterns are mapped to ordered integers before subtracting, so
+ * differences are small for values that barely changed, and are written
+ * as zigzag varints. The encoding is lossless: a replayed state is
+ * bit-identical to the recorded one.
+ *
+ * Each frame starts with its payload length, so a file whose index was
+ * never written (e.g. the recording process crashed) can still be
+ * opened by scanning the frames. Integers are little-endian.
+ */
+
+// Per-ball fields in each frame: x, y, vx, vy, size, launchTime and colour/type
+static const int RECORDED_FIELDS = 7;
+
+// Particle spawned during a recorded step
+struct RecordedSpawn {
+    float x, y;
+    float vx, vy;
+    float life;
+    uint8_t r, g, b;  // Colour scaled to 0-255
+};
+
+// Keyframe index entry; offset is where the keyframe's length field starts
+struct RecordingKeyframe {
+    uint64_t step;
+    double time;
+    uint64_t offset;
+};
+
+/**
+ * Streams the state after each step to a recording file.
+ * Frames are encoded into a reusable buffer and written with one fwrite.
+ */
+class SimRecorder {
+public:
+    SimRecorder();
+    ~SimRecorder();
+
+    /**
+     * Create or truncate path and write the header. Every
+     * keyframeInterval-th frame is a keyframe.
+     *
+     * @return false if the file could not be created
+     */
+    bool open(const char* path, unsigned keyframeInterval);
+
+    // Append the keyframe index and close the file
+    void close();
+
+    bool isOpen() const { return file != nullptr; }
+
+    /**
+     * Record the state of balls after step number step at simulation
+     * time time. Particles [firstSpawn, particles->getCount()) are
+     * recorded as spawned during this step; pass nullptr for none.
+     *
+     * @return false if no file is open or time is before the last
+     *         frame's, which would break seeking by time
+     */
+    bool writeStep(uint64_t step, double time, const BallStore& balls,
+                   const ParticlePool* particles, size_t firstSpawn);
+
+    size_t frameCount() const { return frames; }
+    uint64_t bytesWritten() const { return written; }
+
+private:
+    SimRecorder(const SimRecorder&);
+    SimRecorder& operator=(const SimRecorder&);
+
+    std::FILE* file;
+    unsigned interval;
+    size_t frames;
+    uint64_t written;
+    double lastTime;  // Of the last frame written
+    std::vector<uint8_t> buffer;
+    std::vector<uint32_t> previous[RECORDED_FIELDS];  // Encoded fields of the last frame
+    size_t previousCount;
+    std::vector<RecordingKeyframe> keyframes;
+};
+
+/**
+ * Reads a recording through a memory mapping. seek finds the keyframe
+ * before a time by binary search over the index and decodes forward
+ * from it, so it touches at most one keyframe interval of frames.
+ */
+class SimReplay {
+public:
+    SimReplay();
+    ~SimReplay();
+
+    /**
+     * Map path and load its keyframe index, rebuilding it by scanning
+     * the frames if the file has none.
+     *
+     * @return false if the file is missing or is not a recording
+     */
+    bool open(const char* path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+
+    size_t keyframeCount() const { return keyframes.size(); }
+    unsigned getKeyframeInterval() const { return interval; }
+    size_t fileSize() const { return size; }
+    double startTime() const;
+    double endTime() const { return lastTime; }
+
+    /**
+     * Decode the last frame at or before time into balls.
+     *
+     * @return false if time is before the first frame
+     */
+    bool seek(double time, BallStore& balls);
+
+    /**
+     * Decode the frame after the current one into balls, with the
+     * current positions moved to prevX/prevY.
+     *
+     * @return false at the end of the recording
+     */
+    bool next(BallStore& balls);
+
+    // Step number and time of the current frame
+    uint64_t step() const { return frameStep; }
+    double time() const { return frameTime; }
+
+    // Slots that bounced and particles spawned in the current frame
+    const std::vector<uint32_t>& bounces() const { return frameBounces; }
+    const std::vector<RecordedSpawn>& spawns() const { return frameSpawns; }
+
+private:
+    SimReplay(const SimReplay&);
+    SimReplay& operator=(const SimReplay&);
+
+    bool readIndex();
+    bool scanFrames();
+    bool decodeFrame(size_t offset, size_t& nextOffset);
+    void storeBalls(BallStore& balls, bool keepPrevious) const;
+
+    const uint8_t* data;
+    size_t size;
+    void* mapping;
+    std::vector<uint8_t> fallback;  // File contents where mapping is unavailable
+    unsigned interval;
+    size_t framesStart;  // Offset of the first frame
+    size_t framesEnd;    // Offset where the index (or the file) starts
+    std::vector<RecordingKeyframe> keyframes;
+    double lastTime;
+
+    size_t frameOffset;      // Offset of the current frame's length field
+    size_t nextFrameOffset;  // Offset of the frame after it
+    bool haveFrame;
+    uint64_t frameStep;
+    double frameTime;
+    std::vector<uint32_t> state[RECORDED_FIELDS];  // Encoded fields of the current frame
+    std::vector<uint32_t> lastX, lastY;            // Positions of the frame before it
+    size_t stateCount;
+    std::vector<uint32_t> frameBounces;
+    std::vector<RecordedSpawn> frameSpawns;
+};
+
+#endif
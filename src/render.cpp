@@ -4,7 +4,9 @@
 #include <vector>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 #include "objects.h"
+#include "glstate.h"
 
 /**
  * Generates a rainbow color based on a time parameter
@@ -42,16 +44,18 @@ static void drawGrid() {
     
     // Set identity model matrix for grid
     mat4 identityModel = mat4(1.0);
-    glUniformMatrix4fv(modelLoc, 1, GL_TRUE, identityModel);
+    currentProgram->use();
+    currentProgram->set(UNIFORM_MODEL, identityModel);
     
-    // Bind the trajectory VAO/VBO (reusing it for grid)
-    glBindVertexArray(vaoTrajectory);
-    glBindBuffer(GL_ARRAY_BUFFER, vboTrajectory);
+    // The grid has its own buffer so the trajectory ring is never overwritten
+    glState.bindVertexArray(vaoGrid);
+    glState.bindBuffer(GL_ARRAY_BUFFER, vboGrid);
+    glVertexAttrib3f(currentProgram->attributeLocation(ATTRIBUTE_NORMAL), 0.0f, 0.0f, 1.0f);
     glBufferSubData(GL_ARRAY_BUFFER, 0, gridLines.size() * sizeof(vec4), gridLines.data());
     
     // Set grid color and draw lines
-    glLineWidth(1.0f);
-    glUniform4fv(objColorLoc, 1, gridColor);
+    glState.lineWidth(1.0f);
+    currentProgram->set(UNIFORM_OBJ_COLOR, gridColor);
     glDrawArrays(GL_LINES, 0, (GLsizei)gridLines.size());
 }
 
@@ -72,41 +76,45 @@ vec2 screenToWorld(float screenX, float screenY) {
 }
 
 /**
- * Draws a specific object at the given position with a specific size
+ * Sets polygon mode based on current render mode and drawing mode, with
+ * lineWidth for wireframes
  */
-static void drawObject(ObjectType objType, const vec2& position, float size, const vec4& color, bool isTrajectory = false) {
+static void setPolygonMode(float lineWidth) {
+    if (currentRenderMode == WIREFRAME_MODE || (currentMode == WIREFRAME && currentRenderMode == SHADING_MODE)) {
+        glState.polygonMode(GL_LINE);
+        glState.lineWidth(lineWidth);
+    } else {
+        glState.polygonMode(GL_FILL);
+    }
+}
+
+/**
+ * Orientation of a mesh type as drawObjectWorld draws it, before it is
+ * scaled to its size and moved into place
+ */
+static mat4 meshOrientation(ObjectType objType) {
+    if (objType == SPHERE) return mat4(1.0f);
+    if (objType == BUNNY) return Scale(0.15f, 0.15f, 0.15f) * RotateY(bunnyRotation) * RotateX(90.0f);
+    return RotateY(cubeRotation) * RotateX(20.0f) * RotateZ(10.0f);
+}
+
+/**
+ * Draws a specific object at the given world position with a specific size
+ */
+static void drawObjectWorld(ObjectType objType, const vec2& worldPos, float size, const vec4& color, bool isTrajectory = false) {
     mat4 model;
     
-    // Convert screen position to world position for perspective projection
-    vec2 worldPos = screenToWorld(position.x, position.y);
-    
     // Apply the global object scale factor to the size
     float scaledSize = (size * (isTrajectory ? 1.0f : objectScale)) * 0.01f; // Scale down for world coordinates
     
     // Select appropriate shader program based on render mode
-    GLuint programToUse = currentProgram;
-    if (currentRenderMode == TEXTURE_MODE) {
-        programToUse = phongProgram;
-    } else {
-        programToUse = useGouraud ? gouraudProgram : phongProgram;
-    }
-    
-    glUseProgram(programToUse);
-    
-    // Update uniform locations if program changed
-    GLuint tempModelLoc = glGetUniformLocation(programToUse, "model");
-    GLuint tempColorLoc = glGetUniformLocation(programToUse, "objColor");
+    ShaderProgram& program = (currentRenderMode == TEXTURE_MODE || !useGouraud) ? phongProgram : gouraudProgram;
+    program.use();
     
     // Set object color
-    glUniform4fv(tempColorLoc, 1, color);
+    program.set(UNIFORM_OBJ_COLOR, color);
     
-    // Set polygon mode based on current render mode and drawing mode
-    if (currentRenderMode == WIREFRAME_MODE || (currentMode == WIREFRAME && currentRenderMode == SHADING_MODE)) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glLineWidth(isTrajectory ? 1.0f : 2.0f);
-    } else {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    }
+    setPolygonMode(isTrajectory ? 1.0f : 2.0f);
     
     if (objType == SPHERE) {
         // Position sphere in world coordinates
@@ -114,46 +122,18 @@ static void drawObject(ObjectType objType, const vec2& position, float size, con
                Translate(worldPos.x, worldPos.y, 0.0f) * 
                Scale(scaledSize, scaledSize, scaledSize);
         
-        glUniformMatrix4fv(tempModelLoc, 1, GL_TRUE, model);
-        
-        // Set lighting direction (transform if light follows object)
-        vec3 worldLightDir(0.5f, 1.0f, 0.75f);
-        vec3 transformedLightDir = lightFollowsObject
-                                ? normalize(vec3((model * vec4(worldLightDir, 0.0f)).x,
-                                                (model * vec4(worldLightDir, 0.0f)).y,
-                                                (model * vec4(worldLightDir, 0.0f)).z))
-                                : worldLightDir;
-        
-        glUniform3fv(glGetUniformLocation(programToUse, "lightDir"), 1, &transformedLightDir[0]);
-        
-        // Set material properties
-        float shininess = useMetallic ? metallicShininess : plasticShininess;
-        float specularStrength = useMetallic ? metallicSpecularStrength : plasticSpecularStrength;
-        
-        glUniform1f(glGetUniformLocation(programToUse, "shininess"), shininess);
-        glUniform1f(glGetUniformLocation(programToUse, "specularStrength"), specularStrength);
-        
-        // Update lighting component uniforms
-        glUniform1i(glGetUniformLocation(programToUse, "useAmbient"), useAmbient);
-        glUniform1i(glGetUniformLocation(programToUse, "useDiffuse"), useDiffuse);
-        glUniform1i(glGetUniformLocation(programToUse, "useSpecular"), useSpecular);
+        program.set(UNIFORM_MODEL, model);
         
         // Bind texture for texture mode
         if (currentRenderMode == TEXTURE_MODE) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, texID);
-            GLint useTextureLoc = glGetUniformLocation(programToUse, "useTexture");
-            if (useTextureLoc != -1) {
-                glUniform1i(useTextureLoc, 1);
-            }
+            glState.activeTexture(GL_TEXTURE0);
+            glState.bindTexture(GL_TEXTURE_2D, texID);
+            program.set(UNIFORM_USE_TEXTURE, 1);
         } else {
-            GLint useTextureLoc = glGetUniformLocation(programToUse, "useTexture");
-            if (useTextureLoc != -1) {
-                glUniform1i(useTextureLoc, 0);
-            }
+            program.set(UNIFORM_USE_TEXTURE, 0);
         }
         
-        glBindVertexArray(vaoSphere);
+        glState.bindVertexArray(vaoSphere);
         glDrawArrays(GL_TRIANGLES, 0, numSphereVertices);
     }
     else if (objType == BUNNY && bunnyLoaded) {
@@ -163,29 +143,9 @@ static void drawObject(ObjectType objType, const vec2& position, float size, con
                RotateY(bunnyRotation) *
                RotateX(90.0f);
         
-        glUniformMatrix4fv(tempModelLoc, 1, GL_TRUE, model);
-        
-        // Set lighting and material for bunny
-        vec3 worldLightDir(0.5f, 1.0f, 0.75f);
-        vec3 transformedLightDir = lightFollowsObject
-                                ? normalize(vec3((model * vec4(worldLightDir, 0.0f)).x,
-                                                (model * vec4(worldLightDir, 0.0f)).y,
-                                                (model * vec4(worldLightDir, 0.0f)).z))
-                                : worldLightDir;
-        
-        glUniform3fv(glGetUniformLocation(programToUse, "lightDir"), 1, &transformedLightDir[0]);
-        
-        float shininess = useMetallic ? metallicShininess : plasticShininess;
-        float specularStrength = useMetallic ? metallicSpecularStrength : plasticSpecularStrength;
+        program.set(UNIFORM_MODEL, model);
         
-        glUniform1f(glGetUniformLocation(programToUse, "shininess"), shininess);
-        glUniform1f(glGetUniformLocation(programToUse, "specularStrength"), specularStrength);
-        
-        glUniform1i(glGetUniformLocation(programToUse, "useAmbient"), useAmbient);
-        glUniform1i(glGetUniformLocation(programToUse, "useDiffuse"), useDiffuse);
-        glUniform1i(glGetUniformLocation(programToUse, "useSpecular"), useSpecular);
-        
-        glBindVertexArray(vaoBunny);
+        glState.bindVertexArray(vaoBunny);
         glDrawArrays(GL_TRIANGLES, 0, numBunnyVertices);
     }
     else { // default: cube
@@ -194,83 +154,157 @@ static void drawObject(ObjectType objType, const vec2& position, float size, con
                Scale(scaledSize, scaledSize, scaledSize) *
                RotateY(cubeRotation) * RotateX(20.0f) * RotateZ(10.0f);
         
-        glUniformMatrix4fv(tempModelLoc, 1, GL_TRUE, model);
-        
-        // Set lighting and material for cube
-        vec3 worldLightDir(0.5f, 1.0f, 0.75f);
-        vec3 transformedLightDir = lightFollowsObject
-                                ? normalize(vec3((model * vec4(worldLightDir, 0.0f)).x,
-                                                (model * vec4(worldLightDir, 0.0f)).y,
-                                                (model * vec4(worldLightDir, 0.0f)).z))
-                                : worldLightDir;
+        program.set(UNIFORM_MODEL, model);
         
-        glUniform3fv(glGetUniformLocation(programToUse, "lightDir"), 1, &transformedLightDir[0]);
-        
-        float shininess = useMetallic ? metallicShininess : plasticShininess;
-        float specularStrength = useMetallic ? metallicSpecularStrength : plasticSpecularStrength;
-        
-        glUniform1f(glGetUniformLocation(programToUse, "shininess"), shininess);
-        glUniform1f(glGetUniformLocation(programToUse, "specularStrength"), specularStrength);
-        
-        glUniform1i(glGetUniformLocation(programToUse, "useAmbient"), useAmbient);
-        glUniform1i(glGetUniformLocation(programToUse, "useDiffuse"), useDiffuse);
-        glUniform1i(glGetUniformLocation(programToUse, "useSpecular"), useSpecular);
-        
-        glBindVertexArray(vaoCube);
+        glState.bindVertexArray(vaoCube);
         glDrawArrays(GL_TRIANGLES, 0, numCubeVertices);
     }
+}
+
+/**
+ * Draws a specific object at the given window position with a specific size
+ */
+static void drawObject(ObjectType objType, const vec2& position, float size, const vec4& color, bool isTrajectory = false) {
+    // Convert screen position to world position for perspective projection
+    drawObjectWorld(objType, screenToWorld(position.x, position.y), size, color, isTrajectory);
+}
+
+/**
+ * GPU mirror of one trajectory ring. Vertex i holds ring slot i, and the
+ * extra vertex at index capacity repeats slot 0, so a line strip can run
+ * from the oldest point through the wrap without a gap.
+ */
+static const TrajectoryRing* gpuTrajectorySource = nullptr;
+static size_t gpuTrajectoryCapacity = 0;
+static uint32_t gpuTrajectoryGeneration = 0;
+static uint64_t gpuTrajectoryUploaded = 0;  // Ring pushes already in the buffer
+
+// On-screen path error accepted when picking a trajectory level of detail
+static const float TRAJECTORY_LOD_PIXELS = 2.0f;
+
+// Ghost objects are spread over this many seconds of the most recent path
+static const float TRAJECTORY_GHOST_SECONDS = 1.5f;
+
+/**
+ * Bring vboTrajectory up to date with ring, uploading only the slots
+ * written since the last call (plus the newest one, which the simplifier
+ * may have moved) straight from ring memory. Switching rings or a new
+ * slot layout uploads everything once.
+ */
+static void uploadTrajectory(const TrajectoryRing& ring) {
+    size_t cap = ring.capacity();
+    const size_t stride = TrajectoryRing::COMPONENTS * sizeof(float);
+    glState.bindBuffer(GL_ARRAY_BUFFER, vboTrajectory);
     
-    // Reset line width
-    glLineWidth(1.0f);
+    if (&ring != gpuTrajectorySource || cap != gpuTrajectoryCapacity ||
+        ring.getGeneration() != gpuTrajectoryGeneration) {
+        if (cap != gpuTrajectoryCapacity)
+            glBufferData(GL_ARRAY_BUFFER, (cap + 1) * stride, nullptr, GL_DYNAMIC_DRAW);
+        gpuTrajectorySource = &ring;
+        gpuTrajectoryCapacity = cap;
+        gpuTrajectoryGeneration = ring.getGeneration();
+        gpuTrajectoryUploaded = 0;
+    }
     
-    // Switch back to current program
-    glUseProgram(currentProgram);
+    // Pushes older than the last capacity ones have already been overwritten
+    uint64_t pushed = ring.pushCount();
+    if (pushed == 0) return;
+    uint64_t next = std::max(std::min(gpuTrajectoryUploaded, pushed - 1),
+                             pushed - std::min<uint64_t>(pushed, cap));
+    const float* data = ring.positionData();
+    while (next < pushed) {
+        size_t slot = (size_t)(next % cap);
+        size_t n = (size_t)std::min<uint64_t>(pushed - next, cap - slot);
+        glBufferSubData(GL_ARRAY_BUFFER, slot * stride, n * stride, data + slot * TrajectoryRing::COMPONENTS);
+        if (slot == 0)
+            glBufferSubData(GL_ARRAY_BUFFER, cap * stride, stride, data);
+        next += n;
+    }
+    gpuTrajectoryUploaded = pushed;
+}
+
+/**
+ * Coarsest trajectory level whose path error, magnified by the current
+ * zoom, stays within TRAJECTORY_LOD_PIXELS on screen
+ */
+static int trajectoryLevel() {
+    int level = 0;
+    float error = trajectoryTolerance * zoomScale;
+    for (int l = 1; l < TrajectoryHistory::LEVELS; l++) {
+        error *= TrajectoryHistory::LEVEL_FACTOR;
+        if (error > TRAJECTORY_LOD_PIXELS) break;
+        level = l;
+    }
+    return level;
+}
+
+/**
+ * Position on ring's path at time t, interpolated between the points
+ * around it. Returns false if t is older than the oldest point.
+ */
+static bool trajectoryPositionAt(const TrajectoryRing& ring, float t, vec2& pos) {
+    size_t i = ring.findTime(t);
+    if (i == 0 || i >= ring.size()) return false;
+    float t0 = ring.time(i - 1), t1 = ring.time(i);
+    float f = t1 > t0 ? (t - t0) / (t1 - t0) : 1.0f;
+    pos = vec2(ring.x(i - 1) + (ring.x(i) - ring.x(i - 1)) * f,
+               ring.y(i - 1) + (ring.y(i) - ring.y(i - 1)) * f);
+    return true;
 }
 
 /**
  * Draws trajectory visualization based on the current trajectory mode
  */
 static void drawTrajectory() {
-    if (trajectoryMode == NONE || trajectoryPoints.size() < 2) return;
+    if (trajectoryMode == NONE || trajectory.level(0).size() < 2) return;
     
     // Still draw a connecting line for LINE mode to show the path
     if (trajectoryMode == LINE) {
-        std::vector<vec4> lineVerts;
-        lineVerts.reserve(trajectoryPoints.size());
-        for (auto& tp : trajectoryPoints) {
-            vec2 worldPos = screenToWorld(tp.position.x, tp.position.y);
-            lineVerts.push_back(vec4(worldPos.x, worldPos.y, 0.0f, 1.0f));
-        }
-        
-        // Set identity model matrix for trajectory
-        mat4 identityModel = mat4(1.0);
-        glUniformMatrix4fv(modelLoc, 1, GL_TRUE, identityModel);
+        const TrajectoryRing& ring = trajectory.level(trajectoryLevel());
+        uploadTrajectory(ring);
         
-        // Bind the trajectory VAO/VBO and upload data
-        glBindVertexArray(vaoTrajectory);
-        glBindBuffer(GL_ARRAY_BUFFER, vboTrajectory);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, lineVerts.size()*sizeof(vec4), lineVerts.data());
+        // The line is zoomed like the objects drawn along it
+        mat4 model = Scale(zoomScale, zoomScale, zoomScale);
+        currentProgram->use();
+        currentProgram->set(UNIFORM_MODEL, model);
+        glState.bindVertexArray(vaoTrajectory);
+        glVertexAttrib3f(currentProgram->attributeLocation(ATTRIBUTE_NORMAL), 0.0f, 0.0f, 1.0f);
         
         // Set line width and color
-        glLineWidth(2.0f);
+        glState.lineWidth(2.0f);
         vec4 lineColor(0.7, 0.7, 0.7, 0.5); // Semitransparent line
-        glUniform4fv(objColorLoc, 1, lineColor);
-        glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)lineVerts.size());
-        glLineWidth(1.0f);
+        currentProgram->set(UNIFORM_OBJ_COLOR, lineColor);
+        
+        // Oldest to newest, in two ranges when the live points wrap
+        size_t count = ring.size();
+        size_t cap = ring.capacity();
+        size_t first = ring.slotOf(0);
+        if (first + count <= cap) {
+            glDrawArrays(GL_LINE_STRIP, (GLint)first, (GLsizei)count);
+        } else {
+            glDrawArrays(GL_LINE_STRIP, (GLint)first, (GLsizei)(cap - first + 1));
+            glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)(count - (cap - first)));
+        }
     }
     
-    // Determine spacing for objects along trajectory
+    // Objects at evenly spaced times along the recent path, from the finest level
     const int maxObjectsToShow = 10;
-    int stepSize = std::max(1, (int)trajectoryPoints.size() / maxObjectsToShow);
+    const TrajectoryRing& fine = trajectory.level(0);
+    float newest = fine.time(fine.size() - 1);
     
     // Draw objects along the trajectory
     float baseSize = BALL_SIZE * 0.6f;
     
-    for (size_t i = 0; i < trajectoryPoints.size(); i += stepSize) {
-        if (i == 0 || i >= trajectoryPoints.size() - 1) continue;
+    for (int k = 1; k < maxObjectsToShow; k++) {
+        // For strobe effect, only show a few objects at wider intervals
+        if (trajectoryMode == STROBE && k % 2 != 0) {
+            continue;
+        }
         
-        vec2 pos = trajectoryPoints[i].position;
-        float timeFactor = (float)i / trajectoryPoints.size();
+        vec2 pos;
+        float t = newest - TRAJECTORY_GHOST_SECONDS * k / maxObjectsToShow;
+        if (!trajectoryPositionAt(fine, t, pos)) break;
+        float timeFactor = 1.0f - (float)k / maxObjectsToShow;
         float objSize = baseSize * (0.5f + 0.5f * (1.0f - timeFactor));
         
         vec4 objColor;
@@ -281,14 +315,109 @@ static void drawTrajectory() {
             objColor.w = 0.5f + 0.5f * timeFactor;
         }
         
-        // For strobe effect, only show a few objects at wider intervals
-        if (trajectoryMode == STROBE && i % (stepSize * 2) != 0) {
-            continue;
-        }
-        
         // Draw the object at this trajectory point
-        drawObject(currentObject, pos, objSize, objColor, true);
+        drawObjectWorld(currentObject, pos, objSize, objColor, true);
+    }
+}
+
+static unsigned gpuSceneVersion = 0;
+static GLsizei gpuSceneVertices = 0;
+
+// Sides of the polygon a scene circle is outlined with
+static const int SCENE_CIRCLE_SIDES = 24;
+
+/**
+ * Draws the level segments and circle outlines as lines, uploading them
+ * again only when the level changed
+ */
+static void drawSceneGeometry() {
+    if (sceneGeometry.empty()) return;
+    
+    glState.bindVertexArray(vaoScene);
+    glState.bindBuffer(GL_ARRAY_BUFFER, vboScene);
+    if (gpuSceneVersion != sceneVersion) {
+        const std::vector<SceneSegment>& segments = sceneGeometry.getSegments();
+        const std::vector<SceneCircle>& circles = sceneGeometry.getCircles();
+        std::vector<vec4> lines;
+        lines.reserve(2 * (segments.size() + circles.size() * SCENE_CIRCLE_SIDES));
+        for (size_t i = 0; i < segments.size(); i++) {
+            vec2 a = screenToWorld(segments[i].ax, segments[i].ay);
+            vec2 b = screenToWorld(segments[i].bx, segments[i].by);
+            lines.push_back(vec4(a.x, a.y, 0.0f, 1.0f));
+            lines.push_back(vec4(b.x, b.y, 0.0f, 1.0f));
+        }
+        for (size_t i = 0; i < circles.size(); i++) {
+            const SceneCircle& c = circles[i];
+            for (int k = 0; k < SCENE_CIRCLE_SIDES; k++) {
+                float a0 = 6.28318f * k / SCENE_CIRCLE_SIDES, a1 = 6.28318f * (k + 1) / SCENE_CIRCLE_SIDES;
+                vec2 p0 = screenToWorld(c.x + c.radius * cos(a0), c.y + c.radius * sin(a0));
+                vec2 p1 = screenToWorld(c.x + c.radius * cos(a1), c.y + c.radius * sin(a1));
+                lines.push_back(vec4(p0.x, p0.y, 0.0f, 1.0f));
+                lines.push_back(vec4(p1.x, p1.y, 0.0f, 1.0f));
+            }
+        }
+        glBufferData(GL_ARRAY_BUFFER, lines.size() * sizeof(vec4), lines.data(), GL_STATIC_DRAW);
+        gpuSceneVersion = sceneVersion;
+        gpuSceneVertices = (GLsizei)lines.size();
+    }
+    
+    // Zoomed like the objects that bounce off it
+    mat4 model = Scale(zoomScale, zoomScale, zoomScale);
+    currentProgram->use();
+    currentProgram->set(UNIFORM_MODEL, model);
+    glVertexAttrib3f(currentProgram->attributeLocation(ATTRIBUTE_NORMAL), 0.0f, 0.0f, 1.0f);
+    glState.lineWidth(2.0f);
+    currentProgram->set(UNIFORM_OBJ_COLOR, vec4(0.8f, 0.8f, 0.8f, 1.0f));
+    glDrawArrays(GL_LINES, 0, gpuSceneVertices);
+}
+
+/**
+ * Draws every multi-object ball with one instanced draw per mesh type
+ */
+static void drawBalls() {
+    if (balls.empty()) return;
+    
+    // Window pixels to the zoomed world plane; screenToWorld is linear
+    vec2 origin = screenToWorld(0.0f, 0.0f);
+    vec2 step = screenToWorld(1.0f, 1.0f) - origin;
+    ballRenderer.upload(balls, renderAlpha, origin * zoomScale, step * zoomScale, zoomScale * objectScale * 0.01f);
+    
+    instancedProgram.use();
+    setPolygonMode(2.0f);
+    if (currentRenderMode == TEXTURE_MODE) {
+        glState.activeTexture(GL_TEXTURE0);
+        glState.bindTexture(GL_TEXTURE_2D, texID);
+        instancedProgram.set(UNIFORM_USE_TEXTURE, 1);
+    } else {
+        instancedProgram.set(UNIFORM_USE_TEXTURE, 0);
     }
+    
+    const ObjectType types[3] = { CUBE, SPHERE, BUNNY };
+    for (int t = 0; t < 3; t++) {
+        if (ballRenderer.instanceCount(types[t]) == 0) continue;
+        instancedProgram.set(UNIFORM_MODEL, meshOrientation(types[t]));
+        ballRenderer.draw(types[t]);
+    }
+}
+
+/**
+ * Draws every live particle as a soft round sprite in one draw call. They
+ * blend over everything drawn so far, so depth testing is off meanwhile.
+ */
+static void drawParticles() {
+    if (particles.empty()) return;
+    
+    // Window pixels to the zoomed world plane, as for the balls; a
+    // particle's size is in pixels across
+    vec2 origin = screenToWorld(0.0f, 0.0f);
+    vec2 step = screenToWorld(1.0f, 1.0f) - origin;
+    if (particleRenderer.upload(particles, origin * zoomScale, step * zoomScale, step.x * zoomScale) == 0) return;
+    
+    particleProgram.use();
+    glState.setEnabled(GL_PROGRAM_POINT_SIZE, true);
+    glState.setEnabled(GL_DEPTH_TEST, false);
+    particleRenderer.draw();
+    glState.setEnabled(GL_DEPTH_TEST, true);
 }
 
 /**
@@ -299,19 +428,44 @@ void display() {
     glClearColor(backgroundColor.x, backgroundColor.y, backgroundColor.z, backgroundColor.w);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
+    // Light and material for the whole frame, shared by every program;
+    // only what changed since last frame is uploaded or rebound
+    uniformBlocks.setLight(vec3(0.5f, 1.0f, 0.75f), lightFollowsObject, useAmbient, useDiffuse, useSpecular);
+    uniformBlocks.bind(useMetallic);
+    
     // Draw grid first (if enabled)
     drawGrid();
     
     // Then draw trajectory objects
     drawTrajectory();
     
+    // Static obstacles
+    for (size_t i = 0; i < obstacles.size(); i++)
+        drawObject(obstacles[i].type, vec2(obstacles[i].x, obstacles[i].y), obstacles[i].size,
+                   vec4(0.6f, 0.6f, 0.6f, 1.0f));
+    
+    // Level loaded from the scene file
+    drawSceneGeometry();
+    
+    // Multi-object balls
+    if (multipleObjects)
+        drawBalls();
+    
+    // Bounce particles
+    if (showParticles)
+        drawParticles();
+    
     // Then draw the main object
     vec4 mainColor = colorPalette[currentColorIndex];
     if (rainbowMode) {
         mainColor = getRainbowColor(currentTime * 0.3f);
     }
     
-    drawObject(currentObject, vec2(xPos, yPos), BALL_SIZE, mainColor);
+    // Interpolate between the last two physics states
+    vec2 renderPos(prevXPos + (xPos - prevXPos) * renderAlpha,
+                   prevYPos + (yPos - prevYPos) * renderAlpha);
+    
+    drawObject(currentObject, renderPos, BALL_SIZE, mainColor);
     
     glFlush();
 }
\ No newline at end of file
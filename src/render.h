@@ -4,4 +4,7 @@
 #include "Angel.h"
 void display();
 
+// Map window pixel coordinates to the world plane the scene is drawn in
+vec2 screenToWorld(float screenX, float screenY);
+
 #endif
@@ -0,0 +1,54 @@
+#include "rng.h"
+#include "checkpoint.h"
+
+/**
+ * splitmix64 step, used to spread a seed over the generator state
+ */
+static uint64_t splitMix(uint64_t& x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Derive the four state words of stream `stream` of `seed`.
+ * The stream id is mixed in before expansion, so neighbouring streams
+ * start from unrelated states.
+ */
+static void seedState(uint64_t seed, uint64_t stream, uint32_t state[4]) {
+    uint64_t x = seed;
+    uint64_t key = splitMix(x) ^ stream;
+    uint64_t a = splitMix(key);
+    uint64_t b = splitMix(key);
+    state[0] = (uint32_t)a;
+    state[1] = (uint32_t)(a >> 32);
+    state[2] = (uint32_t)b;
+    state[3] = (uint32_t)(b >> 32);
+
+    // The all-zero state is the one fixed point of the generator
+    if ((state[0] | state[1] | state[2] | state[3]) == 0) state[0] = 1;
+}
+
+void Rng::reseed(uint64_t seed, uint64_t stream) {
+    seedState(seed, stream, s);
+}
+
+void Rng::fillUniform(float* out, size_t n, float lo, float hi) {
+    float scale = (hi - lo) * (1.0f / 16777216.0f);
+    for (size_t i = 0; i < n; i++)
+        out[i] = lo + (next() >> 8) * scale;
+}
+
+void Rng::save(SnapshotWriter& out) const {
+    out.array(s, 4);
+}
+
+bool Rng::load(SnapshotReader& in) {
+    uint32_t saved[4];
+    in.array(saved, 4);
+    if (!in.good() || (saved[0] | saved[1] | saved[2] | saved[3]) == 0) return false;
+    for (int i = 0; i < 4; i++)
+        s[i] = saved[i];
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstddef>
+#include <cstdint>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+/**
+ * xoshiro128** generator: 128 bits of state, no locks, and a few
+ * integer ops per 32-bit output. A (seed, stream) pair always gives the
+ * same sequence, and different streams of one seed are independent, so
+ * each thread can own a stream and runs stay reproducible.
+ */
+class Rng {
+public:
+    explicit Rng(uint64_t seed = 1, uint64_t stream = 0) { reseed(seed, stream); }
+
+    void reseed(uint64_t seed, uint64_t stream = 0);
+
+    uint32_t next() {
+        uint32_t result = rotl(s[1] * 5, 7) * 9;
+        uint32_t t = s[1] << 9;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 11);
+        return result;
+    }
+
+    // Uniform integer in [0, n) by multiply-shift (no division)
+    uint32_t below(uint32_t n) { return (uint32_t)(((uint64_t)next() * n) >> 32); }
+
+    // Uniform float in [0, 1) from the top 24 bits
+    float uniform() { return (next() >> 8) * (1.0f / 16777216.0f); }
+
+    float uniform(float lo, float hi) { return lo + (hi - lo) * uniform(); }
+
+    // Fill out[0, n) with uniform floats in [lo, hi)
+    void fillUniform(float* out, size_t n, float lo, float hi);
+
+    // Append the generator state to a checkpoint (see checkpoint.h)
+    void save(SnapshotWriter& out) const;
+
+    // Continue from a state saved by save; false (state unchanged) if the section is malformed
+    bool load(SnapshotReader& in);
+
+private:
+    static uint32_t rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+    uint32_t s[4];
+};
+
+#endif
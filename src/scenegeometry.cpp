@@ -0,0 +1,344 @@
+#include "scenegeometry.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Balls handed to a worker at a time
+static const size_t SCENE_CHUNK = 1024;
+
+// Upper bound on grid cells; larger levels get coarser cells
+static const size_t MAX_SCENE_CELLS = 1 << 22;
+
+void SceneGeometry::clear() {
+    segments.clear();
+    circles.clear();
+    columns = rows = 0;
+    cellStart.clear();
+    cellItems.clear();
+}
+
+void SceneGeometry::addSegment(float ax, float ay, float bx, float by) {
+    SceneSegment s = { ax, ay, bx, by };
+    segments.push_back(s);
+}
+
+void SceneGeometry::addCircle(float x, float y, float radius) {
+    SceneCircle c = { x, y, radius };
+    circles.push_back(c);
+}
+
+void SceneGeometry::addPolygon(const float* points, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        size_t j = (i + 1) % count;
+        addSegment(points[2 * i], points[2 * i + 1], points[2 * j], points[2 * j + 1]);
+    }
+}
+
+bool SceneGeometry::load(const char* path, float width, float height) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open scene " << path << std::endl;
+        return false;
+    }
+
+    SceneGeometry loaded;
+    float scaleX = 1.0f, scaleY = 1.0f;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        std::istringstream in(line);
+        std::string shape;
+        if (!(in >> shape)) continue;
+
+        std::vector<float> values;
+        float v;
+        while (in >> v) values.push_back(v);
+        bool trailing = !in.eof();
+
+        // Points are scaled as they are read; the arena line must come first to apply
+        bool ok = !trailing;
+        if (shape == "arena") {
+            ok = ok && values.size() == 2 && values[0] > 0.0f && values[1] > 0.0f;
+            if (ok && width > 0.0f && height > 0.0f) {
+                scaleX = width / values[0];
+                scaleY = height / values[1];
+            }
+        } else if (shape == "segment") {
+            ok = ok && values.size() == 4;
+            if (ok) loaded.addSegment(values[0] * scaleX, values[1] * scaleY, values[2] * scaleX, values[3] * scaleY);
+        } else if (shape == "polyline" || shape == "polygon") {
+            size_t minimum = shape == "polygon" ? 6 : 4;
+            ok = ok && values.size() >= minimum && values.size() % 2 == 0;
+            for (size_t k = 0; ok && k < values.size(); k += 2) {
+                values[k] *= scaleX;
+                values[k + 1] *= scaleY;
+            }
+            if (ok && shape == "polygon") {
+                loaded.addPolygon(values.data(), values.size() / 2);
+            } else if (ok) {
+                for (size_t k = 2; k < values.size(); k += 2)
+                    loaded.addSegment(values[k - 2], values[k - 1], values[k], values[k + 1]);
+            }
+        } else if (shape == "circle") {
+            ok = ok && values.size() == 3 && values[2] > 0.0f;
+            // Circles stay round under an uneven scale
+            if (ok) loaded.addCircle(values[0] * scaleX, values[1] * scaleY, values[2] * std::sqrt(scaleX * scaleY));
+        } else {
+            std::cerr << path << ":" << lineNumber << ": unknown shape '" << shape << "'" << std::endl;
+            return false;
+        }
+        if (!ok) {
+            std::cerr << path << ":" << lineNumber << ": bad " << shape << " line" << std::endl;
+            return false;
+        }
+    }
+
+    segments.swap(loaded.segments);
+    circles.swap(loaded.circles);
+    build();
+    return true;
+}
+
+void SceneGeometry::cellRange(float minX, float minY, float maxX, float maxY, int32_t& x0, int32_t& y0,
+                              int32_t& x1, int32_t& y1) const {
+    // Clamped in float first, so far-away points cannot overflow the conversion
+    float lastX = (float)(columns - 1), lastY = (float)(rows - 1);
+    x0 = (int32_t)std::min(std::max(std::floor((minX - originX) * invCellSize), 0.0f), lastX);
+    y0 = (int32_t)std::min(std::max(std::floor((minY - originY) * invCellSize), 0.0f), lastY);
+    x1 = (int32_t)std::min(std::max(std::floor((maxX - originX) * invCellSize), -1.0f), lastX);
+    y1 = (int32_t)std::min(std::max(std::floor((maxY - originY) * invCellSize), -1.0f), lastY);
+    if (maxX < originX || minX > originX + columns * cellSize) x1 = x0 - 1;
+    if (maxY < originY || minY > originY + rows * cellSize) y1 = y0 - 1;
+}
+
+template <typename Fn>
+void SceneGeometry::visitCells(uint32_t id, Fn fn) const {
+    int32_t x0, y0, x1, y1;
+    if (id < segments.size()) {
+        const SceneSegment& s = segments[id];
+        cellRange(std::min(s.ax, s.bx), std::min(s.ay, s.by), std::max(s.ax, s.bx), std::max(s.ay, s.by), x0, y0,
+                  x1, y1);
+        float ex = s.bx - s.ax, ey = s.by - s.ay;
+        for (int32_t cy = y0; cy <= y1; cy++) {
+            for (int32_t cx = x0; cx <= x1; cx++) {
+                // Inside the segment's box, it crosses the cell unless all corners lie on one side of it
+                float left = originX + cx * cellSize, top = originY + cy * cellSize;
+                int above = 0, below = 0;
+                for (int corner = 0; corner < 4; corner++) {
+                    float px = left + (corner & 1) * cellSize - s.ax;
+                    float py = top + (corner >> 1) * cellSize - s.ay;
+                    float side = ex * py - ey * px;
+                    above += side > 0.0f;
+                    below += side < 0.0f;
+                }
+                if (above < 4 && below < 4) fn((uint32_t)(cy * columns + cx));
+            }
+        }
+        return;
+    }
+
+    const SceneCircle& c = circles[id - segments.size()];
+    cellRange(c.x - c.radius, c.y - c.radius, c.x + c.radius, c.y + c.radius, x0, y0, x1, y1);
+    for (int32_t cy = y0; cy <= y1; cy++) {
+        for (int32_t cx = x0; cx <= x1; cx++) {
+            float left = originX + cx * cellSize, top = originY + cy * cellSize;
+            float dx = std::max(std::max(left - c.x, c.x - (left + cellSize)), 0.0f);
+            float dy = std::max(std::max(top - c.y, c.y - (top + cellSize)), 0.0f);
+            if (dx * dx + dy * dy <= c.radius * c.radius) fn((uint32_t)(cy * columns + cx));
+        }
+    }
+}
+
+void SceneGeometry::build(float size) {
+    columns = rows = 0;
+    cellStart.clear();
+    cellItems.clear();
+    if (empty()) return;
+
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+    for (size_t i = 0; i < segments.size(); i++) {
+        const SceneSegment& s = segments[i];
+        minX = std::min(minX, std::min(s.ax, s.bx));
+        minY = std::min(minY, std::min(s.ay, s.by));
+        maxX = std::max(maxX, std::max(s.ax, s.bx));
+        maxY = std::max(maxY, std::max(s.ay, s.by));
+    }
+    for (size_t i = 0; i < circles.size(); i++) {
+        const SceneCircle& c = circles[i];
+        minX = std::min(minX, c.x - c.radius);
+        minY = std::min(minY, c.y - c.radius);
+        maxX = std::max(maxX, c.x + c.radius);
+        maxY = std::max(maxY, c.y + c.radius);
+    }
+    float spanX = std::max(maxX - minX, 1.0f), spanY = std::max(maxY - minY, 1.0f);
+
+    // About one collider per cell unless the caller knows better
+    size_t colliders = segments.size() + circles.size();
+    if (!(size > 0.0f)) size = std::sqrt(spanX * spanY / colliders);
+    size = std::max(size, 1.0f);
+    while ((size_t)(spanX / size + 1.0f) * (size_t)(spanY / size + 1.0f) > MAX_SCENE_CELLS)
+        size *= 2.0f;
+
+    originX = minX;
+    originY = minY;
+    cellSize = size;
+    invCellSize = 1.0f / size;
+    columns = (int32_t)(spanX / size) + 1;
+    rows = (int32_t)(spanY / size) + 1;
+
+    // Count, prefix sum, scatter, as in SpatialGrid::build
+    size_t cells = cellCount();
+    cellStart.assign(cells + 1, 0);
+    for (uint32_t id = 0; id < colliders; id++)
+        visitCells(id, [&](uint32_t cell) { cellStart[cell + 1]++; });
+    for (size_t c = 0; c < cells; c++)
+        cellStart[c + 1] += cellStart[c];
+    cellItems.resize(cellStart[cells]);
+    cellCounts.assign(cellStart.begin(), cellStart.end() - 1);
+    for (uint32_t id = 0; id < colliders; id++)
+        visitCells(id, [&](uint32_t cell) { cellItems[cellCounts[cell]++] = id; });
+    cellCounts.clear();
+}
+
+size_t SceneGeometry::collideOne(float& x, float& y, float& vx, float& vy, float prevX, float prevY, float radius,
+                                 float restitution, std::vector<uint32_t>& candidates) const {
+    if (columns == 0) return 0;
+
+    // Colliders under the ball's path this step, each once, in id order
+    int32_t x0, y0, x1, y1;
+    cellRange(std::min(x, prevX) - radius, std::min(y, prevY) - radius, std::max(x, prevX) + radius,
+              std::max(y, prevY) + radius, x0, y0, x1, y1);
+    candidates.clear();
+    for (int32_t cy = y0; cy <= y1; cy++) {
+        for (int32_t cx = x0; cx <= x1; cx++) {
+            uint32_t cell = (uint32_t)(cy * columns + cx);
+            candidates.insert(candidates.end(), cellItems.begin() + cellStart[cell],
+                              cellItems.begin() + cellStart[cell + 1]);
+        }
+    }
+    if (candidates.empty()) return 0;
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    size_t found = 0;
+    for (size_t k = 0; k < candidates.size(); k++) {
+        uint32_t id = candidates[k];
+        float nx, ny, depth;
+        if (id < segments.size()) {
+            const SceneSegment& s = segments[id];
+            float ex = s.bx - s.ax, ey = s.by - s.ay;
+            float lengthSq = ex * ex + ey * ey;
+            float length = std::sqrt(lengthSq);
+            float before = ex * (prevY - s.ay) - ey * (prevX - s.ax);
+            float after = ex * (y - s.ay) - ey * (x - s.ax);
+
+            // Did the centre cross the segment itself during the step?
+            bool crossed = false;
+            if (length > 0.0f && ((before > 0.0f && after < 0.0f) || (before < 0.0f && after > 0.0f))) {
+                float u = before / (before - after);
+                float hitX = prevX + (x - prevX) * u - s.ax, hitY = prevY + (y - prevY) * u - s.ay;
+                float t = (hitX * ex + hitY * ey) / lengthSq;
+                crossed = t >= 0.0f && t <= 1.0f;
+            }
+            if (crossed) {
+                // Back to the side it came from, one radius clear of the line
+                float sign = before > 0.0f ? 1.0f : -1.0f;
+                nx = -ey / length * sign;
+                ny = ex / length * sign;
+                depth = radius + std::fabs(after) / length;
+            } else {
+                float t = lengthSq > 0.0f ? ((x - s.ax) * ex + (y - s.ay) * ey) / lengthSq : 0.0f;
+                t = std::min(std::max(t, 0.0f), 1.0f);
+                float dx = x - (s.ax + ex * t), dy = y - (s.ay + ey * t);
+                float distSq = dx * dx + dy * dy;
+                if (distSq >= radius * radius) continue;
+                float dist = std::sqrt(distSq);
+                if (dist > 1e-6f) {
+                    nx = dx / dist;
+                    ny = dy / dist;
+                } else if (length > 0.0f) {
+                    // Centre on the line: out on the side it came from
+                    float sign = before < 0.0f ? -1.0f : 1.0f;
+                    nx = -ey / length * sign;
+                    ny = ex / length * sign;
+                } else {
+                    nx = 0.0f;
+                    ny = -1.0f;
+                }
+                depth = radius - dist;
+            }
+        } else {
+            const SceneCircle& c = circles[id - segments.size()];
+            float dx = x - c.x, dy = y - c.y;
+            float minDist = radius + c.radius;
+            float distSq = dx * dx + dy * dy;
+            if (distSq >= minDist * minDist) continue;
+            float dist = std::sqrt(distSq);
+            if (dist > 1e-6f) {
+                nx = dx / dist;
+                ny = dy / dist;
+            } else {
+                nx = 0.0f;
+                ny = -1.0f;
+            }
+            depth = minDist - dist;
+        }
+
+        x += nx * depth;
+        y += ny * depth;
+        float vn = vx * nx + vy * ny;
+        if (vn < 0.0f) {
+            vx -= (1.0f + restitution) * vn * nx;
+            vy -= (1.0f + restitution) * vn * ny;
+        }
+        found++;
+    }
+    return found;
+}
+
+size_t SceneGeometry::collideSphere(float& x, float& y, float& vx, float& vy, float prevX, float prevY,
+                                   float radius, float restitution) const {
+    std::vector<uint32_t> candidates;
+    return collideOne(x, y, vx, vy, prevX, prevY, radius, restitution, candidates);
+}
+
+size_t SceneGeometry::collideBalls(BallStore& balls, float restitution, ThreadPool* pool) const {
+    size_t awake = balls.getAwakeCount();
+    if (empty() || awake == 0) return 0;
+
+    float* px = balls.x.data();
+    float* py = balls.y.data();
+    float* pvx = balls.vx.data();
+    float* pvy = balls.vy.data();
+    const float* prevX = balls.prevX.data();
+    const float* prevY = balls.prevY.data();
+    const float* radius = balls.size.data();
+    uint8_t* flags = balls.flags.data();
+
+    std::atomic<size_t> contacts(0);
+    ThreadPool::RangeFn collideRange = [&](size_t begin, size_t end, unsigned) {
+        std::vector<uint32_t> candidates;
+        size_t found = 0;
+        for (size_t i = begin; i < end; i++) {
+            size_t hits = collideOne(px[i], py[i], pvx[i], pvy[i], prevX[i], prevY[i], radius[i], restitution,
+                                     candidates);
+            if (hits) flags[i] |= BALL_CONTACT;
+            found += hits;
+        }
+        contacts += found;
+    };
+
+    if (pool && awake > SCENE_CHUNK)
+        pool->parallelFor(awake, SCENE_CHUNK, collideRange);
+    else
+        collideRange(0, awake, 0);
+    return contacts;
+}
@@ -0,0 +1,114 @@
+#ifndef SCENEGEOMETRY_H
+#define SCENEGEOMETRY_H
+
+#include "ballstore.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Thin two-sided wall from (ax, ay) to (bx, by), in arena pixels
+struct SceneSegment {
+    float ax, ay, bx, by;
+};
+
+// Solid disc, in arena pixels
+struct SceneCircle {
+    float x, y, radius;
+};
+
+/**
+ * Static level geometry: line segments (polygon outlines are stored as
+ * their edges) and circles, loaded from a scene file.
+ *
+ * After build() the colliders are binned into a uniform grid over their
+ * bounds. Each segment is listed only in the cells it actually crosses,
+ * so a ball looks at the colliders in the few cells under its own
+ * bounding box and the cost per ball hardly depends on the size of the
+ * level.
+ *
+ * Scene files are plain text, one shape per line, '#' starts a comment:
+ *
+ *     arena W H                       Size the coordinates were laid out for
+ *     segment X0 Y0 X1 Y1
+ *     polyline X0 Y0 X1 Y1 ...        Open chain of segments
+ *     polygon X0 Y0 X1 Y1 X2 Y2 ...   Closed outline
+ *     circle X Y R
+ *
+ * Coordinates are in pixels with y pointing down, as for balls.
+ */
+class SceneGeometry {
+public:
+    SceneGeometry() : originX(0.0f), originY(0.0f), cellSize(1.0f), invCellSize(1.0f), columns(0), rows(0) {}
+
+    void clear();
+    void addSegment(float ax, float ay, float bx, float by);
+    void addCircle(float x, float y, float radius);
+
+    // Closed outline through count points given as x, y pairs
+    void addPolygon(const float* points, size_t count);
+
+    /**
+     * Replace the geometry with the shapes in path and build the grid.
+     * When the file declares an arena and width and height are positive,
+     * coordinates are scaled from the declared arena to width x height.
+     * Errors are reported on stderr with their line number.
+     *
+     * @return false if the file cannot be read or has a malformed line
+     */
+    bool load(const char* path, float width = 0.0f, float height = 0.0f);
+
+    /**
+     * Bin the colliders into the grid. cellSize 0 picks a size from the
+     * bounds that gives a few colliders per cell.
+     */
+    void build(float cellSize = 0.0f);
+
+    bool empty() const { return segments.empty() && circles.empty(); }
+    const std::vector<SceneSegment>& getSegments() const { return segments; }
+    const std::vector<SceneCircle>& getCircles() const { return circles; }
+    size_t cellCount() const { return (size_t)columns * rows; }
+
+    /**
+     * Push one ball of the given radius out of the colliders it touches
+     * and reflect its velocity with restitution. A ball whose centre
+     * crossed a segment since (prevX, prevY) is put back on the side it
+     * came from, so thin walls stop fast balls.
+     *
+     * @return Number of contacts
+     */
+    size_t collideSphere(float& x, float& y, float& vx, float& vy, float prevX, float prevY, float radius,
+                         float restitution) const;
+
+    /**
+     * collideSphere for every awake ball, from its position at the start
+     * of the step. Balls in contact get BALL_CONTACT, so they can settle
+     * on ledges. Runs across pool when it is not null.
+     *
+     * @return Number of ball-collider contacts
+     */
+    size_t collideBalls(BallStore& balls, float restitution, ThreadPool* pool) const;
+
+private:
+    // Call fn(cell) for every grid cell collider id overlaps
+    template <typename Fn>
+    void visitCells(uint32_t id, Fn fn) const;
+    void cellRange(float minX, float minY, float maxX, float maxY, int32_t& x0, int32_t& y0, int32_t& x1,
+                   int32_t& y1) const;
+    size_t collideOne(float& x, float& y, float& vx, float& vy, float prevX, float prevY, float radius,
+                      float restitution, std::vector<uint32_t>& candidates) const;
+
+    std::vector<SceneSegment> segments;
+    std::vector<SceneCircle> circles;
+
+    // Collider ids (segments first, then circles) per cell, row-major
+    float originX, originY;
+    float cellSize, invCellSize;
+    int32_t columns, rows;
+    std::vector<uint32_t> cellStart;  // Cell c lists cellItems[cellStart[c], cellStart[c + 1])
+    std::vector<uint32_t> cellItems;
+    std::vector<uint32_t> cellCounts; // Build scratch
+};
+
+#endif
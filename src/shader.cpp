@@ -1,2 +1,119 @@
 #include "shader.h"
-// Additional shader wrapper code can go here if desired.
+#include "InitShader.h"
+#include "glstate.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+// GLSL names of ShaderUniform, UniformBlock and ShaderAttribute, in enum order
+static const char* const UNIFORM_NAMES[UNIFORM_COUNT] = {
+    "model", "objColor", "useTexture", "textureMap"
+};
+static const char* const BLOCK_NAMES[BLOCK_COUNT] = {
+    "Camera", "Light", "Material"
+};
+static const char* const ATTRIBUTE_NAMES[ATTRIBUTE_COUNT] = {
+    "vPosition", "vNormal", "vTexCoord", "iPlacement", "iColor", "pParticle", "pColor"
+};
+
+ShaderProgram::ShaderProgram() : program(0) {
+    for (int u = 0; u < UNIFORM_COUNT; u++) uniforms[u].location = -1;
+    for (int a = 0; a < ATTRIBUTE_COUNT; a++) attributes[a] = -1;
+    forget();
+}
+
+void ShaderProgram::load(const char* vertexFile, const char* fragmentFile) {
+    adopt(Angel::InitShader(vertexFile, fragmentFile));
+}
+
+/**
+ * Walk the program's active uniforms and attributes once and record the
+ * location of every one the tables know by name, then bind its uniform
+ * blocks. GLSL 4.10 has no binding layout qualifier, so that is done here.
+ */
+void ShaderProgram::adopt(GLuint linkedProgram) {
+    program = linkedProgram;
+    for (int u = 0; u < UNIFORM_COUNT; u++) uniforms[u].location = -1;
+    for (int a = 0; a < ATTRIBUTE_COUNT; a++) attributes[a] = -1;
+    forget();
+
+    GLint count = 0, longest = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &longest);
+    std::string name(std::max(longest, 1), '\0');
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+        for (int u = 0; u < UNIFORM_COUNT; u++) {
+            if (strcmp(name.c_str(), UNIFORM_NAMES[u]) == 0)
+                uniforms[u].location = glGetUniformLocation(program, name.c_str());
+        }
+    }
+
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &longest);
+    name.assign(std::max(longest, 1), '\0');
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveAttrib(program, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+        for (int a = 0; a < ATTRIBUTE_COUNT; a++) {
+            if (strcmp(name.c_str(), ATTRIBUTE_NAMES[a]) == 0)
+                attributes[a] = glGetAttribLocation(program, name.c_str());
+        }
+    }
+
+    for (int b = 0; b < BLOCK_COUNT; b++) {
+        GLuint index = glGetUniformBlockIndex(program, BLOCK_NAMES[b]);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, (GLuint)b);
+    }
+}
+
+void ShaderProgram::use() const {
+    glState.useProgram(program);
+}
+
+void ShaderProgram::forget() {
+    for (int u = 0; u < UNIFORM_COUNT; u++) uniforms[u].known = false;
+}
+
+bool ShaderProgram::update(ShaderUniform u, const void* data, size_t bytes) {
+    Uniform& slot = uniforms[u];
+    if (slot.location < 0) return false;
+    if (slot.known && memcmp(slot.value, data, bytes) == 0) return false;
+    memcpy(slot.value, data, bytes);
+    slot.known = true;
+    return true;
+}
+
+void ShaderProgram::set(ShaderUniform u, int value) {
+    if (update(u, &value, sizeof(value)))
+        glUniform1i(uniforms[u].location, value);
+}
+
+void ShaderProgram::set(ShaderUniform u, float value) {
+    if (update(u, &value, sizeof(value)))
+        glUniform1f(uniforms[u].location, value);
+}
+
+void ShaderProgram::set(ShaderUniform u, const vec3& value) {
+    const GLfloat* data = value;
+    if (update(u, data, 3 * sizeof(GLfloat)))
+        glUniform3fv(uniforms[u].location, 1, data);
+}
+
+void ShaderProgram::set(ShaderUniform u, const vec4& value) {
+    const GLfloat* data = value;
+    if (update(u, data, 4 * sizeof(GLfloat)))
+        glUniform4fv(uniforms[u].location, 1, data);
+}
+
+void ShaderProgram::set(ShaderUniform u, const mat4& value) {
+    const GLfloat* data = value;
+    if (update(u, data, 16 * sizeof(GLfloat)))
+        glUniformMatrix4fv(uniforms[u].location, 1, GL_TRUE, data);
+}
@@ -1,4 +1,93 @@
 #ifndef SHADER_H
 #define SHADER_H
 #include "Angel.h"
+
+// Uniforms the viewer's shaders declare; a program without one ignores it
+enum ShaderUniform {
+    UNIFORM_MODEL,
+    UNIFORM_OBJ_COLOR,
+    UNIFORM_USE_TEXTURE,
+    UNIFORM_TEXTURE_MAP,
+    UNIFORM_COUNT
+};
+
+// Uniform blocks the viewer's shaders declare, shared by every program
+// (see uniformblocks.h). Each block is bound to the binding point of its
+// enum value.
+enum UniformBlock {
+    BLOCK_CAMERA,
+    BLOCK_LIGHT,
+    BLOCK_MATERIAL,
+    BLOCK_COUNT
+};
+
+// Vertex attributes the viewer's shaders declare
+enum ShaderAttribute {
+    ATTRIBUTE_POSITION,
+    ATTRIBUTE_NORMAL,
+    ATTRIBUTE_TEX_COORD,
+    ATTRIBUTE_INSTANCE_PLACEMENT,  // Per-instance attributes of vshader_instanced.glsl
+    ATTRIBUTE_INSTANCE_COLOR,
+    ATTRIBUTE_PARTICLE,            // Per-particle attributes of vshader_particles.glsl
+    ATTRIBUTE_PARTICLE_COLOR,
+    ATTRIBUTE_COUNT
+};
+
+/**
+ * Linked shader program with its uniform and attribute locations
+ * resolved once, when it is loaded, into tables indexed by ShaderUniform
+ * and ShaderAttribute, so drawing never looks a name up in the driver.
+ * The uniform blocks it declares are tied to their UniformBlock binding
+ * points at the same time.
+ *
+ * The last value set for each uniform is kept, and setting a uniform to
+ * the value it already holds sends nothing. Uniform values belong to the
+ * program, so the cache stays right across program switches as long as
+ * every write goes through set().
+ */
+class ShaderProgram {
+public:
+    ShaderProgram();
+
+    // Compile and link the two shader files (exits on errors, like InitShader)
+    void load(const char* vertexFile, const char* fragmentFile);
+
+    // Take over an already linked program and resolve its locations
+    void adopt(GLuint linkedProgram);
+
+    GLuint id() const { return program; }
+    void use() const;  // Through glState, so binding the bound program costs nothing
+
+    // -1 when the program has no active uniform or attribute of that name
+    GLint uniformLocation(ShaderUniform u) const { return uniforms[u].location; }
+    GLint attributeLocation(ShaderAttribute a) const { return attributes[a]; }
+
+    /**
+     * Set a uniform of this program, which must be the one in use.
+     * Matrices are row-major like Angel's mat4 and sent transposed.
+     */
+    void set(ShaderUniform u, int value);
+    void set(ShaderUniform u, float value);
+    void set(ShaderUniform u, const vec3& value);
+    void set(ShaderUniform u, const vec4& value);
+    void set(ShaderUniform u, const mat4& value);
+
+    // Drop the cached values, e.g. after uniforms were written behind set()'s back
+    void forget();
+
+private:
+    struct Uniform {
+        GLint location;
+        bool known;        // value holds what the program has
+        GLfloat value[16]; // Raw bits of the last value, ints included
+    };
+
+    // Copy bytes of data into the cache; false when they were there already
+    bool update(ShaderUniform u, const void* data, size_t bytes);
+
+    GLuint program;
+    Uniform uniforms[UNIFORM_COUNT];
+    GLint attributes[ATTRIBUTE_COUNT];
+};
+
 #endif
@@ -0,0 +1,86 @@
+#ifndef SIMDOPS_H
+#define SIMDOPS_H
+
+#include <cstdint>
+
+/**
+ * Thin wrappers over the widest float vector the target supports, so the
+ * SoA kernels are written once. HAVE_SIMD_OPS is left undefined when
+ * neither AVX nor SSE2 is available (e.g. ARM builds); kernels then use
+ * their scalar versions.
+ */
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+
+// 8-wide AVX operations used by the integration kernels
+struct SimdOps {
+    typedef __m256 V;
+    static const int WIDTH = 8;
+    static V set1(float f) { return _mm256_set1_ps(f); }
+    static V load(const float* p) { return _mm256_load_ps(p); }
+    static V loadUnaligned(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, V v) { _mm256_store_ps(p, v); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+    static V rsqrt(V a) { return _mm256_rsqrt_ps(a); }  // About 12 bits
+    static V min(V a, V b) { return _mm256_min_ps(a, b); }
+    static V max(V a, V b) { return _mm256_max_ps(a, b); }
+    static V gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static V lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static V ge(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static V eq(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static V loadInt(const int32_t* p) { return _mm256_cvtepi32_ps(_mm256_load_si256((const __m256i*)p)); }
+    static V bitOr(V a, V b) { return _mm256_or_ps(a, b); }
+    static V bitAnd(V a, V b) { return _mm256_and_ps(a, b); }
+    static V bitAndNot(V a, V b) { return _mm256_andnot_ps(a, b); }
+    static V bitXor(V a, V b) { return _mm256_xor_ps(a, b); }
+    static V select(V m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+    static int mask(V m) { return _mm256_movemask_ps(m); }
+};
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+// 4-wide SSE2 operations used by the integration kernels
+struct SimdOps {
+    typedef __m128 V;
+    static const int WIDTH = 4;
+    static V set1(float f) { return _mm_set1_ps(f); }
+    static V load(const float* p) { return _mm_load_ps(p); }
+    static V loadUnaligned(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, V v) { _mm_store_ps(p, v); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm_div_ps(a, b); }
+    static V sqrt(V a) { return _mm_sqrt_ps(a); }
+    static V rsqrt(V a) { return _mm_rsqrt_ps(a); }  // About 12 bits
+    static V min(V a, V b) { return _mm_min_ps(a, b); }
+    static V max(V a, V b) { return _mm_max_ps(a, b); }
+    static V gt(V a, V b) { return _mm_cmpgt_ps(a, b); }
+    static V lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+    static V ge(V a, V b) { return _mm_cmpge_ps(a, b); }
+    static V eq(V a, V b) { return _mm_cmpeq_ps(a, b); }
+    static V loadInt(const int32_t* p) { return _mm_cvtepi32_ps(_mm_load_si128((const __m128i*)p)); }
+    static V bitOr(V a, V b) { return _mm_or_ps(a, b); }
+    static V bitAnd(V a, V b) { return _mm_and_ps(a, b); }
+    static V bitAndNot(V a, V b) { return _mm_andnot_ps(a, b); }
+    static V bitXor(V a, V b) { return _mm_xor_ps(a, b); }
+    static V select(V m, V a, V b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static int mask(V m) { return _mm_movemask_ps(m); }
+};
+
+#endif
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#define HAVE_SIMD_OPS 1
+#endif
+
+#endif
@@ -0,0 +1,162 @@
+#include "simulation.h"
+#include "threadpool.h"
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+/**
+ * Physics constants that control simulation behavior
+ */
+const float GRAVITY = 0.35f;          // Gravitational acceleration
+const float RESTITUTION = 0.92f;      // Energy retention on bounce (1.0 = perfect bounce)
+const float BALL_SIZE = 60.0f;        // Base size of objects
+const float AIR_RESISTANCE = 0.998f;  // Air resistance factor (1.0 = no resistance)
+const float REFERENCE_HZ = 60.0f;     // Step rate the per-step constants above are tuned for
+
+void setupBallStep(BallStepParams& params, const SimSettings& settings, float dt, float now) {
+    // Velocities are in pixels per reference frame, so scale each
+    // per-step quantity by how many reference frames this step covers
+    float stepFrames = dt * REFERENCE_HZ;
+    params.gravity = settings.gravity * stepFrames;
+    params.airResistance = std::pow(settings.airResistance, stepFrames);
+    params.restitution = settings.restitution;
+    params.speed = settings.speed * stepFrames;
+    params.left = settings.width * 0.05f;
+    params.right = settings.width * 0.95f;
+    params.bottom = settings.height * 0.9f;  // 10% margin at the bottom
+    params.now = now;
+    params.maxLifetime = settings.maxLifetime;
+    params.restEnergy = settings.contactIterations > 0 ? 0.0f : 0.1f;
+    params.allowSleep = settings.allowSleep && settings.attraction == 0.0f;
+    params.contactIterations = settings.contactIterations;
+    params.attraction = settings.attraction * stepFrames;
+    params.openingAngle = settings.openingAngle;
+
+    params.extentX[SPHERE] = params.extentY[SPHERE] = 1.0f;
+    params.extentX[CUBE] = params.extentY[CUBE] = 0.5f;
+    params.extentX[BUNNY] = params.extentY[BUNNY] = 1.0f;
+}
+
+BallStepResult stepBalls(BallStore& balls, const BallStepParams& params, SpatialGrid* grid,
+                         const std::vector<MeshObstacle>& obstacles, ThreadPool* pool,
+                         const BounceFn& onBounce, PbdSolver* solver, BarnesHutTree* tree,
+                         const SceneGeometry* scene) {
+    BallStepResult result;
+    if (tree && params.attraction != 0.0f)
+        tree->attract(balls, params.attraction, params.openingAngle, pool);
+
+    std::atomic<size_t> bounces(0);
+    ThreadPool::RangeFn stepRange = [&](size_t begin, size_t end, unsigned worker) {
+        size_t found = integrateBallRange(balls, params, begin, end);
+        bounces += found;
+        if (!onBounce || found == 0) return;
+        for (size_t i = begin; i < end; i++) {
+            if (balls.flags[i] & BALL_BOUNCED) onBounce(i, worker);
+        }
+    };
+
+    size_t count = balls.getAwakeCount();
+    if (pool && count > SIM_CHUNK)
+        pool->parallelFor(count, SIM_CHUNK, stepRange);
+    else
+        stepRange(0, count, 0);
+    result.bounces = bounces;
+
+    if (grid && solver && params.contactIterations > 0)
+        result.contacts += solver->solve(balls, params, *grid, pool);
+    else if (grid)
+        result.contacts += collideBalls(balls, params, *grid);
+    if (!obstacles.empty())
+        result.contacts += collideBallsWithObstacles(balls, obstacles, params.restitution, pool);
+    if (scene && !scene->empty())
+        result.contacts += scene->collideBalls(balls, params.restitution, pool);
+
+    if (params.allowSleep)
+        updateSleep(balls, params, grid);
+    else
+        balls.wakeAll();
+
+    result.removed = removeExpiredBalls(balls);
+    if (params.allowSleep)
+        applySleep(balls, result);
+    return result;
+}
+
+void updateSleep(BallStore& balls, const BallStepParams& params, const SpatialGrid* grid) {
+    size_t n = balls.getCount();
+    size_t awake = balls.getAwakeCount();
+    uint8_t* flags = balls.flags.data();
+    uint8_t* restSteps = balls.restSteps.data();
+
+    // Awake balls count the steps they spend supported and nearly still
+    for (size_t i = 0; i < awake; i++) {
+        uint8_t f = flags[i];
+        float motion = std::fabs(balls.x[i] - balls.prevX[i]) + std::fabs(balls.y[i] - balls.prevY[i]);
+        if (!(f & BALL_EXPIRED) && (f & (BALL_BOUNCED | BALL_CONTACT)) && motion < SLEEP_MOTION) {
+            if (restSteps[i] < SLEEP_STEPS) restSteps[i]++;
+            if (restSteps[i] >= SLEEP_STEPS) f |= BALL_SLEEP;
+        } else {
+            restSteps[i] = 0;
+        }
+        flags[i] = f;
+    }
+
+    // Dormant balls stay put unless pushed hard enough; prevX/prevY hold their rest position
+    for (size_t i = awake; i < n; i++) {
+        uint8_t f = 0;
+        float push = std::fabs(balls.x[i] - balls.prevX[i]) + std::fabs(balls.y[i] - balls.prevY[i]);
+        float speed = std::fabs(balls.vx[i]) + std::fabs(balls.vy[i]);
+        if (params.now - balls.launchTime[i] > params.maxLifetime) {
+            f = BALL_EXPIRED;
+        } else if (push > WAKE_MOTION || speed > WAKE_SPEED) {
+            f = BALL_WAKE;
+        } else {
+            balls.x[i] = balls.prevX[i];
+            balls.y[i] = balls.prevY[i];
+            balls.vx[i] = 0.0f;
+            balls.vy[i] = 0.0f;
+        }
+        flags[i] = f;
+    }
+    if (!grid || awake == n) return;
+
+    // Wake whatever rests on a ball that is leaving or starting to move
+    std::vector<uint32_t> pending;
+    for (size_t i = 0; i < n; i++) {
+        if (flags[i] & (BALL_EXPIRED | BALL_WAKE)) pending.push_back((uint32_t)i);
+    }
+    while (!pending.empty()) {
+        uint32_t i = pending.back();
+        pending.pop_back();
+        grid->forEachNeighbor(balls.x[i], balls.y[i], [&](uint32_t j) {
+            if (j == i || (flags[j] & (BALL_EXPIRED | BALL_WAKE))) return;
+            float dx = balls.x[j] - balls.x[i];
+            float dy = balls.y[j] - balls.y[i];
+            float reach = balls.size[i] + balls.size[j] + WAKE_MOTION;
+            if (dx * dx + dy * dy >= reach * reach) return;
+            if (j < awake) {
+                // An awake neighbour loses its support too and must not fall asleep now
+                flags[j] &= ~BALL_SLEEP;
+                restSteps[j] = 0;
+                return;
+            }
+            flags[j] |= BALL_WAKE;
+            pending.push_back(j);
+        });
+    }
+}
+
+void applySleep(BallStore& balls, BallStepResult& result) {
+    for (size_t i = balls.getAwakeCount(); i < balls.getCount(); i++) {
+        if (balls.flags[i] & BALL_WAKE) {
+            balls.wake(i);
+            result.woken++;
+        }
+    }
+    for (size_t i = balls.getAwakeCount(); i-- > 0;) {
+        if (balls.flags[i] & BALL_SLEEP) {
+            balls.sleep(i);
+            result.slept++;
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "ballstore.h"
+#include "barneshut.h"
+#include "broadphase.h"
+#include "meshcollision.h"
+#include "pbdsolver.h"
+#include "scenegeometry.h"
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+class ThreadPool;
+
+// Physics constants shared by the viewer and the headless runner
+extern const float GRAVITY;
+extern const float RESTITUTION;
+extern const float BALL_SIZE;
+extern const float AIR_RESISTANCE;
+extern const float REFERENCE_HZ;
+
+// Balls handed to a worker at a time (a multiple of BallStore::LANES)
+static const size_t SIM_CHUNK = 4096;
+
+// Rest detection: a ball that moves less than SLEEP_MOTION pixels per
+// step while touching the floor or another ball for SLEEP_STEPS steps
+// goes dormant. A dormant ball wakes when pushed further than WAKE_MOTION
+// pixels or faster than WAKE_SPEED in one step; smaller pushes are undone.
+static const float SLEEP_MOTION = 0.05f;
+static const float WAKE_MOTION = 0.5f;
+static const float WAKE_SPEED = 0.5f;
+static const int SLEEP_STEPS = 60;
+
+/**
+ * Physics settings for multi-object mode, independent of the window.
+ * Per-step quantities are given per reference frame (REFERENCE_HZ) and
+ * rescaled to the actual step size by setupBallStep.
+ */
+struct SimSettings {
+    float width, height;   // Arena size in pixels
+    float gravity;
+    float airResistance;
+    float restitution;
+    float speed;           // Simulation speed multiplier
+    float maxLifetime;     // Seconds before a ball expires
+    bool allowSleep;       // Move settled balls to the dormant set
+
+    // Position-based contact iterations per step (see pbdsolver.h). Balls
+    // then pile up, so resting on the floor no longer expires them. 0 keeps
+    // the single impulse pass of collideBalls.
+    int contactIterations;
+
+    // Mutual attraction between balls (see barneshut.h): the pull per
+    // reference frame of a ball of size 1 at distance 1, falling off with
+    // the square of the distance. Cells smaller than openingAngle times
+    // their distance are treated as one body. Attracting balls never go
+    // dormant.
+    float attraction;
+    float openingAngle;
+
+    SimSettings()
+        : width(800.0f), height(600.0f), gravity(GRAVITY), airResistance(AIR_RESISTANCE),
+          restitution(RESTITUTION), speed(1.0f), maxLifetime(30.0f), allowSleep(true), contactIterations(0),
+          attraction(0.0f), openingAngle(0.5f) {}
+};
+
+// Outcome of one stepBalls call
+struct BallStepResult {
+    size_t bounces;   // Floor bounces
+    size_t contacts;  // Ball-ball and ball-obstacle contacts
+    size_t removed;   // Expired balls removed
+    size_t slept;     // Balls that went dormant
+    size_t woken;     // Dormant balls woken
+
+    BallStepResult() : bounces(0), contacts(0), removed(0), slept(0), woken(0) {}
+};
+
+// Called with the index of each ball that bounced and the pool worker that stepped it
+typedef std::function<void(size_t ball, unsigned worker)> BounceFn;
+
+/**
+ * Fill params for one step of dt seconds at simulation time now.
+ * Walls sit at 5%/95% of the width and the floor at 90% of the height.
+ * Shape extents are set for unrotated shapes; callers that draw rotated
+ * shapes may overwrite them.
+ */
+void setupBallStep(BallStepParams& params, const SimSettings& settings, float dt, float now);
+
+/**
+ * Advance every ball by one step: integrate the awake balls, resolve
+ * ball-ball contacts (when grid is not null) and obstacle contacts, update
+ * rest detection, remove expired balls and move balls between the awake
+ * and dormant sets. Integration runs across pool when it is not null.
+ * Ball-ball contacts go through solver when it is given and
+ * params.contactIterations is positive, and through collideBalls otherwise.
+ * With a tree and a nonzero params.attraction the balls pull on each
+ * other before they are integrated. Balls collide with scene after the
+ * obstacles when it is not null.
+ */
+BallStepResult stepBalls(BallStore& balls, const BallStepParams& params, SpatialGrid* grid,
+                         const std::vector<MeshObstacle>& obstacles, ThreadPool* pool,
+                         const BounceFn& onBounce, PbdSolver* solver = nullptr,
+                         BarnesHutTree* tree = nullptr, const SceneGeometry* scene = nullptr);
+
+/**
+ * Rest detection for one step, run after contacts are resolved. Flags
+ * settled awake balls BALL_SLEEP and disturbed dormant balls BALL_WAKE,
+ * undoes small pushes on dormant balls and expires dormant balls past
+ * their lifetime. With a grid, dormant balls touching a ball that wakes
+ * or expires are woken too, so a pile wakes as a whole when its support
+ * goes away.
+ */
+void updateSleep(BallStore& balls, const BallStepParams& params, const SpatialGrid* grid);
+
+/**
+ * Move balls flagged BALL_WAKE to the awake set and balls flagged
+ * BALL_SLEEP to the dormant set
+ */
+void applySleep(BallStore& balls, BallStepResult& result);
+
+#endif
@@ -1,9 +1,14 @@
 #include <iostream>
 #include <cstdio>
+#include <vector>
 #include "Angel.h"   
 #include "texture.h"
+#include "glstate.h"
 
-GLuint loadPPMTexture(const char* filename, int& width, int& height) {
+/**
+ * Read a P3 (ASCII) PPM file into tightly packed RGB bytes
+ */
+bool parsePPM(const char* filename, int& width, int& height, std::vector<GLubyte>& pixels) {
     FILE* fp;
     char buf[100];
     int max_val;
@@ -11,13 +16,14 @@ GLuint loadPPMTexture(const char* filename, int& width, int& height) {
     fp = fopen(filename, "r");
     if (!fp) {
         std::cerr << "Cannot open file: " << filename << std::endl;
-        exit(EXIT_FAILURE);
+        return false;
     }
 
     fgets(buf, 100, fp);
     if (buf[0] != 'P' || buf[1] != '3') {
         std::cerr << filename << " is not a valid P3 PPM file!" << std::endl;
-        exit(EXIT_FAILURE);
+        fclose(fp);
+        return false;
     }
 
     do {
@@ -28,28 +34,34 @@ GLuint loadPPMTexture(const char* filename, int& width, int& height) {
     fscanf(fp, "%d", &max_val);
 
     int size = width * height;
-    GLubyte* image = new GLubyte[3 * size];
+    pixels.resize(3 * size);
     for (int i = 0; i < size; ++i) {
         int r, g, b;
         fscanf(fp, "%d %d %d", &r, &g, &b);
-        image[3 * i] = r;
-        image[3 * i + 1] = g;
-        image[3 * i + 2] = b;
+        pixels[3 * i] = r;
+        pixels[3 * i + 1] = g;
+        pixels[3 * i + 2] = b;
     }
     fclose(fp);
+    return true;
+}
+
+GLuint loadPPMTexture(const char* filename, int& width, int& height) {
+    std::vector<GLubyte> image;
+    if (!parsePPM(filename, width, height, image))
+        exit(EXIT_FAILURE);
 
     GLuint textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    glState.bindTexture(GL_TEXTURE_2D, textureID);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.data());
     glGenerateMipmap(GL_TEXTURE_2D);
 
-    delete[] image;
     return textureID;
 }
@@ -1,6 +1,11 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include <vector>
+
+// Parse a P3 PPM file into RGB bytes; returns false if it cannot be read
+bool parsePPM(const char* filename, int& width, int& height, std::vector<GLubyte>& pixels);
+
 GLuint loadPPMTexture(const char* filename, int& width, int& height);
 
 #endif
@@ -0,0 +1,112 @@
+#include "threadpool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads)
+    : job(nullptr), jobCount(0), jobGrain(1), generation(0), busy(0), stopping(false) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    queues.reset(new ChunkQueue[threads]);
+    for (unsigned i = 0; i < threads; i++) {
+        queues[i].front = 0;
+        queues[i].back = 0;
+    }
+
+    // Worker 0 is whichever thread calls parallelFor
+    for (unsigned i = 1; i < threads; i++)
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const RangeFn& fn) {
+    if (count == 0) return;
+    if (grain == 0) grain = 1;
+
+    size_t numChunks = (count + grain - 1) / grain;
+    unsigned n = size();
+    if (n == 1 || numChunks == 1) {
+        fn(0, count, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        // Deal contiguous runs of chunks to each worker
+        for (unsigned i = 0; i < n; i++) {
+            std::lock_guard<std::mutex> queueGuard(queues[i].lock);
+            queues[i].front = numChunks * i / n;
+            queues[i].back = numChunks * (i + 1) / n;
+        }
+
+        job = &fn;
+        jobCount = count;
+        jobGrain = grain;
+        busy = n - 1;
+        generation++;
+    }
+    wake.notify_all();
+
+    runChunks(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return busy == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+    unsigned long seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+
+        runChunks(index);
+
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            if (--busy == 0) finished.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runChunks(unsigned index) {
+    size_t chunk;
+    while (popChunk(index, chunk) || stealChunk(index, chunk)) {
+        size_t begin = chunk * jobGrain;
+        size_t end = std::min(jobCount, begin + jobGrain);
+        (*job)(begin, end, index);
+    }
+}
+
+bool ThreadPool::popChunk(unsigned index, size_t& chunk) {
+    ChunkQueue& q = queues[index];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.front >= q.back) return false;
+    chunk = q.front++;
+    return true;
+}
+
+bool ThreadPool::stealChunk(unsigned thief, size_t& chunk) {
+    unsigned n = size();
+    for (unsigned k = 1; k < n; k++) {
+        ChunkQueue& q = queues[(thief + k) % n];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (q.front < q.back) {
+            chunk = --q.back;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,66 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Persistent worker pool for data-parallel loops.
+ * A parallelFor splits its index range into chunks that are dealt out to
+ * per-worker queues; a worker that runs out of chunks steals from the
+ * back of another worker's queue, so uneven chunk costs still balance.
+ * The calling thread takes part as worker 0.
+ */
+class ThreadPool {
+public:
+    // Called with a half-open index range and the index of the worker running it
+    typedef std::function<void(size_t begin, size_t end, unsigned worker)> RangeFn;
+
+    // threads == 0 uses one worker per hardware thread
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    // Number of workers, including the calling thread
+    unsigned size() const { return (unsigned)workers.size() + 1; }
+
+    /**
+     * Run fn over [0, count) in chunks of grain indices and wait for all
+     * of them to finish. Chunk boundaries are multiples of grain.
+     */
+    void parallelFor(size_t count, size_t grain, const RangeFn& fn);
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    // Chunk indices [front, back) still owned by one worker
+    struct ChunkQueue {
+        std::mutex lock;
+        size_t front, back;
+    };
+
+    void workerLoop(unsigned index);
+    void runChunks(unsigned index);
+    bool popChunk(unsigned index, size_t& chunk);
+    bool stealChunk(unsigned thief, size_t& chunk);
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<ChunkQueue[]> queues;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const RangeFn* job;
+    size_t jobCount;
+    size_t jobGrain;
+    unsigned long generation;
+    unsigned busy;
+    bool stopping;
+};
+
+#endif
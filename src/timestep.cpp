@@ -0,0 +1,44 @@
+#include "timestep.h"
+#include <algorithm>
+
+// Frame times longer than this (e.g. after a debugger pause) are clamped
+static const double MAX_FRAME_TIME = 0.25;
+
+FixedTimestep::FixedTimestep(double hz, int maxSubsteps)
+    : hz(hz), step(1.0 / hz), accumulator(0.0), maxSubsteps(maxSubsteps), dropped(0) {
+}
+
+void FixedTimestep::setRate(double newHz) {
+    if (newHz <= 0.0) return;
+    hz = newHz;
+    step = 1.0 / newHz;
+    accumulator = std::min(accumulator, step);
+}
+
+void FixedTimestep::setMaxSubsteps(int n) {
+    maxSubsteps = std::max(1, n);
+}
+
+void FixedTimestep::reset() {
+    accumulator = 0.0;
+    dropped = 0;
+}
+
+int FixedTimestep::advance(double frameTime) {
+    if (frameTime < 0.0) frameTime = 0.0;
+    accumulator += std::min(frameTime, MAX_FRAME_TIME);
+    
+    int steps = (int)(accumulator / step);
+    if (steps > maxSubsteps) {
+        // Spiral-of-death guard: run what we can afford and drop the rest
+        dropped += steps - maxSubsteps;
+        accumulator -= (steps - maxSubsteps) * step;
+        steps = maxSubsteps;
+    }
+    accumulator -= steps * step;
+    return steps;
+}
+
+float FixedTimestep::alpha() const {
+    return (float)std::min(1.0, std::max(0.0, accumulator / step));
+}
@@ -0,0 +1,42 @@
+#ifndef TIMESTEP_H
+#define TIMESTEP_H
+
+/**
+ * Fixed-step physics scheduler.
+ * Wall-clock frame time is accumulated and consumed in whole physics
+ * steps; the leftover fraction is used to interpolate rendering between
+ * the last two physics states.
+ */
+class FixedTimestep {
+public:
+    FixedTimestep(double hz = 120.0, int maxSubsteps = 8);
+
+    void setRate(double hz);
+    void setMaxSubsteps(int maxSubsteps);
+    void reset();
+
+    double rate() const { return hz; }
+    double stepSize() const { return step; }
+
+    /**
+     * Add a frame's elapsed time and return how many physics steps to run.
+     * At most maxSubsteps are returned; time beyond that is dropped so a
+     * slow frame cannot snowball into ever longer frames.
+     */
+    int advance(double frameTime);
+
+    // Fraction of a step left in the accumulator (0..1) for interpolation
+    float alpha() const;
+
+    // Total number of steps dropped by the substep guard
+    long droppedSteps() const { return dropped; }
+
+private:
+    double hz;
+    double step;
+    double accumulator;
+    int maxSubsteps;
+    long dropped;
+};
+
+#endif
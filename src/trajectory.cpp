@@ -0,0 +1,164 @@
+#include "trajectory.h"
+#include "checkpoint.h"
+
+void TrajectoryRing::setCapacity(size_t n) {
+    positions.reallocate(n * COMPONENTS, 0);
+    times.reallocate(n, 0);
+    for (size_t i = 0; i < n; i++)
+        positions[i * COMPONENTS + 3] = 1.0f;
+    cap = n;
+    count = 0;
+    pushed = 0;
+    generation++;
+}
+
+size_t TrajectoryRing::findTime(float time) const {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (times[slotOf(mid)] < time) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void TrajectoryRing::save(SnapshotWriter& out) const {
+    out.value((uint64_t)cap);
+    out.value((uint64_t)count);
+    out.value(pushed);
+    out.array(positions.data(), cap * COMPONENTS);
+    out.array(times.data(), cap);
+}
+
+bool TrajectoryRing::load(SnapshotReader& in) {
+    uint64_t n = 0, savedCount = 0, savedPushed = 0;
+    in.value(n);
+    in.value(savedCount);
+    in.value(savedPushed);
+    // Every slot takes COMPONENTS + 1 floats, which bounds n before allocating
+    bool valid = in.good() && savedCount <= n && savedCount <= savedPushed &&
+                 n <= in.remaining() / ((COMPONENTS + 1) * sizeof(float));
+    setCapacity(valid ? (size_t)n : 0);
+    if (!valid) {
+        in.fail();
+        return false;
+    }
+    in.array(positions.data(), cap * COMPONENTS);
+    in.array(times.data(), cap);
+    if (!in.good()) return false;
+    count = (size_t)savedCount;
+    pushed = savedPushed;
+    return true;
+}
+
+void TrajectoryHistory::configure(size_t capacity, float baseTolerance) {
+    if (capacity != cap) {
+        for (int l = 0; l < LEVELS; l++)
+            levels[l].ring.setCapacity(capacity);
+        cap = capacity;
+        clear();
+    }
+    tolerance = baseTolerance;
+    float t = baseTolerance;
+    for (int l = 0; l < LEVELS; l++, t *= LEVEL_FACTOR)
+        levels[l].tolerance = t;
+}
+
+void TrajectoryHistory::clear() {
+    for (int l = 0; l < LEVELS; l++) {
+        levels[l].ring.clear();
+        levels[l].pendingX.clear();
+        levels[l].pendingY.clear();
+        levels[l].endFixed = false;
+    }
+}
+
+void TrajectoryHistory::save(SnapshotWriter& out) const {
+    out.value((uint64_t)cap);
+    out.value(tolerance);
+    for (int l = 0; l < LEVELS; l++) {
+        const Level& lv = levels[l];
+        lv.ring.save(out);
+        out.array(lv.pendingX.data(), lv.pendingX.size());
+        out.array(lv.pendingY.data(), lv.pendingY.size());
+        out.value((uint8_t)lv.endFixed);
+    }
+}
+
+bool TrajectoryHistory::load(SnapshotReader& in) {
+    uint64_t savedCap = 0;
+    float savedTolerance = 0.0f;
+    in.value(savedCap);
+    in.value(savedTolerance);
+    clear();
+    if (!in.good()) return false;
+    configure(0, savedTolerance);
+    for (int l = 0; l < LEVELS; l++) {
+        Level& lv = levels[l];
+        uint8_t endFixed = 0;
+        lv.ring.load(in);
+        in.vector(lv.pendingX, MAX_PENDING);
+        in.vector(lv.pendingY, MAX_PENDING);
+        in.value(endFixed);
+        lv.endFixed = endFixed != 0;
+        if (!in.good() || lv.ring.capacity() != savedCap || lv.pendingX.size() != lv.pendingY.size()) {
+            in.fail();
+            for (int k = 0; k < LEVELS; k++) levels[k].ring.setCapacity(0);
+            clear();
+            return false;
+        }
+    }
+    cap = (size_t)savedCap;
+    return true;
+}
+
+void TrajectoryHistory::add(float x, float y, float time, bool corner) {
+    for (int l = 0; l < LEVELS; l++)
+        addToLevel(levels[l], x, y, time, corner);
+}
+
+// Squared distance from (px, py) to the segment from a to b
+static float segmentDistanceSq(float px, float py, float ax, float ay, float bx, float by) {
+    float dx = bx - ax, dy = by - ay;
+    float len2 = dx * dx + dy * dy;
+    float t = len2 > 0.0f ? ((px - ax) * dx + (py - ay) * dy) / len2 : 0.0f;
+    t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+    float ex = ax + t * dx - px, ey = ay + t * dy - py;
+    return ex * ex + ey * ey;
+}
+
+void TrajectoryHistory::addToLevel(Level& lv, float x, float y, float time, bool corner) {
+    TrajectoryRing& ring = lv.ring;
+    if (ring.capacity() == 0) return;
+    size_t n = ring.size();
+    float tol2 = lv.tolerance * lv.tolerance;
+
+    bool keepEnd = n < 2 || lv.endFixed;
+    if (!keepEnd) {
+        // Samples this close to the open end change nothing but its time
+        float ex = ring.x(n - 1) - x, ey = ring.y(n - 1) - y;
+        if (!corner && ex * ex + ey * ey <= tol2 / 64.0f) {
+            ring.replaceLast(ring.x(n - 1), ring.y(n - 1), time);
+            return;
+        }
+
+        // Can the segment from the last fixed point to this sample stand for every sample since?
+        float ax = ring.x(n - 2), ay = ring.y(n - 2);
+        bool fits = lv.pendingX.size() < MAX_PENDING;
+        for (size_t i = 0; fits && i < lv.pendingX.size(); i++)
+            fits = segmentDistanceSq(lv.pendingX[i], lv.pendingY[i], ax, ay, x, y) <= tol2;
+        keepEnd = !fits;
+    }
+
+    if (keepEnd) {
+        // Leave the open end behind as a fixed point and start a new one here
+        ring.push(x, y, time);
+        lv.pendingX.clear();
+        lv.pendingY.clear();
+    } else {
+        ring.replaceLast(x, y, time);
+    }
+    lv.pendingX.push_back(x);
+    lv.pendingY.push_back(y);
+    lv.endFixed = corner;
+}
@@ -0,0 +1,175 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "ballstore.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+/**
+ * Fixed-capacity ring of trajectory points in world space.
+ * Point number seq (counting every push since the last setCapacity)
+ * always lives in slot seq % capacity, so a GPU buffer with the same
+ * slot layout can be kept in sync by uploading only the slots written
+ * since the last upload, straight from positionData(). Once full, each
+ * push overwrites the oldest point. Nothing is allocated after
+ * setCapacity.
+ */
+class TrajectoryRing {
+public:
+    static const size_t COMPONENTS = 4;  // x, y, z = 0, w = 1, ready for a vec4 attribute
+
+    TrajectoryRing() : cap(0), count(0), pushed(0), generation(0) {}
+
+    size_t capacity() const { return cap; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    /**
+     * Allocate room for n points and drop the current ones. Bumps
+     * getGeneration() so mirrors of the slot layout know to start over.
+     */
+    void setCapacity(size_t n);
+
+    // Drop every point; slots keep their sequence mapping
+    void clear() { count = 0; }
+
+    // Append a point, overwriting the oldest one when full
+    void push(float x, float y, float time) {
+        if (cap == 0) return;
+        size_t slot = (size_t)(pushed % cap);
+        float* p = positions.data() + slot * COMPONENTS;
+        p[0] = x;
+        p[1] = y;
+        times[slot] = time;
+        pushed++;
+        if (count < cap) count++;
+    }
+
+    // Move the newest point, e.g. the open end of a simplified path
+    void replaceLast(float x, float y, float time) {
+        if (count == 0) return;
+        size_t slot = (size_t)((pushed - 1) % cap);
+        float* p = positions.data() + slot * COMPONENTS;
+        p[0] = x;
+        p[1] = y;
+        times[slot] = time;
+    }
+
+    // i-th oldest point
+    float x(size_t i) const { return positions[slotOf(i) * COMPONENTS]; }
+    float y(size_t i) const { return positions[slotOf(i) * COMPONENTS + 1]; }
+    float time(size_t i) const { return times[slotOf(i)]; }
+
+    // Slot holding the i-th oldest point
+    size_t slotOf(size_t i) const { return (size_t)((pushed - count + i) % cap); }
+
+    // Index of the oldest point no older than time (times only grow between clears)
+    size_t findTime(float time) const;
+
+    // Sequence number of the next push
+    uint64_t pushCount() const { return pushed; }
+
+    // Changes whenever the slot layout is reset by setCapacity
+    uint32_t getGeneration() const { return generation; }
+
+    // Raw slot storage, capacity() * COMPONENTS floats
+    const float* positionData() const { return positions.data(); }
+
+    // Append the slots and sequence state to a checkpoint (see checkpoint.h)
+    void save(SnapshotWriter& out) const;
+
+    /**
+     * Replace the contents with a ring saved by save. Bumps
+     * getGeneration() like setCapacity, so mirrors upload it afresh.
+     *
+     * @return false if the section is malformed; the ring is then empty
+     */
+    bool load(SnapshotReader& in);
+
+private:
+    TrajectoryRing(const TrajectoryRing&);
+    TrajectoryRing& operator=(const TrajectoryRing&);
+
+    AlignedArray<float> positions;
+    AlignedArray<float> times;
+    size_t cap;
+    size_t count;
+    uint64_t pushed;
+    uint32_t generation;
+};
+
+/**
+ * Trajectory recorder that keeps only the points needed to follow the
+ * path within a tolerance, at several levels of detail.
+ *
+ * Each level simplifies the raw samples online: the newest point of its
+ * ring is an open end that slides along with the samples for as long as
+ * the segment from the previous point stays within the level's tolerance
+ * of every sample since, and is left behind once it does not. Straight
+ * runs and smooth arcs therefore collapse to a few points while bounces
+ * (passed as corners) are always kept. Level l uses the base tolerance
+ * times LEVEL_FACTOR^l, so coarser levels span a longer history in the
+ * same fixed capacity.
+ */
+class TrajectoryHistory {
+public:
+    static const int LEVELS = 3;
+    static const int LEVEL_FACTOR = 4;    // Tolerance ratio between neighbouring levels
+    static const size_t MAX_PENDING = 256;  // Samples tested per point before it is left behind
+
+    TrajectoryHistory() : cap(0), tolerance(0.0f) {}
+
+    /**
+     * Set the ring size of every level and the base tolerance, in the
+     * units of the samples. A new capacity drops the history; a new
+     * tolerance applies from the next point on.
+     */
+    void configure(size_t capacity, float baseTolerance);
+
+    // Drop every point of every level
+    void clear();
+
+    /**
+     * Record a sample. A corner (e.g. a bounce contact) is always kept
+     * as a point of every level.
+     */
+    void add(float x, float y, float time, bool corner = false);
+
+    const TrajectoryRing& level(int l) const { return levels[l].ring; }
+    float levelTolerance(int l) const { return levels[l].tolerance; }
+    size_t capacity() const { return cap; }
+    float getTolerance() const { return tolerance; }
+
+    // Append every level, including the samples behind each open end, to a checkpoint
+    void save(SnapshotWriter& out) const;
+
+    /**
+     * Replace the history with one saved by save, so recording continues
+     * exactly where the saved history left off.
+     *
+     * @return false if the section is malformed; the history is then empty
+     */
+    bool load(SnapshotReader& in);
+
+private:
+    struct Level {
+        TrajectoryRing ring;
+        std::vector<float> pendingX, pendingY;  // Samples since the last fixed point
+        float tolerance;
+        bool endFixed;  // The newest point may not move any more
+
+        Level() : tolerance(0.0f), endFixed(false) {}
+    };
+
+    static void addToLevel(Level& level, float x, float y, float time, bool corner);
+
+    Level levels[LEVELS];
+    size_t cap;
+    float tolerance;
+};
+
+#endif
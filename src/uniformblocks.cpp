@@ -0,0 +1,79 @@
+#include "uniformblocks.h"
+#include "glstate.h"
+#include <cstring>
+
+UniformBlocks::UniformBlocks()
+    : camera(0), light(0), plastic(0), metallic(0), cameraKnown(false), lightKnown(false) {
+    memset(&cameraData, 0, sizeof(cameraData));
+    memset(&lightData, 0, sizeof(lightData));
+}
+
+// Create a uniform buffer holding bytes of data, or sized for them if data is null
+static GLuint createBlock(const void* data, size_t bytes, GLenum usage) {
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glState.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, bytes, data, usage);
+    return buffer;
+}
+
+void UniformBlocks::init(float plasticShininess, float plasticSpecular, float metallicShininess,
+                         float metallicSpecular) {
+    camera = createBlock(nullptr, sizeof(Camera), GL_DYNAMIC_DRAW);
+    light = createBlock(nullptr, sizeof(Light), GL_DYNAMIC_DRAW);
+
+    Material material = {};
+    material.shininess = plasticShininess;
+    material.specularStrength = plasticSpecular;
+    plastic = createBlock(&material, sizeof(material), GL_STATIC_DRAW);
+    material.shininess = metallicShininess;
+    material.specularStrength = metallicSpecular;
+    metallic = createBlock(&material, sizeof(material), GL_STATIC_DRAW);
+    cameraKnown = lightKnown = false;
+}
+
+void UniformBlocks::release() {
+    GLuint buffers[4] = { camera, light, plastic, metallic };
+    glDeleteBuffers(4, buffers);
+    camera = light = plastic = metallic = 0;
+    cameraKnown = lightKnown = false;
+}
+
+void UniformBlocks::setCamera(const mat4& viewProjection, const vec3& viewPos, float viewportHeight) {
+    Camera data;
+    memcpy(data.projection, (const GLfloat*)viewProjection, sizeof(data.projection));
+    data.viewPos[0] = viewPos.x;
+    data.viewPos[1] = viewPos.y;
+    data.viewPos[2] = viewPos.z;
+    data.viewportHeight = viewportHeight;
+    if (cameraKnown && memcmp(&data, &cameraData, sizeof(data)) == 0) return;
+
+    cameraData = data;
+    cameraKnown = true;
+    glState.bindBuffer(GL_UNIFORM_BUFFER, camera);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data), &data);
+}
+
+void UniformBlocks::setLight(const vec3& direction, bool followsObject, bool ambient, bool diffuse, bool specular) {
+    Light data;
+    data.lightDir[0] = direction.x;
+    data.lightDir[1] = direction.y;
+    data.lightDir[2] = direction.z;
+    data.lightFollowsObject = followsObject;
+    data.useAmbient = ambient;
+    data.useDiffuse = diffuse;
+    data.useSpecular = specular;
+    data.pad = 0;
+    if (lightKnown && memcmp(&data, &lightData, sizeof(data)) == 0) return;
+
+    lightData = data;
+    lightKnown = true;
+    glState.bindBuffer(GL_UNIFORM_BUFFER, light);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data), &data);
+}
+
+void UniformBlocks::bind(bool useMetallic) const {
+    glState.bindBufferBase(GL_UNIFORM_BUFFER, BLOCK_CAMERA, camera);
+    glState.bindBufferBase(GL_UNIFORM_BUFFER, BLOCK_LIGHT, light);
+    glState.bindBufferBase(GL_UNIFORM_BUFFER, BLOCK_MATERIAL, useMetallic ? metallic : plastic);
+}
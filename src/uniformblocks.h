@@ -0,0 +1,58 @@
+#ifndef UNIFORMBLOCKS_H
+#define UNIFORMBLOCKS_H
+
+#include "Angel.h"
+#include "shader.h"
+
+/**
+ * Uniform buffers behind the Camera, Light and Material blocks every
+ * viewer shader declares, laid out std140.
+ *
+ * State every program shares lives here once instead of as a copy in
+ * each program, so switching programs sends nothing and a new shader
+ * only has to declare the blocks it reads. Camera and light are uploaded
+ * only when they change; the plastic and metallic materials each have
+ * their own buffer, filled once, and choosing one is a binding switch.
+ */
+class UniformBlocks {
+public:
+    UniformBlocks();
+
+    // Create the buffers and fill the plastic and metallic materials
+    void init(float plasticShininess, float plasticSpecular, float metallicShininess, float metallicSpecular);
+    void release();
+
+    // View-projection (row-major like Angel's mat4), eye position and viewport height in pixels
+    void setCamera(const mat4& viewProjection, const vec3& viewPos, float viewportHeight);
+
+    // World light direction; with followsObject shaders turn it by each object's model matrix
+    void setLight(const vec3& direction, bool followsObject, bool ambient, bool diffuse, bool specular);
+
+    // Bind camera, light and the chosen material to their binding points
+    void bind(bool useMetallic) const;
+
+private:
+    // Mirrors of the GLSL blocks under std140 rules
+    struct Camera {
+        GLfloat projection[16];  // layout(row_major) in GLSL
+        GLfloat viewPos[3];
+        GLfloat viewportHeight;  // Packs into viewPos's 16-byte slot
+    };
+    struct Light {
+        GLfloat lightDir[3];
+        GLint lightFollowsObject;  // GLSL bools are 4 bytes in a block
+        GLint useAmbient, useDiffuse, useSpecular;
+        GLint pad;
+    };
+    struct Material {
+        GLfloat shininess, specularStrength;
+        GLfloat pad[2];
+    };
+
+    GLuint camera, light, plastic, metallic;
+    Camera cameraData;
+    Light lightData;
+    bool cameraKnown, lightKnown;  // The buffers hold cameraData and lightData
+};
+
+#endif
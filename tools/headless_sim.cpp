@@ -0,0 +1,333 @@
+/**
+ * Headless multi-object simulation.
+ * Runs the ball physics without a window or GL context, for batch runs
+ * and parameter sweeps on machines with no display. Prints throughput
+ * and checksums of the final state so runs can be compared.
+ */
+#include "ballistic.h"
+#include "ballstore.h"
+#include "checkpoint.h"
+#include "recording.h"
+#include "rng.h"
+#include "simulation.h"
+#include "threadpool.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Options {
+    size_t balls;
+    long steps;
+    double hz;
+    unsigned threads;  // 0 = hardware concurrency
+    bool collisions;
+    bool eventDriven;  // Analytic arcs and bounce events instead of fixed steps
+    unsigned seed;
+    float size;  // Base ball radius in pixels
+    std::string recordPath;  // Empty = no recording
+    unsigned keyframeInterval;
+    std::string savePath;     // Empty = no checkpoint at the end
+    std::string restorePath;  // Empty = start from a fresh layout
+    std::string scenePath;    // Empty = no static level geometry
+    SimSettings settings;
+
+    Options()
+        : balls(10000), steps(1000), hz(120.0), threads(0), collisions(true), eventDriven(false), seed(1), size(6.0f),
+          keyframeInterval(120) {
+        settings.width = 4000.0f;
+        settings.height = 3000.0f;
+        settings.maxLifetime = 1e30f;
+    }
+};
+
+static void printUsage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --balls N          Number of balls (default 10000)\n");
+    printf("  --steps N          Physics steps to run (default 1000)\n");
+    printf("  --hz F             Physics step rate (default 120)\n");
+    printf("  --width F          Arena width in pixels (default 4000)\n");
+    printf("  --height F         Arena height in pixels (default 3000)\n");
+    printf("  --size F           Base ball radius in pixels (default 6)\n");
+    printf("  --gravity F        Gravity per reference frame (default %g)\n", GRAVITY);
+    printf("  --restitution F    Energy kept on bounce (default %g)\n", RESTITUTION);
+    printf("  --air F            Air resistance per reference frame (default %g)\n", AIR_RESISTANCE);
+    printf("  --speed F          Simulation speed multiplier (default 1)\n");
+    printf("  --lifetime F       Seconds before a ball expires (default: never)\n");
+    printf("  --collisions 0|1   Ball-ball collisions (default 1)\n");
+    printf("  --pbd N            Position-based contact iterations, 0 = impulses (default 0)\n");
+    printf("  --attraction F     Mutual attraction between balls, 0 = off (default 0)\n");
+    printf("  --theta F          Barnes-Hut opening angle for --attraction (default 0.5)\n");
+    printf("  --scene FILE       Static segments, polygons and circles (see scenegeometry.h)\n");
+    printf("  --threads N        Worker threads, 1 = serial (default: all cores)\n");
+    printf("  --sleep 0|1        Let settled balls go dormant (default 1)\n");
+    printf("  --event 0|1        Event-driven ballistic engine, no ball-ball collisions (default 0)\n");
+    printf("  --seed N           Seed for the initial layout (default 1)\n");
+    printf("  --record FILE      Record every step to FILE (see sim_replay)\n");
+    printf("  --keyframe N       Steps between recording keyframes (default 120)\n");
+    printf("  --save FILE        Write a checkpoint of the final state to FILE\n");
+    printf("  --restore FILE     Continue from a checkpoint instead of a fresh layout;\n");
+    printf("                     its settings, step rate and collisions replace the options\n");
+}
+
+static bool parseOptions(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            exit(0);
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--balls") opt.balls = (size_t)atol(value);
+        else if (arg == "--steps") opt.steps = atol(value);
+        else if (arg == "--hz") opt.hz = atof(value);
+        else if (arg == "--width") opt.settings.width = (float)atof(value);
+        else if (arg == "--height") opt.settings.height = (float)atof(value);
+        else if (arg == "--size") opt.size = (float)atof(value);
+        else if (arg == "--gravity") opt.settings.gravity = (float)atof(value);
+        else if (arg == "--restitution") opt.settings.restitution = (float)atof(value);
+        else if (arg == "--air") opt.settings.airResistance = (float)atof(value);
+        else if (arg == "--speed") opt.settings.speed = (float)atof(value);
+        else if (arg == "--lifetime") opt.settings.maxLifetime = (float)atof(value);
+        else if (arg == "--collisions") opt.collisions = atoi(value) != 0;
+        else if (arg == "--pbd") opt.settings.contactIterations = atoi(value);
+        else if (arg == "--attraction") opt.settings.attraction = (float)atof(value);
+        else if (arg == "--theta") opt.settings.openingAngle = (float)atof(value);
+        else if (arg == "--scene") opt.scenePath = value;
+        else if (arg == "--threads") opt.threads = (unsigned)atoi(value);
+        else if (arg == "--sleep") opt.settings.allowSleep = atoi(value) != 0;
+        else if (arg == "--event") opt.eventDriven = atoi(value) != 0;
+        else if (arg == "--seed") opt.seed = (unsigned)atoi(value);
+        else if (arg == "--record") opt.recordPath = value;
+        else if (arg == "--keyframe") opt.keyframeInterval = (unsigned)atoi(value);
+        else if (arg == "--save") opt.savePath = value;
+        else if (arg == "--restore") opt.restorePath = value;
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    if (opt.hz <= 0.0 || opt.steps < 0) {
+        fprintf(stderr, "--hz must be positive and --steps non-negative\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Scatter balls over the upper part of the arena with launchBall's
+ * velocity and relative size ranges
+ */
+static void fillBalls(BallStore& balls, const Options& opt) {
+    const SimSettings& s = opt.settings;
+    balls.clear();
+    balls.reserve(opt.balls);
+    Rng rng(opt.seed);
+    for (size_t i = 0; i < opt.balls; i++) {
+        BallObject ball;
+        ball.x = s.width * rng.uniform(0.1f, 0.9f);
+        ball.y = s.height * rng.uniform(0.1f, 0.6f);
+        ball.vx = 6.0f * rng.uniform(0.8f, 1.2f) * (rng.below(2) ? 1.0f : -1.0f);
+        ball.vy = -2.0f * rng.uniform(0.8f, 1.2f);
+        ball.colorIndex = (int)rng.below(8);
+        ball.type = static_cast<ObjectType>(rng.below(3));
+        ball.size = opt.size * rng.uniform(0.6f, 1.4f);
+        ball.launchTime = 0.0f;
+        balls.push(ball);
+    }
+}
+
+// Run state a checkpoint holds besides the balls
+struct RunCheckpoint {
+    float now;
+    double hz;
+    uint8_t collisions;
+    SimSettings settings;
+};
+
+static bool saveRun(const char* path, const BallStore& balls, const Options& opt, float now) {
+    RunCheckpoint run = RunCheckpoint();
+    run.now = now;
+    run.hz = opt.hz;
+    run.collisions = opt.collisions;
+    run.settings = opt.settings;
+
+    SimSnapshot snapshot;
+    SnapshotWriter out = snapshot.beginWrite();
+    out.value(run);
+    balls.save(out);
+    snapshot.endWrite();
+    return snapshot.saveFile(path);
+}
+
+static bool restoreRun(const char* path, BallStore& balls, Options& opt, float& now) {
+    SimSnapshot snapshot;
+    SnapshotReader in;
+    RunCheckpoint run;
+    if (!snapshot.loadFile(path)) return false;
+    if (!snapshot.beginRead(in)) {
+        fprintf(stderr, "%s is not a checkpoint\n", path);
+        return false;
+    }
+    in.value(run);
+    if (!in.good() || !balls.load(in)) {
+        fprintf(stderr, "Checkpoint %s is damaged\n", path);
+        return false;
+    }
+    now = run.now;
+    opt.hz = run.hz;
+    opt.collisions = run.collisions != 0;
+    opt.settings = run.settings;
+    return true;
+}
+
+// FNV-1a over the bit patterns of one field, so any difference shows up
+static uint64_t hashFloats(uint64_t h, const float* values, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t bits;
+        std::memcpy(&bits, &values[i], sizeof(bits));
+        for (int k = 0; k < 4; k++) {
+            h ^= (bits >> (8 * k)) & 0xff;
+            h *= 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    BallStore balls;
+    float now = 0.0f;
+    if (opt.restorePath.empty()) {
+        fillBalls(balls, opt);
+    } else {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!restoreRun(opt.restorePath.c_str(), balls, opt, now)) return 1;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("%-16s %s (%zu balls at %.6f s, %.3f ms)\n", "restored", opt.restorePath.c_str(),
+               balls.getCount(), now, ms);
+    }
+    size_t initialBalls = balls.getCount();
+
+    ThreadPool pool(opt.threads);
+    SpatialGrid grid;
+    PbdSolver solver;
+    BarnesHutTree tree;
+    SceneGeometry scene;
+    std::vector<MeshObstacle> obstacles;
+    if (!opt.scenePath.empty()) {
+        if (!scene.load(opt.scenePath.c_str(), opt.settings.width, opt.settings.height)) return 1;
+        printf("%-16s %s (%zu segments, %zu circles, %zu cells)\n", "scene", opt.scenePath.c_str(),
+               scene.getSegments().size(), scene.getCircles().size(), scene.cellCount());
+    }
+    float dt = (float)(1.0 / opt.hz);
+
+    SimRecorder recorder;
+    if (!opt.recordPath.empty() && !recorder.open(opt.recordPath.c_str(), opt.keyframeInterval))
+        return 1;
+
+    size_t ballUpdates = 0, bounces = 0, contacts = 0, removed = 0, events = 0, slept = 0, woken = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (opt.eventDriven) {
+        // Only bounce and expiry events cost anything; positions are evaluated once at the end
+        BallisticSim sim;
+        double eventNow = now;
+        sim.configure(opt.settings, eventNow);
+        sim.reset(balls, eventNow);
+        for (long step = 0; step < opt.steps; step++) {
+            eventNow += dt * opt.settings.speed;
+            BallisticResult result = sim.advanceEvents(balls, eventNow, BounceFn());
+            events += result.events;
+            bounces += result.bounces;
+            removed += result.removed;
+            if (recorder.isOpen()) {
+                // Recording needs positions every step, not only at the end
+                sim.evaluate(balls, eventNow);
+                recorder.writeStep((uint64_t)step, eventNow, balls, nullptr, 0);
+            }
+        }
+        sim.evaluate(balls, eventNow);
+        now = (float)eventNow;
+    }
+    for (long step = 0; step < opt.steps && !opt.eventDriven; step++) {
+        now += dt * opt.settings.speed;
+        BallStepParams params;
+        setupBallStep(params, opt.settings, dt, now);
+
+        ballUpdates += balls.getAwakeCount();
+        BallStepResult result = stepBalls(balls, params, opt.collisions ? &grid : nullptr, obstacles,
+                                          pool.size() > 1 ? &pool : nullptr, BounceFn(), &solver, &tree,
+                                          &scene);
+        bounces += result.bounces;
+        contacts += result.contacts;
+        removed += result.removed;
+        slept += result.slept;
+        woken += result.woken;
+        if (recorder.isOpen())
+            recorder.writeStep((uint64_t)step, now, balls, nullptr, 0);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t n = balls.getCount();
+    double sumX = 0.0, sumY = 0.0, energy = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sumX += balls.x[i];
+        sumY += balls.y[i];
+        energy += 0.5 * balls.size[i] * balls.size[i] * (balls.vx[i] * balls.vx[i] + balls.vy[i] * balls.vy[i]);
+    }
+    uint64_t hash = 14695981039346656037ull;
+    hash = hashFloats(hash, balls.x.data(), n);
+    hash = hashFloats(hash, balls.y.data(), n);
+    hash = hashFloats(hash, balls.vx.data(), n);
+    hash = hashFloats(hash, balls.vy.data(), n);
+
+    printf("%-16s %zu -> %zu\n", "balls", initialBalls, n);
+    if (opt.eventDriven)
+        printf("%-16s %ld at %g Hz (event-driven)\n", "steps", opt.steps, opt.hz);
+    else
+        printf("%-16s %ld at %g Hz (%u threads)\n", "steps", opt.steps, opt.hz, pool.size());
+    printf("%-16s %.3f s\n", "time", seconds);
+    printf("%-16s %.1f\n", "steps/s", seconds > 0.0 ? opt.steps / seconds : 0.0);
+    if (opt.eventDriven) {
+        // No ball is updated per step, so the rates are per event and per bounce
+        printf("%-16s %.3e\n", "events/s", seconds > 0.0 ? events / seconds : 0.0);
+        printf("%-16s %.3e\n", "bounces/s", seconds > 0.0 ? bounces / seconds : 0.0);
+    } else {
+        printf("%-16s %.3e\n", "ball-updates/s", seconds > 0.0 ? ballUpdates / seconds : 0.0);
+    }
+    printf("%-16s %zu\n", "bounces", bounces);
+    if (opt.eventDriven) printf("%-16s %zu\n", "events", events);
+    printf("%-16s %zu\n", "contacts", contacts);
+    printf("%-16s %zu\n", "removed", removed);
+    if (!opt.eventDriven)
+        printf("%-16s %zu dormant (%zu slept, %zu woken)\n", "sleep", n - balls.getAwakeCount(), slept, woken);
+    printf("%-16s %.6f %.6f\n", "sum x, y", sumX, sumY);
+    printf("%-16s %.6f\n", "kinetic energy", energy);
+    printf("%-16s %016llx\n", "state hash", (unsigned long long)hash);
+    if (recorder.isOpen()) {
+        recorder.close();
+        printf("%-16s %s (%zu frames, %.1f bytes/ball/frame)\n", "recording", opt.recordPath.c_str(),
+               recorder.frameCount(),
+               recorder.frameCount() && initialBalls ? (double)recorder.bytesWritten() / recorder.frameCount() / initialBalls : 0.0);
+    }
+    if (!opt.savePath.empty()) {
+        std::chrono::steady_clock::time_point saveStart = std::chrono::steady_clock::now();
+        if (!saveRun(opt.savePath.c_str(), balls, opt, now)) return 1;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - saveStart).count();
+        printf("%-16s %s (%.3f ms)\n", "checkpoint", opt.savePath.c_str(), ms);
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+/**
+ * Parameter sweep over the single-ball physics.
+ * Runs one independent single-ball simulation per combination of the
+ * swept gravity, restitution, air resistance and launch velocity values
+ * (see ensemble.h) and prints summary statistics, optionally writing
+ * every member's parameters and results to a CSV file.
+ */
+#include "ensemble.h"
+#include "simulation.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Values LO, LO + step, ..., HI taken by one swept parameter
+struct SweepRange {
+    float lo, hi;
+    int count;
+
+    SweepRange(float value = 0.0f) : lo(value), hi(value), count(1) {}
+
+    float at(int i) const { return count > 1 ? lo + (hi - lo) * i / (count - 1) : lo; }
+};
+
+struct Options {
+    SweepRange gravity, restitution, air, vx, vy;
+    EnsembleSettings settings;
+    double hz;
+    unsigned threads;  // 0 = hardware concurrency
+    std::string csvPath;
+
+    Options()
+        : gravity(GRAVITY), restitution(RESTITUTION), air(AIR_RESISTANCE), vx(6.0f), vy(-2.0f), hz(120.0),
+          threads(0) {}
+};
+
+static void printUsage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("Swept options take a single value or LO:HI:N (N evenly spaced values);\n");
+    printf("one simulation runs per combination.\n");
+    printf("  --gravity R        Gravity per reference frame (default %g)\n", GRAVITY);
+    printf("  --restitution R    Energy kept on bounce (default %g)\n", RESTITUTION);
+    printf("  --air R            Air resistance per reference frame (default %g)\n", AIR_RESISTANCE);
+    printf("  --vx R             Launch velocity x (default 6)\n");
+    printf("  --vy R             Launch velocity y (default -2)\n");
+    printf("  --width F          Arena width in pixels (default 800)\n");
+    printf("  --height F         Arena height in pixels (default 600)\n");
+    printf("  --hz F             Physics step rate (default 120)\n");
+    printf("  --speed F          Simulation speed multiplier (default 1)\n");
+    printf("  --max-time F       Seconds before a member counts as never resting (default 60)\n");
+    printf("  --threads N        Worker threads, 1 = serial (default: all cores)\n");
+    printf("  --csv FILE         Write every member's parameters and results to FILE\n");
+}
+
+static bool parseRange(const char* text, SweepRange& range) {
+    float lo, hi;
+    int count;
+    if (sscanf(text, "%f:%f:%d", &lo, &hi, &count) == 3) {
+        if (count < 1) return false;
+        range.lo = lo;
+        range.hi = hi;
+        range.count = count;
+        return true;
+    }
+    char* end;
+    range = SweepRange((float)strtod(text, &end));
+    return end != text && *end == '\0';
+}
+
+static bool parseOptions(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            exit(0);
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        const char* value = argv[++i];
+        bool ok = true;
+        if (arg == "--gravity") ok = parseRange(value, opt.gravity);
+        else if (arg == "--restitution") ok = parseRange(value, opt.restitution);
+        else if (arg == "--air") ok = parseRange(value, opt.air);
+        else if (arg == "--vx") ok = parseRange(value, opt.vx);
+        else if (arg == "--vy") ok = parseRange(value, opt.vy);
+        else if (arg == "--width") opt.settings.width = (float)atof(value);
+        else if (arg == "--height") opt.settings.height = (float)atof(value);
+        else if (arg == "--hz") opt.hz = atof(value);
+        else if (arg == "--speed") opt.settings.speed = (float)atof(value);
+        else if (arg == "--max-time") opt.settings.maxTime = (float)atof(value);
+        else if (arg == "--threads") opt.threads = (unsigned)atoi(value);
+        else if (arg == "--csv") opt.csvPath = value;
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Bad value %s for %s (expected a number or LO:HI:N)\n", value, arg.c_str());
+            return false;
+        }
+    }
+    if (opt.hz <= 0.0) {
+        fprintf(stderr, "--hz must be positive\n");
+        return false;
+    }
+    return true;
+}
+
+// Minimum, mean and maximum of one statistic
+struct Summary {
+    double lo, hi, sum;
+    size_t count;
+
+    Summary() : lo(0.0), hi(0.0), sum(0.0), count(0) {}
+
+    void add(double v) {
+        if (count == 0 || v < lo) lo = v;
+        if (count == 0 || v > hi) hi = v;
+        sum += v;
+        count++;
+    }
+
+    void print(const char* name) const {
+        if (count == 0) printf("%-16s -\n", name);
+        else printf("%-16s %.4g / %.4g / %.4g\n", name, lo, sum / count, hi);
+    }
+};
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    // The launch point of initBall, 5% of the width in from the top-left corner
+    opt.settings.dt = (float)(1.0 / opt.hz);
+    opt.settings.startX = opt.settings.startY = opt.settings.width * 0.05f;
+
+    Ensemble ensemble;
+    ensemble.reserve((size_t)opt.gravity.count * opt.restitution.count * opt.air.count * opt.vx.count *
+                     opt.vy.count);
+    for (int g = 0; g < opt.gravity.count; g++)
+        for (int r = 0; r < opt.restitution.count; r++)
+            for (int a = 0; a < opt.air.count; a++)
+                for (int u = 0; u < opt.vx.count; u++)
+                    for (int v = 0; v < opt.vy.count; v++) {
+                        EnsembleMember m;
+                        m.gravity = opt.gravity.at(g);
+                        m.restitution = opt.restitution.at(r);
+                        m.airResistance = opt.air.at(a);
+                        m.vx = opt.vx.at(u);
+                        m.vy = opt.vy.at(v);
+                        ensemble.push(m);
+                    }
+
+    ThreadPool pool(opt.threads);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t memberSteps = runEnsemble(ensemble, opt.settings, pool.size() > 1 ? &pool : nullptr);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t n = ensemble.getCount();
+    Summary bounces, restTime, peak;
+    size_t restless = 0;
+    for (size_t i = 0; i < n; i++) {
+        EnsembleStats s = ensemble.stats(i);
+        bounces.add(s.bounces);
+        peak.add(s.peakHeight);
+        if (s.restTime >= 0.0f) restTime.add(s.restTime);
+        else restless++;
+    }
+
+    printf("%-16s %zu\n", "members", n);
+    printf("%-16s %g Hz for up to %g s (%u threads)\n", "steps", opt.hz, opt.settings.maxTime, pool.size());
+    printf("%-16s %.3f s\n", "time", seconds);
+    printf("%-16s %.1f\n", "members/s", seconds > 0.0 ? n / seconds : 0.0);
+    printf("%-16s %.3e\n", "member-steps/s", seconds > 0.0 ? memberSteps / seconds : 0.0);
+    printf("%-16s min / mean / max\n", "statistic");
+    bounces.print("bounces");
+    restTime.print("rest time (s)");
+    peak.print("peak height");
+    printf("%-16s %zu\n", "never rested", restless);
+
+    if (!opt.csvPath.empty()) {
+        FILE* csv = fopen(opt.csvPath.c_str(), "w");
+        if (!csv) {
+            fprintf(stderr, "Failed to create %s\n", opt.csvPath.c_str());
+            return 1;
+        }
+        fprintf(csv, "gravity,restitution,air,vx,vy,bounces,rest_time,peak_height\n");
+        for (size_t i = 0; i < n; i++) {
+            EnsembleStats s = ensemble.stats(i);
+            fprintf(csv, "%g,%g,%g,%g,%g,%u,%g,%g\n", ensemble.gravity[i], ensemble.restitution[i],
+                    ensemble.airResistance[i], ensemble.vx[i], ensemble.vy[i], s.bounces, s.restTime,
+                    s.peakHeight);
+        }
+        fclose(csv);
+        printf("%-16s %s\n", "csv", opt.csvPath.c_str());
+    }
+    return 0;
+}
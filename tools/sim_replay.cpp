@@ -0,0 +1,115 @@
+/**
+ * Recording inspector.
+ * Opens a recording written by headless_sim --record (or the viewer),
+ * seeks to a time through the keyframe index and prints the state there
+ * with the same checksums headless_sim prints, so a replayed state can
+ * be compared against the run that produced it.
+ */
+#include "ballstore.h"
+#include "recording.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static void printUsage(const char* program) {
+    printf("Usage: %s FILE [options]\n", program);
+    printf("  --at T             Show the state at simulation time T (default: end)\n");
+    printf("  --play 0|1         Also decode every frame in order and time it (default 0)\n");
+}
+
+// FNV-1a over the bit patterns of one field, as in headless_sim
+static uint64_t hashFloats(uint64_t h, const float* values, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t bits;
+        std::memcpy(&bits, &values[i], sizeof(bits));
+        for (int k = 0; k < 4; k++) {
+            h ^= (bits >> (8 * k)) & 0xff;
+            h *= 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+static void printState(const SimReplay& replay, const BallStore& balls) {
+    size_t n = balls.getCount();
+    double sumX = 0.0, sumY = 0.0, energy = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sumX += balls.x[i];
+        sumY += balls.y[i];
+        energy += 0.5 * balls.size[i] * balls.size[i] * (balls.vx[i] * balls.vx[i] + balls.vy[i] * balls.vy[i]);
+    }
+    uint64_t hash = 14695981039346656037ull;
+    hash = hashFloats(hash, balls.x.data(), n);
+    hash = hashFloats(hash, balls.y.data(), n);
+    hash = hashFloats(hash, balls.vx.data(), n);
+    hash = hashFloats(hash, balls.vy.data(), n);
+
+    printf("%-16s %llu at %.6f s\n", "step", (unsigned long long)replay.step(), replay.time());
+    printf("%-16s %zu\n", "balls", n);
+    printf("%-16s %zu\n", "bounces", replay.bounces().size());
+    printf("%-16s %zu\n", "spawns", replay.spawns().size());
+    printf("%-16s %.6f %.6f\n", "sum x, y", sumX, sumY);
+    printf("%-16s %.6f\n", "kinetic energy", energy);
+    printf("%-16s %016llx\n", "state hash", (unsigned long long)hash);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || !std::strcmp(argv[1], "--help") || !std::strcmp(argv[1], "-h")) {
+        printUsage(argv[0]);
+        return argc < 2 ? 1 : 0;
+    }
+    const char* path = argv[1];
+    bool haveTime = false, play = false;
+    double at = 0.0;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--at") {
+            at = atof(value);
+            haveTime = true;
+        } else if (arg == "--play") {
+            play = atoi(value) != 0;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    SimReplay replay;
+    if (!replay.open(path)) return 1;
+    printf("%-16s %s (%zu bytes)\n", "recording", path, replay.fileSize());
+    printf("%-16s %zu every %u steps\n", "keyframes", replay.keyframeCount(), replay.getKeyframeInterval());
+    printf("%-16s %.6f - %.6f s\n", "time range", replay.startTime(), replay.endTime());
+
+    BallStore balls;
+    if (play) {
+        size_t frames = 0, ballFrames = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        while (replay.next(balls)) {
+            frames++;
+            ballFrames += balls.getCount();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%-16s %zu in %.3f s (%.3e balls/s)\n", "frames decoded", frames, seconds,
+               seconds > 0.0 ? ballFrames / seconds : 0.0);
+    }
+
+    double target = haveTime ? at : replay.endTime();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!replay.seek(target, balls)) {
+        fprintf(stderr, "Time %g is before the start of the recording\n", target);
+        return 1;
+    }
+    double seekSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%-16s %.3f ms\n", "seek", seekSeconds * 1000.0);
+    printState(replay, balls);
+    return 0;
+}
@@ -5,11 +5,24 @@ layout(location = 1) in vec3 vNormal;
 layout(location = 2) in vec2 vTexCoord;
 
 uniform mat4 model;
-uniform mat4 projection;  // This is actually view-projection combined
+
+/* shared blocks (see uniformblocks.h) */
+layout(std140) uniform Camera {
+    layout(row_major) mat4 projection;  // This is actually view-projection combined
+    vec3  viewPos;
+    float viewportHeight;  // In pixels
+};
+
+layout(std140) uniform Light {
+    vec3 lightDir;
+    bool lightFollowsObject;  // Turn lightDir by the model matrix
+    bool useAmbient, useDiffuse, useSpecular;
+};
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoord;
+out vec3 LightDir;
 
 void main()
 {
@@ -25,6 +38,9 @@ void main()
     // Pass texture coordinates through
     TexCoord = vTexCoord;
 
+    // The same for the whole object, so it is turned once per vertex, not per fragment
+    LightDir = lightFollowsObject ? mat3(model) * lightDir : lightDir;
+
     // Transform to clip space using combined view-projection matrix
     gl_Position = projection * worldPos;
 }
\ No newline at end of file
@@ -5,16 +5,25 @@ in vec3 vNormal;
 in vec2 vTexCoord;
 
 uniform mat4 model;
-uniform mat4 projection;  // This is actually view-projection combined
-uniform vec3 lightDir;
-uniform vec3 viewPos;
 uniform vec4 objColor;
-uniform float shininess;
-uniform float specularStrength;
 
-uniform bool useAmbient;
-uniform bool useDiffuse;
-uniform bool useSpecular;
+/* shared blocks (see uniformblocks.h) */
+layout(std140) uniform Camera {
+    layout(row_major) mat4 projection;  // This is actually view-projection combined
+    vec3  viewPos;
+    float viewportHeight;  // In pixels
+};
+
+layout(std140) uniform Light {
+    vec3 lightDir;
+    bool lightFollowsObject;  // Turn lightDir by the model matrix
+    bool useAmbient, useDiffuse, useSpecular;
+};
+
+layout(std140) uniform Material {
+    float shininess;
+    float specularStrength;
+};
 
 out vec3 lightingResult;
 out vec2 fTexCoord;
@@ -28,7 +37,7 @@ void main() {
     vec3 norm = normalize(mat3(transpose(inverse(model))) * vNormal);
     
     // Lighting calculations in world space
-    vec3 lightDirection = normalize(-lightDir);
+    vec3 lightDirection = normalize(-(lightFollowsObject ? mat3(model) * lightDir : lightDir));
     vec3 viewDirection = normalize(viewPos - FragPos);
 
     // Ambient component
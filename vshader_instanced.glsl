@@ -0,0 +1,46 @@
+#version 410 core
+
+layout(location = 0) in vec4 vPosition;
+layout(location = 1) in vec3 vNormal;
+layout(location = 2) in vec2 vTexCoord;
+
+// Per ball: world x, y and size with the zoom applied, and its colour
+layout(location = 3) in vec3 iPlacement;
+layout(location = 4) in vec4 iColor;
+
+uniform mat4 model;       // Orientation shared by every instance of the mesh
+
+/* shared blocks (see uniformblocks.h) */
+layout(std140) uniform Camera {
+    layout(row_major) mat4 projection;  // This is actually view-projection combined
+    vec3  viewPos;
+    float viewportHeight;  // In pixels
+};
+
+layout(std140) uniform Light {
+    vec3 lightDir;
+    bool lightFollowsObject;  // Turn lightDir by the model matrix
+    bool useAmbient, useDiffuse, useSpecular;
+};
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+out vec4 Color;
+out vec3 LightDir;
+
+void main()
+{
+    // Orient the mesh, then scale and place it for this ball
+    vec3 local = (model * vPosition).xyz;
+    vec4 worldPos = vec4(local * iPlacement.z + vec3(iPlacement.xy, 0.0), 1.0);
+    FragPos = worldPos.xyz;
+
+    // model is a rotation times a uniform scale, so it turns normals as well
+    Normal = mat3(model) * vNormal;
+
+    TexCoord = vTexCoord;
+    Color = iColor;
+    LightDir = lightFollowsObject ? mat3(model) * lightDir : lightDir;
+    gl_Position = projection * worldPos;
+}
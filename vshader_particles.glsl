@@ -0,0 +1,25 @@
+#version 410 core
+
+// Per particle: world x, y and size with the zoom applied, and its colour
+layout(location = 0) in vec3 pParticle;
+layout(location = 1) in vec4 pColor;
+
+/* shared block (see uniformblocks.h) */
+layout(std140) uniform Camera {
+    layout(row_major) mat4 projection;  // This is actually view-projection combined
+    vec3  viewPos;
+    float viewportHeight;  // In pixels
+};
+
+out vec4 Color;
+
+void main()
+{
+    gl_Position = projection * vec4(pParticle.xy, 0.0, 1.0);
+
+    // The camera looks straight down -z, so projection[1][1] is the
+    // perspective's y scale: world size to pixels at this depth
+    gl_PointSize = max(pParticle.z * projection[1][1] * 0.5 * viewportHeight / gl_Position.w, 1.0);
+
+    Color = pColor;
+}